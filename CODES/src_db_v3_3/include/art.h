@@ -0,0 +1,54 @@
+#ifndef ART_H
+#define ART_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// Adaptive Radix Tree (Leis et al., ICDE 2013) over byte-string keys.
+// Inner nodes grow and shrink between 4, 16, 48 and 256 children and
+// store up to ART_MAX_PREFIX bytes of their compressed path. A key that
+// ends inside the tree (a prefix of longer keys) is kept in the node's
+// end_leaf slot, so keys do not need a terminator byte.
+
+#define ART_MAX_PREFIX 8
+
+typedef struct ArtTree
+{
+    void *root;              // Root node or tagged leaf
+    long size;               // Number of keys
+    pthread_rwlock_t latch;  // Readers share, writers exclude
+} ArtTree;
+
+// Set up / release the node pools (once per db_init / db_shutdown)
+void art_module_init(void);
+void art_module_shutdown(void);
+
+// Create / destroy a tree (destroy frees nodes and leaves, not the data)
+ArtTree *art_create(void);
+void art_destroy(ArtTree *tree);
+
+// Look up a key. Returns true and fills data/size if found.
+bool art_search(ArtTree *tree, const unsigned char *key, size_t key_len, void **data, size_t *size);
+
+// Insert a new key. Returns false if the key exists or memory ran out.
+bool art_insert(ArtTree *tree, const unsigned char *key, size_t key_len, void *data, size_t size);
+
+// Remove a key. Returns true and the old data/size if it was present.
+bool art_delete(ArtTree *tree, const unsigned char *key, size_t key_len, void **data, size_t *size);
+
+// Find the smallest key >= key (inclusive) or > key (exclusive) and copy
+// it into out_key (at most out_cap bytes; *out_len gets the full length).
+// Passing key_len 0 with inclusive=true returns the first key.
+bool art_seek(ArtTree *tree, const unsigned char *key, size_t key_len, bool inclusive,
+              unsigned char *out_key, size_t out_cap, size_t *out_len);
+
+// Find the largest key < key (or <= key when inclusive). Passing key
+// NULL returns the last key.
+bool art_seek_prev(ArtTree *tree, const unsigned char *key, size_t key_len, bool inclusive,
+                   unsigned char *out_key, size_t out_cap, size_t *out_len);
+
+// Number of keys in the tree
+long art_size(ArtTree *tree);
+
+#endif // ART_H
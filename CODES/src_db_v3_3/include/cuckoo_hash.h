@@ -0,0 +1,84 @@
+#ifndef CUCKOO_HASH_H
+#define CUCKOO_HASH_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Concurrent bucketized cuckoo hash for int keys (MemC3-style).
+// Every key has two candidate buckets of CUCKOO_SLOTS slots; a bucket
+// holds one-byte tags and the keys on a single cache line, so a probe
+// touches at most two lines before it reaches the matching value.
+// Readers take no locks: they validate against a per-key version
+// stripe that writers make odd while the key is being changed or moved.
+
+#define CUCKOO_SLOTS 8             // Slots per bucket
+#define CUCKOO_LOCK_STRIPES 1024   // Writer locks, by bucket
+#define CUCKOO_VERSION_STRIPES 4096 // Reader version counters, by key hash
+#define CUCKOO_MAX_KICKS 500       // Displacements before the table grows
+
+// One cache line: tags first so a probe usually stops there
+typedef struct __attribute__((aligned(64))) CuckooBucket
+{
+    uint8_t tags[CUCKOO_SLOTS]; // 0 = empty slot
+    int32_t keys[CUCKOO_SLOTS]; // Full keys
+} CuckooBucket;
+
+// Value of one slot, kept outside the bucket line
+typedef struct CuckooValue
+{
+    void *data;  // Pointer to row data in NVRAM
+    size_t size; // Size of the row data
+} CuckooValue;
+
+// One generation of bucket storage (replaced when the table grows)
+typedef struct CuckooTable
+{
+    size_t num_buckets;               // Power of two
+    CuckooBucket *buckets;            // num_buckets buckets
+    CuckooValue *values;              // num_buckets * CUCKOO_SLOTS values
+    struct CuckooTable *retired_next; // Older generations, freed on destroy
+} CuckooTable;
+
+typedef struct CuckooHash
+{
+    CuckooTable *table;                                 // Current generation
+    uint32_t resize_seq;                                // Odd while growing
+    uint32_t key_versions[CUCKOO_VERSION_STRIPES];      // Per-key seqlocks
+    pthread_mutex_t stripes[CUCKOO_LOCK_STRIPES];       // Per-bucket writer locks
+    pthread_rwlock_t resize_latch;                      // Shared by writers, exclusive to move/grow
+    long size;                                          // Number of keys
+    uint64_t mod_count;                                 // Bumped by every change
+
+    // Lazily built sorted view for ordered iteration
+    pthread_mutex_t view_mutex;
+    int32_t *view_keys;
+    long view_len;
+    uint64_t view_mod_count;
+} CuckooHash;
+
+// Create / destroy a hash (destroy does not free the row data)
+CuckooHash *cuckoo_create(size_t initial_capacity);
+void cuckoo_destroy(CuckooHash *hash);
+
+// Look up a key. Returns true and fills data/size if found.
+bool cuckoo_get(CuckooHash *hash, int key, void **data, size_t *size);
+
+// Insert a new key. Returns false if the key exists or memory ran out.
+bool cuckoo_put(CuckooHash *hash, int key, void *data, size_t size);
+
+// Remove a key. Returns true and the old data/size if it was present.
+bool cuckoo_delete(CuckooHash *hash, int key, void **data, size_t *size);
+
+// Smallest key > key (or >= when inclusive) using the sorted view,
+// which is rebuilt on first use after any modification
+bool cuckoo_next_key(CuckooHash *hash, int key, bool inclusive, int *next_key);
+
+// Largest key < key (or <= when inclusive), same view
+bool cuckoo_prev_key(CuckooHash *hash, int key, bool inclusive, int *prev_key);
+
+// Number of keys
+long cuckoo_size(CuckooHash *hash);
+
+#endif // CUCKOO_HASH_H
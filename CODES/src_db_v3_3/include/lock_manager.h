@@ -3,52 +3,168 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <pthread.h>
+#include "mem_pool.h"
 
-// Lock modes
+// Number of lock table buckets (power of two)
+#define LOCK_BUCKETS 4096
+
+// Transaction slots (power of two): transaction id & (slots - 1) picks the
+// slot, so this bounds how many transactions can be in flight at once
+#define TXN_SLOTS 65536
+
+// Transaction ids stay below this (the counter wraps back to 1), leaving
+// ids with this bit set to transactions that never take locks
+#define TXN_ID_LIMIT (1 << 30)
+
+// Table locks a transaction keeps in its own cache, so repeated row
+// operations on a table take the table lock once
+#define TXN_TABLE_LOCKS 8
+
+// Row locks one transaction may hold on a table before they are
+// escalated to a single table lock
+#define LOCK_ESCALATION_THRESHOLD 1024
+
+// How often the deadlock detector looks for cycles (LOCK_DETECT policy)
+#define LOCK_DETECT_INTERVAL_MS 10
+
+// Row lock identity: table id in the high 32 bits, key (or a hash of a
+// byte key) in the low 32, so equal keys of different tables never share
+// an entry. Table locks use the table id itself with is_table set.
+#define LOCK_ROW_ID(table_id, key) (((uint64_t)(uint32_t)(table_id) << 32) | (uint32_t)(key))
+
+// Lock modes. Intention modes go on a table before locks on its rows:
+// IS before shared row locks, IX before exclusive ones; SIX is a table
+// read plus intent to write some rows.
 typedef enum {
-    LOCK_SHARED,    // Read lock
-    LOCK_EXCLUSIVE  // Write lock
+    LOCK_INTENTION_SHARED,           // IS
+    LOCK_INTENTION_EXCLUSIVE,        // IX
+    LOCK_SHARED,                     // S: read lock
+    LOCK_SHARED_INTENTION_EXCLUSIVE, // SIX
+    LOCK_EXCLUSIVE,                  // X: write lock
+    LOCK_MODES
 } LockMode;
 
-// Lock request structure
+// How conflicts that could deadlock are resolved
+typedef enum {
+    LOCK_WAIT_DIE, // A request conflicting with an older holder fails at once
+    LOCK_DETECT    // Requests always wait; a background thread breaks cycles
+} DeadlockPolicy;
+
+// A granted lock: on its transaction's held list and its entry's holder list
 typedef struct LockRequest {
     int transaction_id;
-    int resource_id;  // Table ID or row ID
+    uint64_t resource_id; // Table ID or LOCK_ROW_ID
     bool is_table;    // true if table lock, false if row lock
     LockMode mode;
-    struct LockRequest *next;
+    struct LockRequest *next;         // Next lock of the same transaction
+    struct LockRequest *next_granted; // Next holder of the same entry
+    struct LockRequest *prev_granted;
 } LockRequest;
 
+// A blocked request, on the waiting thread's stack while it sleeps
+typedef struct LockWaiter {
+    int transaction_id;
+    LockMode mode;
+    struct LockWaiter *next;
+} LockWaiter;
+
 // Lock table entry
 typedef struct LockEntry {
-    int resource_id;
+    uint64_t resource_id;
     bool is_table;
-    int shared_count;
-    int exclusive_owner;  // -1 if no exclusive owner
-    LockRequest *waiting_list;
+    int granted_count[LOCK_MODES]; // Grants per mode, for the conflict fast path
+    LockRequest *granted; // Holders (a transaction may hold several modes)
+    int waiter_count;     // Threads blocked on cond
+    LockWaiter *waiters;  // Their requests, read by the deadlock detector
+    pthread_cond_t cond;  // Broadcast when a holder releases
     struct LockEntry *next;
 } LockEntry;
 
-// Transaction structure
+// One chain of the lock table, padded to a cache line so threads
+// latching neighbouring buckets don't contend
+typedef struct LockBucket {
+    pthread_mutex_t latch; // Protects the chain and its entries
+    LockEntry *entries;
+} __attribute__((aligned(64))) LockBucket;
+
+// Transaction structure (one slot of the transaction table)
 typedef struct Transaction {
-    int id;
+    int id;                // Id of the transaction in this slot
+    int in_use;            // Slot claimed (0 = free, recycled on commit/abort)
     bool active;
+    bool deadlock_victim;  // Set by the detector (under the bucket latch of the wait)
+    bool no_wait;          // Conflicts fail at once instead of waiting
     LockRequest *held_locks;
-    struct Transaction *next;
-} Transaction;
+    pthread_mutex_t latch; // Protects active and held_locks (taken after a bucket latch)
+    // Table locks already granted, with the combined mode held and the
+    // row locks held under each. Only the thread running the transaction
+    // touches it.
+    struct {
+        int table_id;
+        LockMode mode;
+        int row_locks;
+    } table_locks[TXN_TABLE_LOCKS];
+    int table_lock_count;
+} __attribute__((aligned(64))) Transaction;
+
+// Wait times are counted in power-of-two buckets: bucket i holds waits
+// shorter than 2^i microseconds, the last one everything longer
+#define LOCK_WAIT_BUCKETS 16
+
+// Most contended resources lock_stats_collect reports
+#define LOCK_STATS_TOP 10
+
+// A resource and how often requests for it waited or died
+typedef struct {
+    uint64_t resource_id;
+    bool is_table;
+    unsigned long events;
+} LockHotResource;
+
+// Lock manager statistics. The counters are cumulative for the process
+// (every lock manager together); the rest is a scan of one lock table.
+typedef struct {
+    unsigned long acquires;    // lock_acquire calls
+    unsigned long cached;      // ... answered from the table lock cache
+    unsigned long waits;       // ... that blocked
+    unsigned long deaths;      // ... refused by wait-die (the caller aborts)
+    unsigned long deadlocks;   // ... chosen as a deadlock victim (likewise)
+    unsigned long released;    // Grants released
+    unsigned long escalations; // Row locks traded for a table lock
+    unsigned long wait_us;     // Time spent blocked
+    unsigned long wait_hist[LOCK_WAIT_BUCKETS];
+    int max_queue;             // Most threads seen waiting on one resource
+    int entries;               // Resources locked or waited for now
+    int waiting;               // Threads blocked now
+    int longest_queue;         // Most of those on one resource
+    int hot_count;
+    LockHotResource hot[LOCK_STATS_TOP]; // Most contended first (approximate)
+} LockStats;
 
 // Lock manager structure
 typedef struct {
-    LockEntry *lock_table;
-    Transaction *transactions;
-    pthread_mutex_t mutex;
-    int next_txn_id;
+    LockBucket *buckets;       // Lock entries hashed by resource
+    Transaction *transactions; // TXN_SLOTS slots indexed by id
+    unsigned next_txn_id;      // Allocated with an atomic add, modulo TXN_ID_LIMIT
+    MemPool request_pool;      // LockRequest records
+    MemPool entry_pool;        // LockEntry records
+    DeadlockPolicy policy;
+    int waiting;               // Blocked requests (the detector idles at 0)
+    pthread_t detector;        // Runs under LOCK_DETECT
+    pthread_mutex_t detector_latch;
+    pthread_cond_t detector_cond;
+    bool detector_stop;
 } LockManager;
 
-// Initialize lock manager
+// Initialize lock manager (wait-die)
 void lock_manager_init(LockManager *lm);
 
+// Switch deadlock handling, starting or stopping the detector thread.
+// Call it while no transaction is running.
+bool lock_manager_set_policy(LockManager *lm, DeadlockPolicy policy);
+
 // Start a new transaction
 int transaction_begin(LockManager *lm);
 
@@ -58,11 +174,43 @@ bool transaction_commit(LockManager *lm, int txn_id);
 // Abort a transaction
 bool transaction_abort(LockManager *lm, int txn_id);
 
-// Acquire a lock
-bool lock_acquire(LockManager *lm, int txn_id, int resource_id, bool is_table, LockMode mode);
+// Make every conflicting request of the transaction fail at once, as if
+// it had died under wait-die, for callers that must never block
+bool transaction_set_no_wait(LockManager *lm, int txn_id);
+
+// Acquire a lock, blocking while it conflicts with younger holders.
+// A table lock the transaction already holds in a covering mode returns
+// at once from its cache. Row locks are only counted under a table lock
+// taken first (normally an intention lock); past
+// LOCK_ESCALATION_THRESHOLD of them the transaction tries to take the
+// table in S or X instead and drops the row locks that covers, after
+// which further rows of the table need no lock at all.
+// Under LOCK_WAIT_DIE transaction ids serve as timestamps: a request that
+// conflicts with an older holder returns false at once and the caller
+// should abort. Waits only run from older to younger transactions, so none
+// can deadlock. Under LOCK_DETECT every conflict waits, and the detector
+// thread builds a waits-for graph from the lock queues every
+// LOCK_DETECT_INTERVAL_MS; in each cycle the transaction holding the
+// fewest locks (the youngest of those) is woken with false and should
+// abort.
+bool lock_acquire(LockManager *lm, int txn_id, uint64_t resource_id, bool is_table, LockMode mode);
+
+// Does the transaction hold the table in a mode that covers mode?
+bool lock_table_held(LockManager *lm, int txn_id, int table_id, LockMode mode);
+
+// Would mode on the resource conflict with a lock another transaction
+// holds right now? Takes nothing and never waits.
+bool lock_conflict_held(LockManager *lm, int txn_id, uint64_t resource_id, bool is_table, LockMode mode);
+
+// Release a lock (every mode the transaction holds on the resource)
+bool lock_release(LockManager *lm, int txn_id, uint64_t resource_id, bool is_table);
+
+// Sum the statistics. Each thread counts into its own block, so keeping
+// them costs the lock paths a few uncontended increments.
+void lock_stats_collect(LockManager *lm, LockStats *stats);
 
-// Release a lock
-bool lock_release(LockManager *lm, int txn_id, int resource_id, bool is_table);
+// Format statistics as text; returns what snprintf would
+int lock_stats_format(const LockStats *stats, char *buf, size_t size);
 
 // Clean up lock manager
 void lock_manager_cleanup(LockManager *lm);
@@ -0,0 +1,59 @@
+#ifndef MEM_POOL_H
+#define MEM_POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// Size of one arena carved into objects (one 2MB huge page on x86-64)
+#define MEM_POOL_ARENA_SIZE (2L * 1024 * 1024)
+
+// Maximum number of pools that get a per-thread free list
+#define MEM_POOL_MAX_POOLS 16
+
+// Number of free objects a thread keeps before returning half to the pool
+#define MEM_POOL_CACHE_SIZE 64
+
+// One large mapping that objects are carved from
+typedef struct MemPoolArena
+{
+    void *base;                // Start of the mapping
+    size_t size;               // Size of the mapping
+    bool huge;                 // Backed by explicit huge pages
+    struct MemPoolArena *next; // Next arena of the same pool
+} MemPoolArena;
+
+// Typed object pool: fixed-size objects, never returned to the OS until
+// the pool is destroyed, so a freed object stays readable memory of the
+// same type (callers may rely on this for optimistic reads).
+typedef struct MemPool
+{
+    const char *name;      // Name for statistics
+    int pool_id;           // Slot in the per-thread caches (-1 = none)
+    unsigned generation;   // Detects stale thread caches after destroy
+    size_t obj_size;       // Rounded object size
+    bool use_huge_pages;   // Try MAP_HUGETLB for new arenas
+    void *free_list;       // Shared free list
+    char *bump_ptr;        // Next uncarved byte in the current arena
+    char *bump_end;        // End of the current arena
+    MemPoolArena *arenas;  // All arenas of this pool
+    size_t arena_count;    // Number of arenas mapped
+    pthread_mutex_t mutex; // Protects free_list and the arenas
+} MemPool;
+
+// Initialize a pool of objects of obj_size bytes
+void mem_pool_init(MemPool *pool, const char *name, size_t obj_size, bool use_huge_pages);
+
+// Allocate one object (uninitialized), NULL if out of memory
+void *mem_pool_alloc(MemPool *pool);
+
+// Return an object to the pool
+void mem_pool_free(MemPool *pool, void *obj);
+
+// Unmap all arenas; every object of the pool becomes invalid
+void mem_pool_destroy(MemPool *pool);
+
+// Bytes of address space mapped by the pool
+size_t mem_pool_mapped_bytes(MemPool *pool);
+
+#endif // MEM_POOL_H
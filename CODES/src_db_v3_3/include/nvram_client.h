@@ -0,0 +1,75 @@
+#ifndef NVRAM_CLIENT_H
+#define NVRAM_CLIENT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "nvram_protocol.h"
+
+// Client of the server's binary protocol. One NvClient is one connection
+// and one session: like a text session it has at most one transaction
+// open, and row operations run in it. Calls block until the response is
+// in, unless requests are queued to pipeline them (below). A client is not
+// thread-safe; give each thread its own.
+
+typedef struct NvClient NvClient;
+
+// Connect and switch the connection to the binary protocol; NULL on failure
+NvClient *nv_connect(const char *host, int port);
+
+// Close the connection (the server aborts an open transaction)
+void nv_close(NvClient *client);
+
+// Tables. A handle is the table id, valid for the life of the server.
+// index_type is an IndexType value; partitions > 0 hash-partitions the table.
+NvStatus nv_create_table(NvClient *client, const char *name, int index_type, int partitions, int *handle);
+NvStatus nv_open_table(NvClient *client, const char *name, int *handle);
+
+// Transactions. A read-only one is a snapshot: it never waits or fails on a
+// lock, and writes under it fail.
+NvStatus nv_begin(NvClient *client, bool readonly);
+NvStatus nv_commit(NvClient *client);
+NvStatus nv_abort(NvClient *client);
+
+// Rows. The value nv_get returns lives in the client's buffer until its
+// next call.
+NvStatus nv_get(NvClient *client, int table, int key, const void **value, size_t *size);
+NvStatus nv_put(NvClient *client, int table, int key, const void *value, size_t size);
+NvStatus nv_delete(NvClient *client, int table, int key);
+
+// Rows of tables with byte-string keys (VARKEY or ART)
+NvStatus nv_get_bytes(NvClient *client, int table, const void *key, size_t key_len, const void **value, size_t *size);
+NvStatus nv_put_bytes(NvClient *client, int table, const void *key, size_t key_len, const void *value, size_t size);
+NvStatus nv_delete_bytes(NvClient *client, int table, const void *key, size_t key_len);
+
+// Pipelining. Queued requests go out with nv_flush (or the first
+// nv_receive) in one write, and nv_receive returns their responses one at
+// a time, in order; its value lives until the client's next call. Finish
+// receiving before any other call. The server stops reading a connection
+// while it can't send, so keep the number in flight to a few hundred.
+NvStatus nv_queue_get(NvClient *client, int table, int key);
+NvStatus nv_queue_put(NvClient *client, int table, int key, const void *value, size_t size);
+NvStatus nv_queue_delete(NvClient *client, int table, int key);
+NvStatus nv_flush(NvClient *client);
+NvStatus nv_receive(NvClient *client, const void **value, size_t *size);
+
+// One row of an nv_mget
+typedef struct
+{
+    const void *value; // In the client's buffer until its next call
+    size_t size;
+    bool found;
+} NvValue;
+
+// Many int keys in one request. Outside a transaction each runs in one of
+// its own: nv_mget reads one snapshot, and nv_mput / nv_mdelete change all
+// the rows or none. *rows is how many went through (on NV_FAILED, the
+// index of the key that failed).
+NvStatus nv_mget(NvClient *client, int table, const int *keys, int count, NvValue *values, int *found);
+NvStatus nv_mput(NvClient *client, int table, const int *keys, const void *const *values, const size_t *sizes,
+                 int count, int *rows);
+NvStatus nv_mdelete(NvClient *client, int table, const int *keys, int count, int *rows);
+
+// Name of a status, for messages
+const char *nv_status_name(NvStatus status);
+
+#endif // NVRAM_CLIENT_H
@@ -0,0 +1,146 @@
+#ifndef NVRAM_PROTOCOL_H
+#define NVRAM_PROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Binary wire protocol of the server, spoken next to the text one. A
+// client asks for it by sending NV_HELLO (which can't start a text
+// command) as its first bytes; the server answers with NV_HELLO and its
+// version, and from then on both sides exchange frames:
+//
+//   request:  header (NV_REQUEST_HEADER bytes), key_len key bytes, value_len value bytes
+//   response: header (NV_RESPONSE_HEADER bytes), value_len value bytes
+//
+// Every request gets one response, in order. Integers are little-endian.
+// A client may send many requests before reading the responses; the
+// server answers everything it read in one go with a single write.
+
+#define NV_HELLO "\0NVB"
+#define NV_HELLO_LEN 4
+#define NV_VERSION 1 // Sent after the hello, one byte
+
+#define NV_MAX_VALUE (1 << 20) // Longest value (or table name) in a frame
+#define NV_MAX_KEY 1024        // Longest byte-string key (VB_MAX_KEY_LEN)
+#define NV_MAX_RESPONSE (16 << 20) // Longest response value (an NV_OP_MGET's)
+
+// Request header
+//   0  u32 value_len
+//   4  u16 key_len   byte-string key length, 0 for an int key
+//   6  u8  opcode
+//   7  u8  flags
+//   8  u32 table     handle from NV_OP_OPEN / NV_OP_CREATE
+//   12 i32 key       int key (or the operation's argument)
+#define NV_REQUEST_HEADER 16
+
+// Response header
+//   0  u32 value_len
+//   4  u8  status
+//   5  u8  opcode    of the request answered
+//   6  u16 unused
+//   8  i32 result    table handle, transaction id...
+#define NV_RESPONSE_HEADER 12
+
+typedef enum
+{
+    NV_OP_CREATE = 1, // value: name, key: index type (IndexType order), table: hash partitions
+    NV_OP_OPEN,       // value: name; result: table handle
+    NV_OP_BEGIN,      // flags: NV_BEGIN_READONLY; result: transaction id
+    NV_OP_COMMIT,
+    NV_OP_ABORT,
+    NV_OP_GET,        // response value: the row
+    NV_OP_PUT,        // value: the row
+    NV_OP_DELETE,
+    // Many int keys at once, key: how many. They run in the session's
+    // transaction, or outside one in their own (a snapshot for MGET), so
+    // one round trip and one commit cover them all.
+    NV_OP_MGET,       // value: i32 keys; response value: per key a u32 length
+                      // (NV_ABSENT if not found) and the row; result: rows found
+    NV_OP_MPUT,       // value: per row an i32 key, u32 length and the row; result: rows put
+    NV_OP_MDELETE     // value: i32 keys; result: rows deleted
+} NvOpcode;
+
+#define NV_BEGIN_READONLY 0x01 // A snapshot only (db_begin_readonly)
+#define NV_ABSENT 0xFFFFFFFFu  // NV_OP_MGET length of a key with no row
+
+typedef enum
+{
+    NV_OK = 0,
+    NV_NOT_FOUND,      // GET: no row under the key
+    NV_FAILED,         // Refused: duplicate key, lock conflict, commit failure...
+    NV_NO_TABLE,       // Unknown table handle or name
+    NV_NO_TRANSACTION, // Row operation, commit or abort outside a transaction
+    NV_BAD_REQUEST,    // Unknown opcode or malformed frame
+    NV_DISCONNECTED    // Client side only: the connection failed
+} NvStatus;
+
+typedef struct
+{
+    uint32_t value_len;
+    uint16_t key_len;
+    uint8_t opcode;
+    uint8_t flags;
+    uint32_t table;
+    int32_t key;
+} NvRequest;
+
+typedef struct
+{
+    uint32_t value_len;
+    uint8_t status;
+    uint8_t opcode;
+    int32_t result;
+} NvResponse;
+
+static inline void nv_put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static inline uint32_t nv_get_u32(const unsigned char *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void nv_encode_request(unsigned char *p, const NvRequest *req)
+{
+    nv_put_u32(p, req->value_len);
+    p[4] = req->key_len;
+    p[5] = req->key_len >> 8;
+    p[6] = req->opcode;
+    p[7] = req->flags;
+    nv_put_u32(p + 8, req->table);
+    nv_put_u32(p + 12, (uint32_t)req->key);
+}
+
+static inline void nv_decode_request(const unsigned char *p, NvRequest *req)
+{
+    req->value_len = nv_get_u32(p);
+    req->key_len = p[4] | p[5] << 8;
+    req->opcode = p[6];
+    req->flags = p[7];
+    req->table = nv_get_u32(p + 8);
+    req->key = (int32_t)nv_get_u32(p + 12);
+}
+
+static inline void nv_encode_response(unsigned char *p, const NvResponse *resp)
+{
+    nv_put_u32(p, resp->value_len);
+    p[4] = resp->status;
+    p[5] = resp->opcode;
+    p[6] = p[7] = 0;
+    nv_put_u32(p + 8, (uint32_t)resp->result);
+}
+
+static inline void nv_decode_response(const unsigned char *p, NvResponse *resp)
+{
+    resp->value_len = nv_get_u32(p);
+    resp->status = p[4];
+    resp->opcode = p[5];
+    resp->result = (int32_t)nv_get_u32(p + 8);
+}
+
+#endif // NVRAM_PROTOCOL_H
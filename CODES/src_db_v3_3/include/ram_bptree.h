@@ -15,6 +15,28 @@ typedef void *NVRAMPtr;
 typedef struct BPTreeNode BPTreeNode;
 typedef struct BPTree BPTree;
 typedef struct Table Table;
+typedef struct DbCursor DbCursor;
+
+// Index structure behind a table
+typedef enum
+{
+    INDEX_BPTREE, // B+ Tree (default)
+    INDEX_ART,    // Adaptive Radix Tree
+    INDEX_CUCKOO, // Cuckoo hash: O(1) point lookups, scans use a sorted view
+    INDEX_VARKEY  // B+ Tree over byte-string keys with prefix-compressed leaves
+} IndexType;
+
+// How a table spreads its keys over partitions. Each partition has its
+// own index and WAL stream, so single-key operations on different
+// partitions share neither a root latch nor a WAL mutex.
+typedef enum
+{
+    PARTITION_NONE,  // One index for the whole table
+    PARTITION_HASH,  // Partition chosen by a hash of the key
+    PARTITION_RANGE  // Partition i holds keys below bounds[i] (int keys only)
+} PartitionMethod;
+
+#define MAX_PARTITIONS 64
 
 // Global lock manager
 extern LockManager g_lock_manager;
@@ -28,23 +50,113 @@ void db_init();
 // Shutdown database system
 void db_shutdown();
 
+// Concurrency control of a transaction. TXN_LOCKING (two-phase locking)
+// locks each row as it writes it. Its reads come from its snapshot
+// without locks, so it gives snapshot isolation: a write fails (and the
+// caller should abort) if a transaction that committed after the
+// snapshot changed the row, but two transactions that each read what the
+// other writes can both commit (write skew). TXN_OPTIMISTIC keeps its
+// writes in DRAM; at commit it locks the rows it writes in key order,
+// checks that no row it read has changed since its snapshot or is locked
+// by another writer, and only then applies them, failing the commit (and
+// rolling back) if one is. That makes it serializable for the rows it
+// reads by key. It suits short transactions that rarely conflict.
+// TXN_DEFERRED locks like TXN_LOCKING but also keeps its writes in DRAM:
+// an abort never touches NVRAM, and the commit writes each key's final
+// state with its WAL entries as one contiguous block and a single flush. Both buffered modes see their own
+// writes through db_get_row; scans and counts see only the snapshot.
+typedef enum
+{
+    TXN_LOCKING,
+    TXN_OPTIMISTIC,
+    TXN_DEFERRED
+} TxnMode;
+
 // Transaction operations
-int db_begin_transaction();
+int db_begin_transaction(); // TXN_LOCKING
+int db_begin_transaction_mode(TxnMode mode);
 bool db_commit_transaction(int txn_id);
 bool db_abort_transaction(int txn_id);
+// A read-only transaction pins a snapshot and nothing more: it takes no
+// lock manager slot, its reads go through the index without latches
+// (B+ Tree and hash indexes) and see the versions committed before it
+// began. Writes under it fail. End it with db_commit_transaction (or
+// db_abort_transaction, which is the same). -1 if too many are running.
+int db_begin_readonly();
+// Lock a table for DDL or a bulk load (LOCK_EXCLUSIVE), or to read it
+// unchanged (LOCK_SHARED). Held until commit or abort; false if an older
+// transaction holds a conflicting lock.
+bool db_lock_table(Table *table, int txn_id, LockMode mode);
 
 // Table operations
 int db_create_table(const char *name);
+int db_create_table_with_index(const char *name, IndexType index_type);
+// bounds: num_partitions - 1 increasing split keys (PARTITION_RANGE only)
+int db_create_partitioned_table(const char *name, IndexType index_type, PartitionMethod method,
+                                int num_partitions, const int *bounds);
 Table *db_open_table(const char *name);
+Table *db_open_table_by_id(int table_id);
 void db_close_table(Table *table);
 
-// Row operations
+// Row operations. Rows are multi-versioned: a transaction reads the
+// snapshot taken when it began (plus its own writes) without taking
+// locks, while inserts and deletes take IX on the table (once per
+// transaction) and X on the row, and become visible to others at commit. Versions no snapshot can see any more are
+// reclaimed as later transactions commit.
 NVRAMPtr db_get_row(Table *table, int txn_id, int key, size_t *size);
 bool db_put_row(Table *table, int txn_id, int key, void *data, size_t size);
 bool db_delete_row(Table *table, int txn_id, int key);
 int db_get_next_row(Table *table, int current_key);
 
+// Byte-string key operations (tables using INDEX_VARKEY or INDEX_ART).
+// Keys order by memcmp; int keys on the same table sort as 4-byte strings.
+NVRAMPtr db_get_row_bytes(Table *table, int txn_id, const void *key, size_t key_len, size_t *size);
+bool db_put_row_bytes(Table *table, int txn_id, const void *key, size_t key_len, void *data, size_t size);
+bool db_delete_row_bytes(Table *table, int txn_id, const void *key, size_t key_len);
+bool db_get_next_key_bytes(Table *table, const void *key, size_t key_len,
+                           void *out_key, size_t out_cap, size_t *out_len);
+
+// True if the table's index was created for byte-string keys (INDEX_VARKEY)
+bool db_table_has_byte_keys(Table *table);
+int db_table_id(Table *table); // What db_open_table_by_id takes
+
 int db_get_first_key(Table *table);
-long db_get_table_row_count(Table *table);
+long db_get_table_row_count(Table *table); // Counts deleted rows not yet reclaimed
+
+// Partitions of a table (0 if not partitioned), in key order for range
+// partitioning. A partition works with the cursor and scan calls, so a
+// parallel scan can hand each worker a whole partition.
+int db_table_partition_count(Table *table);
+Table *db_table_partition(Table *table, int i);
+
+// Range-scan cursor over int keys, reading one snapshot from open to
+// close. It holds its place in the index, so a full scan costs O(N)
+// instead of a root descent per row, and it re-seeks by key if rows were
+// inserted or deleted since the last call. It can move in either
+// direction; running off one end leaves it just past that end.
+DbCursor *db_cursor_open(Table *table);
+void db_cursor_seek(DbCursor *cursor, int key); // next: first key >= key, prev: last key < key
+void db_cursor_seek_last(DbCursor *cursor);     // prev: the last key (for reverse scans)
+bool db_cursor_next(DbCursor *cursor, int *key, NVRAMPtr *data, size_t *size);
+bool db_cursor_prev(DbCursor *cursor, int *key, NVRAMPtr *data, size_t *size);
+void db_cursor_close(DbCursor *cursor);
+
+// Visit rows with lo <= key <= hi in order; stop early if callback returns false
+typedef bool (*DbScanCallback)(int key, NVRAMPtr data, size_t size, void *arg);
+long db_scan_range(Table *table, int lo, int hi, DbScanCallback callback, void *arg);
+
+// Order statistics over indexed keys, so deleted rows not yet reclaimed
+// count on every index type, like db_get_table_row_count. On B+ Tree
+// tables inner nodes count the keys under each child, so both are one
+// root descent (per partition; seek_rank on hash partitions binary
+// searches the key space by them); other indexes step through their keys.
+// Both are exact once the collector has caught up, but while a snapshot
+// holds deletes back (or a writer is in flight) they see keys a reader
+// would skip, and seek_rank may return such a key. To page by rank,
+// db_cursor_seek to the key it returns and step with the cursor, which
+// skips rows the snapshot does not see; take the next page from the
+// cursor's last key rather than from rank + page size.
+long db_count_range(Table *table, int lo, int hi);     // rows with lo <= key <= hi
+bool db_seek_rank(Table *table, long rank, int *key); // key of the rank-th row (0-based)
 
 #endif // RAM_BPTREE_H
\ No newline at end of file
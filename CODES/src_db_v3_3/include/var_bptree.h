@@ -0,0 +1,62 @@
+#ifndef VAR_BPTREE_H
+#define VAR_BPTREE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// B+ Tree over variable-length byte-string keys (memcmp order).
+// Leaves are prefix-compressed: the bytes every key in a leaf shares are
+// stored once, followed by each key's remaining suffix, so long common
+// prefixes (e.g. "user6284...") cost one copy per leaf and a search
+// compares them once before binary searching the short suffixes.
+// Inner nodes keep the shortest separator that splits their children.
+
+#define VB_LEAF_KEYS 16     // Keys per leaf
+#define VB_INNER_KEYS 16    // Separators per inner node (children = +1)
+#define VB_MAX_KEY_LEN 1024 // Longest key accepted
+
+typedef struct VarBPTree
+{
+    void *root;             // Root node (a leaf while the tree is small)
+    int height;             // 1 = root is a leaf
+    long size;              // Number of keys
+    pthread_rwlock_t latch; // Readers share, writers exclude
+} VarBPTree;
+
+// Set up / release the node pools (once per db_init / db_shutdown)
+void vbt_module_init(void);
+void vbt_module_shutdown(void);
+
+// Create / destroy a tree (destroy frees nodes, not the data)
+VarBPTree *vbt_create(void);
+void vbt_destroy(VarBPTree *tree);
+
+// Look up a key. Returns true and fills data/size if found.
+bool vbt_search(VarBPTree *tree, const unsigned char *key, size_t key_len, void **data, size_t *size);
+
+// Insert a new key. Returns false if the key exists, is too long or memory ran out.
+bool vbt_insert(VarBPTree *tree, const unsigned char *key, size_t key_len, void *data, size_t size);
+
+// Remove a key. Returns true and the old data/size if it was present.
+bool vbt_delete(VarBPTree *tree, const unsigned char *key, size_t key_len, void **data, size_t *size);
+
+// Find the smallest key >= key (inclusive) or > key (exclusive) and copy
+// it into out_key (at most out_cap bytes; *out_len gets the full length).
+// Passing key_len 0 with inclusive=true returns the first key.
+bool vbt_seek(VarBPTree *tree, const unsigned char *key, size_t key_len, bool inclusive,
+              unsigned char *out_key, size_t out_cap, size_t *out_len);
+
+// Find the largest key < key (or <= key when inclusive). Passing key
+// NULL returns the last key.
+bool vbt_seek_prev(VarBPTree *tree, const unsigned char *key, size_t key_len, bool inclusive,
+                   unsigned char *out_key, size_t out_cap, size_t *out_len);
+
+// Number of keys in the tree
+long vbt_size(VarBPTree *tree);
+
+// Point lookups and full-key comparisons made by the calling thread so far
+void vbt_lookup_stats(unsigned long *lookups, unsigned long *key_compares);
+
+#endif // VAR_BPTREE_H
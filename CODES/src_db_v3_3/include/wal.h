@@ -6,7 +6,7 @@
 #include <pthread.h> // For mutex support
 #include <stdint.h>
 
-#define MAX_TABLES 10 // Maximum number of tables
+#define MAX_WAL_TABLES (1 << 20) // WAL streams: one per table, or per partition
 
 // WAL Entry Structure
 typedef struct WALEntry
@@ -16,8 +16,13 @@ typedef struct WALEntry
     void *data_ptr;        // Pointer to actual data in NVRAM (KP in diagram)
     size_t data_size;      // Size of the data
     struct WALEntry *next; // Pointer to next WAL entry
+    uint32_t key_len;      // Length of key_bytes (0 = int key)
+    unsigned char key_bytes[]; // Byte-string key, stored inline
 } WALEntry;
 
+// NVRAM bytes a WAL entry takes for a key of key_len bytes
+#define WAL_ENTRY_SIZE(key_len) (sizeof(WALEntry) + (key_len))
+
 // WAL Table Structure
 typedef struct WALTable
 {
@@ -28,8 +33,6 @@ typedef struct WALTable
     pthread_mutex_t mutex; // Mutex for thread-safe WAL operations
 } WALTable;
 
-extern WALTable *wal_tables[MAX_TABLES];
-
 // Function Declarations
 void flush_range(void *start, size_t size);
 void atomic_write_64(void *dest, uint64_t val);
@@ -37,8 +40,15 @@ void atomic_write_64(void *dest, uint64_t val);
 // WAL Operations
 int wal_create_table(int table_id, void *memory_ptr);
 int wal_add_entry(int table_id, int key, void *data_ptr, int op, void *entry_ptr, size_t data_size);
+int wal_add_entry_bytes(int table_id, const void *key, size_t key_len, void *data_ptr, int op, void *entry_ptr, size_t data_size);
+// Batched logging: fill entries in place without flushing, chain the
+// entries of one stream through next, persist them together (e.g. with
+// one flush_range over the batch), then link the chain with one append
+void wal_fill_entry(void *entry_ptr, int key, const void *key_bytes, size_t key_len, void *data_ptr, int op, size_t data_size);
+int wal_append_batch(int table_id, WALEntry *first, WALEntry *last);
 void wal_advance_commit_ptr(int table_id, int txn_id);
 void wal_show_data();
+void wal_shutdown(); // Forget all streams (their NVRAM is being released)
 void wal_recover(); // New function for crash recovery
 
 #endif // WAL_H
\ No newline at end of file
@@ -17,4 +17,22 @@ CREATE FUNCTION mytam_create_table(name text)
 RETURNS integer
 AS 'MODULE_PATHNAME'
 LANGUAGE C STRICT;
--- --- END OF ADDED LINES ---
\ No newline at end of file
+-- --- END OF ADDED LINES ---
+
+-- Same as mytam_create_table, choosing the index: 'bptree', 'art', 'cuckoo' or 'varkey'
+CREATE FUNCTION mytam_create_table_with_index(name text, index_type text)
+RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+-- Number of rows with lo <= key <= hi in a backend table
+CREATE FUNCTION mytam_count_range(name text, lo integer, hi integer)
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+-- Lock manager statistics: waits, wait-time histogram, aborts, queues, hottest locks
+CREATE FUNCTION mytam_lock_stats()
+RETURNS text
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
@@ -0,0 +1,1009 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <emmintrin.h> // SSE2 for Node16 search
+#include "../include/art.h"
+#include "../include/mem_pool.h"
+
+#define NODE4 0
+#define NODE16 1
+#define NODE48 2
+#define NODE256 3
+
+// Leaves are tagged with the low pointer bit inside child slots
+#define IS_LEAF(p) (((uintptr_t)(p)) & 1)
+#define SET_LEAF(l) ((void *)((uintptr_t)(l) | 1))
+#define LEAF_RAW(p) ((ArtLeaf *)((uintptr_t)(p) & ~(uintptr_t)1))
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// Leaf: the full key plus the row's NVRAM location
+typedef struct ArtLeaf
+{
+    void *data;             // Pointer to row data in NVRAM
+    size_t size;            // Size of the row data
+    size_t key_len;         // Length of key
+    unsigned char key[];    // Key bytes
+} ArtLeaf;
+
+// Header shared by all inner nodes
+typedef struct ArtNode
+{
+    uint8_t type;                          // NODE4 .. NODE256
+    uint16_t num_children;                 // Number of children
+    uint32_t prefix_len;                   // Length of the compressed path
+    unsigned char prefix[ART_MAX_PREFIX];  // First bytes of the compressed path
+    ArtLeaf *end_leaf;                     // Key that ends at this node
+} ArtNode;
+
+typedef struct
+{
+    ArtNode n;
+    unsigned char keys[4];
+    void *children[4];
+} ArtNode4;
+
+typedef struct
+{
+    ArtNode n;
+    unsigned char keys[16];
+    void *children[16];
+} ArtNode16;
+
+typedef struct
+{
+    ArtNode n;
+    unsigned char child_index[256]; // 0 = empty, otherwise slot + 1
+    void *children[48];
+} ArtNode48;
+
+typedef struct
+{
+    ArtNode n;
+    void *children[256];
+} ArtNode256;
+
+// One pool per node size
+static MemPool node_pools[4];
+static const size_t node_sizes[4] = {sizeof(ArtNode4), sizeof(ArtNode16), sizeof(ArtNode48), sizeof(ArtNode256)};
+
+// Set up / release the node pools (once per db_init / db_shutdown)
+void art_module_init(void)
+{
+    static const char *names[4] = {"art_node4", "art_node16", "art_node48", "art_node256"};
+    for (int i = 0; i < 4; i++)
+    {
+        mem_pool_init(&node_pools[i], names[i], node_sizes[i], true);
+    }
+}
+
+void art_module_shutdown(void)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        mem_pool_destroy(&node_pools[i]);
+    }
+}
+
+static ArtNode *alloc_node(uint8_t type)
+{
+    ArtNode *node = (ArtNode *)mem_pool_alloc(&node_pools[type]);
+    if (!node)
+        return NULL;
+    memset(node, 0, node_sizes[type]);
+    node->type = type;
+    return node;
+}
+
+static void free_inner(ArtNode *node)
+{
+    mem_pool_free(&node_pools[node->type], node);
+}
+
+static ArtLeaf *make_leaf(const unsigned char *key, size_t key_len, void *data, size_t size)
+{
+    ArtLeaf *leaf = (ArtLeaf *)malloc(sizeof(ArtLeaf) + key_len);
+    if (!leaf)
+        return NULL;
+    leaf->data = data;
+    leaf->size = size;
+    leaf->key_len = key_len;
+    memcpy(leaf->key, key, key_len);
+    return leaf;
+}
+
+static bool leaf_matches(const ArtLeaf *leaf, const unsigned char *key, size_t key_len)
+{
+    return leaf->key_len == key_len && memcmp(leaf->key, key, key_len) == 0;
+}
+
+// Compare a leaf key with a search key (memcmp order, shorter first on ties)
+static int leaf_compare(const ArtLeaf *leaf, const unsigned char *key, size_t key_len)
+{
+    int cmp = memcmp(leaf->key, key, MIN(leaf->key_len, key_len));
+    if (cmp != 0)
+        return cmp;
+    return (leaf->key_len > key_len) - (leaf->key_len < key_len);
+}
+
+// Address of the child slot for byte c, or NULL
+static void **find_child(ArtNode *node, unsigned char c)
+{
+    switch (node->type)
+    {
+    case NODE4:
+    {
+        ArtNode4 *n = (ArtNode4 *)node;
+        for (int i = 0; i < node->num_children; i++)
+        {
+            if (n->keys[i] == c)
+                return &n->children[i];
+        }
+        return NULL;
+    }
+    case NODE16:
+    {
+        ArtNode16 *n = (ArtNode16 *)node;
+        __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)c), _mm_loadu_si128((const __m128i *)n->keys));
+        int mask = _mm_movemask_epi8(cmp) & ((1 << node->num_children) - 1);
+        return mask ? &n->children[__builtin_ctz(mask)] : NULL;
+    }
+    case NODE48:
+    {
+        ArtNode48 *n = (ArtNode48 *)node;
+        int idx = n->child_index[c];
+        return idx ? &n->children[idx - 1] : NULL;
+    }
+    default:
+    {
+        ArtNode256 *n = (ArtNode256 *)node;
+        return n->children[c] ? &n->children[c] : NULL;
+    }
+    }
+}
+
+// First (smallest) child of an inner node, or NULL
+static void *first_child(ArtNode *node)
+{
+    switch (node->type)
+    {
+    case NODE4:
+        return node->num_children ? ((ArtNode4 *)node)->children[0] : NULL;
+    case NODE16:
+        return node->num_children ? ((ArtNode16 *)node)->children[0] : NULL;
+    case NODE48:
+    {
+        ArtNode48 *n = (ArtNode48 *)node;
+        for (int c = 0; c < 256; c++)
+        {
+            if (n->child_index[c])
+                return n->children[n->child_index[c] - 1];
+        }
+        return NULL;
+    }
+    default:
+    {
+        ArtNode256 *n = (ArtNode256 *)node;
+        for (int c = 0; c < 256; c++)
+        {
+            if (n->children[c])
+                return n->children[c];
+        }
+        return NULL;
+    }
+    }
+}
+
+// Last (largest) child of an inner node, or NULL
+static void *last_child(ArtNode *node)
+{
+    switch (node->type)
+    {
+    case NODE4:
+        return node->num_children ? ((ArtNode4 *)node)->children[node->num_children - 1] : NULL;
+    case NODE16:
+        return node->num_children ? ((ArtNode16 *)node)->children[node->num_children - 1] : NULL;
+    case NODE48:
+    {
+        ArtNode48 *n = (ArtNode48 *)node;
+        for (int c = 255; c >= 0; c--)
+        {
+            if (n->child_index[c])
+                return n->children[n->child_index[c] - 1];
+        }
+        return NULL;
+    }
+    default:
+    {
+        ArtNode256 *n = (ArtNode256 *)node;
+        for (int c = 255; c >= 0; c--)
+        {
+            if (n->children[c])
+                return n->children[c];
+        }
+        return NULL;
+    }
+    }
+}
+
+// Largest leaf below p (an end leaf is smaller than all children)
+static ArtLeaf *maximum(void *p)
+{
+    while (p && !IS_LEAF(p))
+    {
+        ArtNode *node = (ArtNode *)p;
+        void *last = last_child(node);
+        if (!last)
+            return node->end_leaf;
+        p = last;
+    }
+    return p ? LEAF_RAW(p) : NULL;
+}
+
+// Smallest leaf below p
+static ArtLeaf *minimum(void *p)
+{
+    while (p && !IS_LEAF(p))
+    {
+        ArtNode *node = (ArtNode *)p;
+        if (node->end_leaf)
+            return node->end_leaf;
+        p = first_child(node);
+    }
+    return p ? LEAF_RAW(p) : NULL;
+}
+
+// Number of prefix bytes of node matching key from depth. Prefixes
+// longer than ART_MAX_PREFIX are completed from any leaf below the node.
+static size_t prefix_mismatch(ArtNode *node, const unsigned char *key, size_t key_len, size_t depth)
+{
+    size_t stored = MIN(node->prefix_len, ART_MAX_PREFIX);
+    size_t i;
+    for (i = 0; i < stored; i++)
+    {
+        if (depth + i >= key_len || node->prefix[i] != key[depth + i])
+            return i;
+    }
+
+    if (node->prefix_len > ART_MAX_PREFIX)
+    {
+        ArtLeaf *leaf = minimum(node);
+        for (; i < node->prefix_len; i++)
+        {
+            if (depth + i >= key_len || leaf->key[depth + i] != key[depth + i])
+                return i;
+        }
+    }
+    return i;
+}
+
+// Grow-free insert of a child into a node known to have room
+static void add_child_room(ArtNode *node, unsigned char c, void *child)
+{
+    switch (node->type)
+    {
+    case NODE4:
+    case NODE16:
+    {
+        unsigned char *keys = node->type == NODE4 ? ((ArtNode4 *)node)->keys : ((ArtNode16 *)node)->keys;
+        void **children = node->type == NODE4 ? ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        int pos = 0;
+        while (pos < node->num_children && keys[pos] < c)
+            pos++;
+        memmove(keys + pos + 1, keys + pos, node->num_children - pos);
+        memmove(children + pos + 1, children + pos, (node->num_children - pos) * sizeof(void *));
+        keys[pos] = c;
+        children[pos] = child;
+        break;
+    }
+    case NODE48:
+    {
+        ArtNode48 *n = (ArtNode48 *)node;
+        int pos = 0;
+        while (n->children[pos])
+            pos++;
+        n->children[pos] = child;
+        n->child_index[c] = pos + 1;
+        break;
+    }
+    default:
+        ((ArtNode256 *)node)->children[c] = child;
+        break;
+    }
+    node->num_children++;
+}
+
+// Copy the header of a node into a node of another size
+static void copy_header(ArtNode *dst, ArtNode *src)
+{
+    dst->num_children = src->num_children;
+    dst->prefix_len = src->prefix_len;
+    dst->end_leaf = src->end_leaf;
+    memcpy(dst->prefix, src->prefix, ART_MAX_PREFIX);
+}
+
+// Add a child, growing the node (and updating *ref) when it is full
+static bool add_child(void **ref, ArtNode *node, unsigned char c, void *child)
+{
+    static const int capacity[4] = {4, 16, 48, 256};
+
+    if (node->num_children < capacity[node->type])
+    {
+        add_child_room(node, c, child);
+        return true;
+    }
+
+    ArtNode *bigger = alloc_node(node->type + 1);
+    if (!bigger)
+        return false;
+    copy_header(bigger, node);
+
+    switch (node->type)
+    {
+    case NODE4:
+    {
+        ArtNode4 *from = (ArtNode4 *)node;
+        ArtNode16 *to = (ArtNode16 *)bigger;
+        memcpy(to->keys, from->keys, 4);
+        memcpy(to->children, from->children, 4 * sizeof(void *));
+        break;
+    }
+    case NODE16:
+    {
+        ArtNode16 *from = (ArtNode16 *)node;
+        ArtNode48 *to = (ArtNode48 *)bigger;
+        for (int i = 0; i < 16; i++)
+        {
+            to->children[i] = from->children[i];
+            to->child_index[from->keys[i]] = i + 1;
+        }
+        break;
+    }
+    default:
+    {
+        ArtNode48 *from = (ArtNode48 *)node;
+        ArtNode256 *to = (ArtNode256 *)bigger;
+        for (int c2 = 0; c2 < 256; c2++)
+        {
+            if (from->child_index[c2])
+                to->children[c2] = from->children[from->child_index[c2] - 1];
+        }
+        break;
+    }
+    }
+
+    add_child_room(bigger, c, child);
+    *ref = bigger;
+    free_inner(node);
+    return true;
+}
+
+static void remove_child(ArtNode *node, unsigned char c, void **slot)
+{
+    switch (node->type)
+    {
+    case NODE4:
+    case NODE16:
+    {
+        unsigned char *keys = node->type == NODE4 ? ((ArtNode4 *)node)->keys : ((ArtNode16 *)node)->keys;
+        void **children = node->type == NODE4 ? ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        int pos = (int)(slot - children);
+        memmove(keys + pos, keys + pos + 1, node->num_children - 1 - pos);
+        memmove(children + pos, children + pos + 1, (node->num_children - 1 - pos) * sizeof(void *));
+        break;
+    }
+    case NODE48:
+    {
+        ArtNode48 *n = (ArtNode48 *)node;
+        n->children[n->child_index[c] - 1] = NULL;
+        n->child_index[c] = 0;
+        break;
+    }
+    default:
+        ((ArtNode256 *)node)->children[c] = NULL;
+        break;
+    }
+    node->num_children--;
+}
+
+// Shrink or collapse a node after one of its entries was removed
+static void shrink_node(void **ref, ArtNode *node)
+{
+    if (node->num_children == 0)
+    {
+        // Only the end leaf (if any) is left
+        *ref = node->end_leaf ? SET_LEAF(node->end_leaf) : NULL;
+        free_inner(node);
+        return;
+    }
+
+    if (node->type == NODE4 && node->num_children == 1 && !node->end_leaf)
+    {
+        // Path compression: merge this node into its only child
+        ArtNode4 *n = (ArtNode4 *)node;
+        void *child = n->children[0];
+        if (!IS_LEAF(child))
+        {
+            ArtNode *cn = (ArtNode *)child;
+            unsigned char merged[ART_MAX_PREFIX];
+            size_t len = MIN(node->prefix_len, ART_MAX_PREFIX);
+            memcpy(merged, node->prefix, len);
+            if (len < ART_MAX_PREFIX)
+                merged[len++] = n->keys[0];
+            if (len < ART_MAX_PREFIX)
+            {
+                size_t take = MIN(cn->prefix_len, ART_MAX_PREFIX - len);
+                memcpy(merged + len, cn->prefix, take);
+                len += take;
+            }
+            memcpy(cn->prefix, merged, len);
+            cn->prefix_len += node->prefix_len + 1;
+        }
+        *ref = child;
+        free_inner(node);
+        return;
+    }
+
+    static const int shrink_at[4] = {0, 3, 12, 37};
+    if (node->type == NODE4 || node->num_children > shrink_at[node->type])
+        return;
+
+    ArtNode *smaller = alloc_node(node->type - 1);
+    if (!smaller)
+        return; // Keep the larger node; it is still valid
+    copy_header(smaller, node);
+
+    switch (node->type)
+    {
+    case NODE16:
+    {
+        ArtNode16 *from = (ArtNode16 *)node;
+        ArtNode4 *to = (ArtNode4 *)smaller;
+        memcpy(to->keys, from->keys, node->num_children);
+        memcpy(to->children, from->children, node->num_children * sizeof(void *));
+        break;
+    }
+    case NODE48:
+    {
+        ArtNode48 *from = (ArtNode48 *)node;
+        ArtNode16 *to = (ArtNode16 *)smaller;
+        int pos = 0;
+        for (int c = 0; c < 256; c++)
+        {
+            if (from->child_index[c])
+            {
+                to->keys[pos] = (unsigned char)c;
+                to->children[pos++] = from->children[from->child_index[c] - 1];
+            }
+        }
+        break;
+    }
+    default:
+    {
+        ArtNode256 *from = (ArtNode256 *)node;
+        ArtNode48 *to = (ArtNode48 *)smaller;
+        int pos = 0;
+        for (int c = 0; c < 256; c++)
+        {
+            if (from->children[c])
+            {
+                to->children[pos] = from->children[c];
+                to->child_index[c] = ++pos;
+            }
+        }
+        break;
+    }
+    }
+
+    *ref = smaller;
+    free_inner(node);
+}
+
+// Recursive insert. Returns 1 if inserted, 0 if the key exists, -1 on OOM.
+static int insert_rec(void **ref, const unsigned char *key, size_t key_len, size_t depth, ArtLeaf *leaf)
+{
+    void *p = *ref;
+
+    if (!p)
+    {
+        *ref = SET_LEAF(leaf);
+        return 1;
+    }
+
+    if (IS_LEAF(p))
+    {
+        ArtLeaf *old = LEAF_RAW(p);
+        if (leaf_matches(old, key, key_len))
+            return 0;
+
+        // Split the leaf into a Node4 holding both keys
+        size_t lcp = 0;
+        while (depth + lcp < old->key_len && depth + lcp < key_len &&
+               old->key[depth + lcp] == key[depth + lcp])
+            lcp++;
+
+        ArtNode *node = alloc_node(NODE4);
+        if (!node)
+            return -1;
+        node->prefix_len = (uint32_t)lcp;
+        memcpy(node->prefix, key + depth, MIN(lcp, ART_MAX_PREFIX));
+        depth += lcp;
+
+        if (old->key_len == depth)
+            node->end_leaf = old;
+        else
+            add_child_room(node, old->key[depth], p);
+
+        if (key_len == depth)
+            node->end_leaf = leaf;
+        else
+            add_child_room(node, key[depth], SET_LEAF(leaf));
+
+        *ref = node;
+        return 1;
+    }
+
+    ArtNode *node = (ArtNode *)p;
+    if (node->prefix_len)
+    {
+        size_t match = prefix_mismatch(node, key, key_len, depth);
+        if (match < node->prefix_len)
+        {
+            // Split the compressed path at the first differing byte
+            ArtNode *parent = alloc_node(NODE4);
+            if (!parent)
+                return -1;
+            parent->prefix_len = (uint32_t)match;
+            memcpy(parent->prefix, node->prefix, MIN(match, ART_MAX_PREFIX));
+
+            const unsigned char *full = node->prefix;
+            if (node->prefix_len > ART_MAX_PREFIX)
+                full = minimum(node)->key + depth;
+
+            unsigned char edge = full[match];
+            uint32_t rest = node->prefix_len - (uint32_t)match - 1;
+            memmove(node->prefix, full + match + 1, MIN(rest, ART_MAX_PREFIX));
+            node->prefix_len = rest;
+            add_child_room(parent, edge, node);
+
+            if (depth + match == key_len)
+                parent->end_leaf = leaf;
+            else
+                add_child_room(parent, key[depth + match], SET_LEAF(leaf));
+
+            *ref = parent;
+            return 1;
+        }
+        depth += node->prefix_len;
+    }
+
+    if (depth == key_len)
+    {
+        if (node->end_leaf)
+            return 0;
+        node->end_leaf = leaf;
+        return 1;
+    }
+
+    void **child = find_child(node, key[depth]);
+    if (child)
+        return insert_rec(child, key, key_len, depth + 1, leaf);
+
+    return add_child(ref, node, key[depth], SET_LEAF(leaf)) ? 1 : -1;
+}
+
+// Recursive delete. Returns the removed leaf or NULL.
+static ArtLeaf *delete_rec(void **ref, const unsigned char *key, size_t key_len, size_t depth)
+{
+    void *p = *ref;
+    if (!p)
+        return NULL;
+
+    if (IS_LEAF(p))
+    {
+        ArtLeaf *leaf = LEAF_RAW(p);
+        if (!leaf_matches(leaf, key, key_len))
+            return NULL;
+        *ref = NULL;
+        return leaf;
+    }
+
+    ArtNode *node = (ArtNode *)p;
+    if (node->prefix_len)
+    {
+        if (prefix_mismatch(node, key, key_len, depth) != node->prefix_len)
+            return NULL;
+        depth += node->prefix_len;
+    }
+
+    if (depth == key_len)
+    {
+        ArtLeaf *leaf = node->end_leaf;
+        if (!leaf)
+            return NULL;
+        node->end_leaf = NULL;
+        shrink_node(ref, node);
+        return leaf;
+    }
+
+    void **child = find_child(node, key[depth]);
+    if (!child)
+        return NULL;
+
+    if (IS_LEAF(*child))
+    {
+        ArtLeaf *leaf = LEAF_RAW(*child);
+        if (!leaf_matches(leaf, key, key_len))
+            return NULL;
+        remove_child(node, key[depth], child);
+        shrink_node(ref, node);
+        return leaf;
+    }
+
+    return delete_rec(child, key, key_len, depth + 1);
+}
+
+// Smallest leaf >= key (or > key when strict) below p
+static ArtLeaf *lower_bound(void *p, const unsigned char *key, size_t key_len, size_t depth, bool strict)
+{
+    if (!p)
+        return NULL;
+
+    if (IS_LEAF(p))
+    {
+        ArtLeaf *leaf = LEAF_RAW(p);
+        int cmp = leaf_compare(leaf, key, key_len);
+        return (cmp > 0 || (cmp == 0 && !strict)) ? leaf : NULL;
+    }
+
+    ArtNode *node = (ArtNode *)p;
+    if (node->prefix_len)
+    {
+        size_t match = prefix_mismatch(node, key, key_len, depth);
+        if (match < node->prefix_len)
+        {
+            // Key ran out inside the prefix: the whole subtree is greater
+            if (depth + match >= key_len)
+                return minimum(node);
+
+            const unsigned char *full = node->prefix;
+            if (node->prefix_len > ART_MAX_PREFIX)
+                full = minimum(node)->key + depth;
+            return full[match] > key[depth + match] ? minimum(node) : NULL;
+        }
+        depth += node->prefix_len;
+    }
+
+    if (depth == key_len)
+    {
+        // The end leaf equals the key; everything in the children is greater
+        if (node->end_leaf && !strict)
+            return node->end_leaf;
+        return minimum(first_child(node));
+    }
+
+    unsigned char c = key[depth];
+    void **child = find_child(node, c);
+    if (child)
+    {
+        ArtLeaf *result = lower_bound(*child, key, key_len, depth + 1, strict);
+        if (result)
+            return result;
+    }
+
+    // First child with a byte greater than c
+    switch (node->type)
+    {
+    case NODE4:
+    case NODE16:
+    {
+        unsigned char *keys = node->type == NODE4 ? ((ArtNode4 *)node)->keys : ((ArtNode16 *)node)->keys;
+        void **children = node->type == NODE4 ? ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        for (int i = 0; i < node->num_children; i++)
+        {
+            if (keys[i] > c)
+                return minimum(children[i]);
+        }
+        return NULL;
+    }
+    case NODE48:
+    {
+        ArtNode48 *n = (ArtNode48 *)node;
+        for (int c2 = c + 1; c2 < 256; c2++)
+        {
+            if (n->child_index[c2])
+                return minimum(n->children[n->child_index[c2] - 1]);
+        }
+        return NULL;
+    }
+    default:
+    {
+        ArtNode256 *n = (ArtNode256 *)node;
+        for (int c2 = c + 1; c2 < 256; c2++)
+        {
+            if (n->children[c2])
+                return minimum(n->children[c2]);
+        }
+        return NULL;
+    }
+    }
+}
+
+// Largest leaf < key (or <= key when inclusive) below p
+static ArtLeaf *reverse_bound(void *p, const unsigned char *key, size_t key_len, size_t depth, bool inclusive)
+{
+    if (!p)
+        return NULL;
+
+    if (IS_LEAF(p))
+    {
+        ArtLeaf *leaf = LEAF_RAW(p);
+        int cmp = leaf_compare(leaf, key, key_len);
+        return (cmp < 0 || (cmp == 0 && inclusive)) ? leaf : NULL;
+    }
+
+    ArtNode *node = (ArtNode *)p;
+    if (node->prefix_len)
+    {
+        size_t match = prefix_mismatch(node, key, key_len, depth);
+        if (match < node->prefix_len)
+        {
+            // Key ran out inside the prefix: the whole subtree is greater
+            if (depth + match >= key_len)
+                return NULL;
+
+            const unsigned char *full = node->prefix;
+            if (node->prefix_len > ART_MAX_PREFIX)
+                full = minimum(node)->key + depth;
+            return full[match] < key[depth + match] ? maximum(node) : NULL;
+        }
+        depth += node->prefix_len;
+    }
+
+    if (depth == key_len)
+    {
+        // The end leaf equals the key; everything in the children is greater
+        return inclusive ? node->end_leaf : NULL;
+    }
+
+    unsigned char c = key[depth];
+    void **child = find_child(node, c);
+    if (child)
+    {
+        ArtLeaf *result = reverse_bound(*child, key, key_len, depth + 1, inclusive);
+        if (result)
+            return result;
+    }
+
+    // Last child with a byte smaller than c, else the end leaf (a proper
+    // prefix of key, so smaller than it)
+    switch (node->type)
+    {
+    case NODE4:
+    case NODE16:
+    {
+        unsigned char *keys = node->type == NODE4 ? ((ArtNode4 *)node)->keys : ((ArtNode16 *)node)->keys;
+        void **children = node->type == NODE4 ? ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        for (int i = node->num_children - 1; i >= 0; i--)
+        {
+            if (keys[i] < c)
+                return maximum(children[i]);
+        }
+        break;
+    }
+    case NODE48:
+    {
+        ArtNode48 *n = (ArtNode48 *)node;
+        for (int c2 = c - 1; c2 >= 0; c2--)
+        {
+            if (n->child_index[c2])
+                return maximum(n->children[n->child_index[c2] - 1]);
+        }
+        break;
+    }
+    default:
+    {
+        ArtNode256 *n = (ArtNode256 *)node;
+        for (int c2 = c - 1; c2 >= 0; c2--)
+        {
+            if (n->children[c2])
+                return maximum(n->children[c2]);
+        }
+        break;
+    }
+    }
+    return node->end_leaf;
+}
+
+// Free a subtree (nodes and leaves)
+static void destroy_rec(void *p)
+{
+    if (!p)
+        return;
+    if (IS_LEAF(p))
+    {
+        free(LEAF_RAW(p));
+        return;
+    }
+
+    ArtNode *node = (ArtNode *)p;
+    free(node->end_leaf);
+
+    switch (node->type)
+    {
+    case NODE4:
+        for (int i = 0; i < node->num_children; i++)
+            destroy_rec(((ArtNode4 *)node)->children[i]);
+        break;
+    case NODE16:
+        for (int i = 0; i < node->num_children; i++)
+            destroy_rec(((ArtNode16 *)node)->children[i]);
+        break;
+    case NODE48:
+        for (int i = 0; i < 48; i++)
+            destroy_rec(((ArtNode48 *)node)->children[i]);
+        break;
+    default:
+        for (int i = 0; i < 256; i++)
+            destroy_rec(((ArtNode256 *)node)->children[i]);
+        break;
+    }
+    free_inner(node);
+}
+
+// Create / destroy a tree (destroy frees nodes and leaves, not the data)
+ArtTree *art_create(void)
+{
+    ArtTree *tree = (ArtTree *)malloc(sizeof(ArtTree));
+    if (!tree)
+        return NULL;
+    tree->root = NULL;
+    tree->size = 0;
+    pthread_rwlock_init(&tree->latch, NULL);
+    return tree;
+}
+
+void art_destroy(ArtTree *tree)
+{
+    if (!tree)
+        return;
+    destroy_rec(tree->root);
+    pthread_rwlock_destroy(&tree->latch);
+    free(tree);
+}
+
+// Look up a key. Returns true and fills data/size if found.
+bool art_search(ArtTree *tree, const unsigned char *key, size_t key_len, void **data, size_t *size)
+{
+    pthread_rwlock_rdlock(&tree->latch);
+
+    void *p = tree->root;
+    size_t depth = 0;
+    ArtLeaf *found = NULL;
+
+    while (p)
+    {
+        if (IS_LEAF(p))
+        {
+            ArtLeaf *leaf = LEAF_RAW(p);
+            if (leaf_matches(leaf, key, key_len))
+                found = leaf;
+            break;
+        }
+
+        ArtNode *node = (ArtNode *)p;
+        if (node->prefix_len)
+        {
+            // Optimistic: only the stored bytes are checked here, the
+            // leaf comparison at the end catches the rest
+            size_t stored = MIN(node->prefix_len, ART_MAX_PREFIX);
+            if (depth + node->prefix_len > key_len ||
+                memcmp(node->prefix, key + depth, stored) != 0)
+                break;
+            depth += node->prefix_len;
+        }
+
+        if (depth == key_len)
+        {
+            if (node->end_leaf && leaf_matches(node->end_leaf, key, key_len))
+                found = node->end_leaf;
+            break;
+        }
+
+        void **child = find_child(node, key[depth]);
+        p = child ? *child : NULL;
+        depth++;
+    }
+
+    if (found)
+    {
+        if (data)
+            *data = found->data;
+        if (size)
+            *size = found->size;
+    }
+
+    pthread_rwlock_unlock(&tree->latch);
+    return found != NULL;
+}
+
+// Insert a new key. Returns false if the key exists or memory ran out.
+bool art_insert(ArtTree *tree, const unsigned char *key, size_t key_len, void *data, size_t size)
+{
+    ArtLeaf *leaf = make_leaf(key, key_len, data, size);
+    if (!leaf)
+        return false;
+
+    pthread_rwlock_wrlock(&tree->latch);
+    int result = insert_rec(&tree->root, key, key_len, 0, leaf);
+    if (result == 1)
+        tree->size++;
+    pthread_rwlock_unlock(&tree->latch);
+
+    if (result != 1)
+        free(leaf);
+    return result == 1;
+}
+
+// Remove a key. Returns true and the old data/size if it was present.
+bool art_delete(ArtTree *tree, const unsigned char *key, size_t key_len, void **data, size_t *size)
+{
+    pthread_rwlock_wrlock(&tree->latch);
+    ArtLeaf *leaf = delete_rec(&tree->root, key, key_len, 0);
+    if (leaf)
+        tree->size--;
+    pthread_rwlock_unlock(&tree->latch);
+
+    if (!leaf)
+        return false;
+
+    if (data)
+        *data = leaf->data;
+    if (size)
+        *size = leaf->size;
+    free(leaf);
+    return true;
+}
+
+// Find the smallest key >= key (inclusive) or > key (exclusive)
+bool art_seek(ArtTree *tree, const unsigned char *key, size_t key_len, bool inclusive,
+              unsigned char *out_key, size_t out_cap, size_t *out_len)
+{
+    pthread_rwlock_rdlock(&tree->latch);
+
+    ArtLeaf *leaf = lower_bound(tree->root, key, key_len, 0, !inclusive);
+    if (leaf)
+    {
+        memcpy(out_key, leaf->key, MIN(leaf->key_len, out_cap));
+        if (out_len)
+            *out_len = leaf->key_len;
+    }
+
+    pthread_rwlock_unlock(&tree->latch);
+    return leaf != NULL;
+}
+
+// Find the largest key < key, or <= key when inclusive (key NULL: the last key)
+bool art_seek_prev(ArtTree *tree, const unsigned char *key, size_t key_len, bool inclusive,
+                   unsigned char *out_key, size_t out_cap, size_t *out_len)
+{
+    pthread_rwlock_rdlock(&tree->latch);
+
+    ArtLeaf *leaf = key ? reverse_bound(tree->root, key, key_len, 0, inclusive) : maximum(tree->root);
+    if (leaf)
+    {
+        memcpy(out_key, leaf->key, MIN(leaf->key_len, out_cap));
+        if (out_len)
+            *out_len = leaf->key_len;
+    }
+
+    pthread_rwlock_unlock(&tree->latch);
+    return leaf != NULL;
+}
+
+// Number of keys in the tree
+long art_size(ArtTree *tree)
+{
+    return tree ? tree->size : 0;
+}
@@ -0,0 +1,583 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h> // SSE2 for tag matching
+#include "../include/cuckoo_hash.h"
+
+// Slot of a breadth-first cuckoo path search
+typedef struct PathNode
+{
+    size_t bucket; // Bucket reached
+    int parent;    // Index of the node we came from (-1 for a start bucket)
+    int slot;      // Slot in the parent bucket whose key moves here
+} PathNode;
+
+// 64-bit mix of the key (splitmix64 finalizer)
+static uint64_t hash_key(int key)
+{
+    uint64_t h = (uint64_t)(uint32_t)key + 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+static uint8_t tag_of(uint64_t h)
+{
+    uint8_t tag = (uint8_t)(h >> 56);
+    return tag ? tag : 1;
+}
+
+static size_t bucket1(uint64_t h, size_t num_buckets)
+{
+    return h & (num_buckets - 1);
+}
+
+static size_t bucket2(uint64_t h, size_t num_buckets)
+{
+    return ((h >> 32) * 0x5bd1e995ULL) & (num_buckets - 1);
+}
+
+static uint32_t *key_version(CuckooHash *hash, uint64_t h)
+{
+    return &hash->key_versions[(h >> 16) & (CUCKOO_VERSION_STRIPES - 1)];
+}
+
+// Writers make a key's version odd while it is changed or moved
+static void begin_key_write(uint32_t *version)
+{
+    __atomic_add_fetch(version, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void end_key_write(uint32_t *version)
+{
+    __atomic_add_fetch(version, 1, __ATOMIC_RELEASE);
+}
+
+// Slot holding key in a bucket, or -1
+static int find_in_bucket(const CuckooBucket *bucket, uint8_t tag, int key)
+{
+    __m128i tags = _mm_loadl_epi64((const __m128i *)bucket->tags);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(tags, _mm_set1_epi8((char)tag))) & 0xFF;
+
+    while (mask)
+    {
+        int slot = __builtin_ctz(mask);
+        if (bucket->keys[slot] == key)
+            return slot;
+        mask &= mask - 1;
+    }
+    return -1;
+}
+
+// First empty slot of a bucket, or -1
+static int free_slot(const CuckooBucket *bucket)
+{
+    for (int slot = 0; slot < CUCKOO_SLOTS; slot++)
+    {
+        if (bucket->tags[slot] == 0)
+            return slot;
+    }
+    return -1;
+}
+
+static CuckooTable *alloc_table(size_t num_buckets)
+{
+    CuckooTable *table = (CuckooTable *)malloc(sizeof(CuckooTable));
+    if (!table)
+        return NULL;
+
+    table->num_buckets = num_buckets;
+    table->buckets = (CuckooBucket *)aligned_alloc(64, num_buckets * sizeof(CuckooBucket));
+    table->values = (CuckooValue *)calloc(num_buckets * CUCKOO_SLOTS, sizeof(CuckooValue));
+    table->retired_next = NULL;
+
+    if (!table->buckets || !table->values)
+    {
+        free(table->buckets);
+        free(table->values);
+        free(table);
+        return NULL;
+    }
+
+    memset(table->buckets, 0, num_buckets * sizeof(CuckooBucket));
+    return table;
+}
+
+static void free_table(CuckooTable *table)
+{
+    free(table->buckets);
+    free(table->values);
+    free(table);
+}
+
+// Write a key into an empty slot (tag last, so readers never see a
+// tag without its key)
+static void fill_slot(CuckooTable *table, size_t b, int slot, uint8_t tag, int key, void *data, size_t size)
+{
+    CuckooValue *value = &table->values[b * CUCKOO_SLOTS + slot];
+    value->data = data;
+    value->size = size;
+    table->buckets[b].keys[slot] = key;
+    __atomic_store_n(&table->buckets[b].tags[slot], tag, __ATOMIC_RELEASE);
+}
+
+// Insert a key that is known to be absent, moving other keys along a
+// cuckoo path if both buckets are full. Caller holds the table
+// exclusively (resize_latch for writing). Returns false if no path exists.
+static bool insert_with_path(CuckooHash *hash, CuckooTable *table, int key, void *data, size_t size)
+{
+    uint64_t h = hash_key(key);
+    PathNode queue[CUCKOO_MAX_KICKS];
+    int head = 0, tail = 0;
+
+    queue[tail++] = (PathNode){bucket1(h, table->num_buckets), -1, -1};
+    queue[tail++] = (PathNode){bucket2(h, table->num_buckets), -1, -1};
+
+    while (head < tail)
+    {
+        int idx = head++;
+        int slot = free_slot(&table->buckets[queue[idx].bucket]);
+
+        if (slot >= 0)
+        {
+            // Walk the path back, moving each key into the hole ahead of it
+            int cur = idx;
+            while (queue[cur].parent != -1)
+            {
+                int parent = queue[cur].parent;
+                size_t from_b = queue[parent].bucket;
+                int from_s = queue[cur].slot;
+                CuckooBucket *from = &table->buckets[from_b];
+                CuckooValue *from_v = &table->values[from_b * CUCKOO_SLOTS + from_s];
+                int moved_key = from->keys[from_s];
+                uint32_t *version = key_version(hash, hash_key(moved_key));
+
+                begin_key_write(version);
+                fill_slot(table, queue[cur].bucket, slot, from->tags[from_s], moved_key, from_v->data, from_v->size);
+                __atomic_store_n(&from->tags[from_s], 0, __ATOMIC_RELEASE);
+                end_key_write(version);
+
+                slot = from_s;
+                cur = parent;
+            }
+
+            uint32_t *version = key_version(hash, h);
+            begin_key_write(version);
+            fill_slot(table, queue[cur].bucket, slot, tag_of(h), key, data, size);
+            end_key_write(version);
+            return true;
+        }
+
+        // Every key in this bucket could move to its other bucket
+        CuckooBucket *bucket = &table->buckets[queue[idx].bucket];
+        for (int s = 0; s < CUCKOO_SLOTS && tail < CUCKOO_MAX_KICKS; s++)
+        {
+            uint64_t kh = hash_key(bucket->keys[s]);
+            size_t b1 = bucket1(kh, table->num_buckets);
+            size_t alt = (b1 == queue[idx].bucket) ? bucket2(kh, table->num_buckets) : b1;
+
+            // A path must not pass through the same bucket twice
+            bool on_path = false;
+            for (int p = idx; p != -1 && !on_path; p = queue[p].parent)
+                on_path = (queue[p].bucket == alt);
+            if (!on_path)
+                queue[tail++] = (PathNode){alt, idx, s};
+        }
+    }
+
+    return false;
+}
+
+// Double the number of buckets. Caller holds resize_latch for writing.
+static bool grow(CuckooHash *hash)
+{
+    CuckooTable *old = hash->table;
+    size_t num_buckets = old->num_buckets * 2;
+
+    for (;;)
+    {
+        CuckooTable *table = alloc_table(num_buckets);
+        if (!table)
+            return false;
+
+        // Readers retry while the sequence is odd
+        __atomic_add_fetch(&hash->resize_seq, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        bool ok = true;
+        for (size_t b = 0; b < old->num_buckets && ok; b++)
+        {
+            for (int s = 0; s < CUCKOO_SLOTS && ok; s++)
+            {
+                if (old->buckets[b].tags[s] == 0)
+                    continue;
+                CuckooValue *v = &old->values[b * CUCKOO_SLOTS + s];
+                ok = insert_with_path(hash, table, old->buckets[b].keys[s], v->data, v->size);
+            }
+        }
+
+        if (ok)
+        {
+            // Old storage may still be read by lock-free readers
+            table->retired_next = old;
+            __atomic_store_n(&hash->table, table, __ATOMIC_RELEASE);
+            __atomic_add_fetch(&hash->resize_seq, 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        // Pathological clustering: try again with more room
+        __atomic_add_fetch(&hash->resize_seq, 1, __ATOMIC_RELEASE);
+        free_table(table);
+        num_buckets *= 2;
+    }
+}
+
+// Lock the writer stripes of two buckets in a fixed order
+static void lock_buckets(CuckooHash *hash, size_t b1, size_t b2)
+{
+    size_t s1 = b1 & (CUCKOO_LOCK_STRIPES - 1);
+    size_t s2 = b2 & (CUCKOO_LOCK_STRIPES - 1);
+
+    if (s1 > s2)
+    {
+        size_t tmp = s1;
+        s1 = s2;
+        s2 = tmp;
+    }
+    pthread_mutex_lock(&hash->stripes[s1]);
+    if (s2 != s1)
+        pthread_mutex_lock(&hash->stripes[s2]);
+}
+
+static void unlock_buckets(CuckooHash *hash, size_t b1, size_t b2)
+{
+    size_t s1 = b1 & (CUCKOO_LOCK_STRIPES - 1);
+    size_t s2 = b2 & (CUCKOO_LOCK_STRIPES - 1);
+
+    pthread_mutex_unlock(&hash->stripes[s1]);
+    if (s2 != s1)
+        pthread_mutex_unlock(&hash->stripes[s2]);
+}
+
+// Create / destroy a hash (destroy does not free the row data)
+CuckooHash *cuckoo_create(size_t initial_capacity)
+{
+    CuckooHash *hash = (CuckooHash *)calloc(1, sizeof(CuckooHash));
+    if (!hash)
+        return NULL;
+
+    size_t num_buckets = 16;
+    while (num_buckets * CUCKOO_SLOTS < initial_capacity)
+        num_buckets *= 2;
+
+    hash->table = alloc_table(num_buckets);
+    if (!hash->table)
+    {
+        free(hash);
+        return NULL;
+    }
+
+    for (int i = 0; i < CUCKOO_LOCK_STRIPES; i++)
+        pthread_mutex_init(&hash->stripes[i], NULL);
+    pthread_rwlock_init(&hash->resize_latch, NULL);
+    pthread_mutex_init(&hash->view_mutex, NULL);
+
+    return hash;
+}
+
+void cuckoo_destroy(CuckooHash *hash)
+{
+    if (!hash)
+        return;
+
+    CuckooTable *table = hash->table;
+    while (table)
+    {
+        CuckooTable *next = table->retired_next;
+        free_table(table);
+        table = next;
+    }
+
+    for (int i = 0; i < CUCKOO_LOCK_STRIPES; i++)
+        pthread_mutex_destroy(&hash->stripes[i]);
+    pthread_rwlock_destroy(&hash->resize_latch);
+    pthread_mutex_destroy(&hash->view_mutex);
+
+    free(hash->view_keys);
+    free(hash);
+}
+
+// Look up a key. Returns true and fills data/size if found.
+bool cuckoo_get(CuckooHash *hash, int key, void **data, size_t *size)
+{
+    uint64_t h = hash_key(key);
+    uint8_t tag = tag_of(h);
+    uint32_t *version = key_version(hash, h);
+
+    for (;;)
+    {
+        uint32_t seq = __atomic_load_n(&hash->resize_seq, __ATOMIC_ACQUIRE);
+        uint32_t ver = __atomic_load_n(version, __ATOMIC_ACQUIRE);
+        if ((seq | ver) & 1)
+        {
+            _mm_pause();
+            continue;
+        }
+
+        CuckooTable *table = __atomic_load_n(&hash->table, __ATOMIC_ACQUIRE);
+        size_t buckets[2] = {bucket1(h, table->num_buckets), bucket2(h, table->num_buckets)};
+        CuckooValue value = {NULL, 0};
+        bool found = false;
+
+        for (int i = 0; i < 2 && !found; i++)
+        {
+            int slot = find_in_bucket(&table->buckets[buckets[i]], tag, key);
+            if (slot >= 0)
+            {
+                value = table->values[buckets[i] * CUCKOO_SLOTS + slot];
+                found = true;
+            }
+        }
+
+        // Valid only if nobody touched this key or the table meanwhile
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(version, __ATOMIC_RELAXED) != ver ||
+            __atomic_load_n(&hash->resize_seq, __ATOMIC_RELAXED) != seq)
+            continue;
+
+        if (found)
+        {
+            if (data)
+                *data = value.data;
+            if (size)
+                *size = value.size;
+        }
+        return found;
+    }
+}
+
+// Insert a new key. Returns false if the key exists or memory ran out.
+bool cuckoo_put(CuckooHash *hash, int key, void *data, size_t size)
+{
+    uint64_t h = hash_key(key);
+    uint8_t tag = tag_of(h);
+
+    // Fast path: a free slot in one of the two buckets
+    pthread_rwlock_rdlock(&hash->resize_latch);
+    CuckooTable *table = hash->table;
+    size_t b1 = bucket1(h, table->num_buckets);
+    size_t b2 = bucket2(h, table->num_buckets);
+    lock_buckets(hash, b1, b2);
+
+    if (find_in_bucket(&table->buckets[b1], tag, key) >= 0 ||
+        find_in_bucket(&table->buckets[b2], tag, key) >= 0)
+    {
+        unlock_buckets(hash, b1, b2);
+        pthread_rwlock_unlock(&hash->resize_latch);
+        return false;
+    }
+
+    size_t b = b1;
+    int slot = free_slot(&table->buckets[b1]);
+    if (slot < 0)
+    {
+        b = b2;
+        slot = free_slot(&table->buckets[b2]);
+    }
+
+    if (slot >= 0)
+    {
+        uint32_t *version = key_version(hash, h);
+        begin_key_write(version);
+        fill_slot(table, b, slot, tag, key, data, size);
+        end_key_write(version);
+
+        __atomic_add_fetch(&hash->size, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&hash->mod_count, 1, __ATOMIC_RELEASE);
+        unlock_buckets(hash, b1, b2);
+        pthread_rwlock_unlock(&hash->resize_latch);
+        return true;
+    }
+
+    unlock_buckets(hash, b1, b2);
+    pthread_rwlock_unlock(&hash->resize_latch);
+
+    // Slow path: both buckets full, displace keys with writers excluded
+    pthread_rwlock_wrlock(&hash->resize_latch);
+    table = hash->table;
+    b1 = bucket1(h, table->num_buckets);
+    b2 = bucket2(h, table->num_buckets);
+
+    bool inserted = false;
+    if (find_in_bucket(&table->buckets[b1], tag, key) < 0 &&
+        find_in_bucket(&table->buckets[b2], tag, key) < 0)
+    {
+        while (!(inserted = insert_with_path(hash, hash->table, key, data, size)))
+        {
+            if (!grow(hash))
+                break;
+        }
+    }
+
+    if (inserted)
+    {
+        __atomic_add_fetch(&hash->size, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&hash->mod_count, 1, __ATOMIC_RELEASE);
+    }
+    pthread_rwlock_unlock(&hash->resize_latch);
+    return inserted;
+}
+
+// Remove a key. Returns true and the old data/size if it was present.
+bool cuckoo_delete(CuckooHash *hash, int key, void **data, size_t *size)
+{
+    uint64_t h = hash_key(key);
+    uint8_t tag = tag_of(h);
+
+    pthread_rwlock_rdlock(&hash->resize_latch);
+    CuckooTable *table = hash->table;
+    size_t b1 = bucket1(h, table->num_buckets);
+    size_t b2 = bucket2(h, table->num_buckets);
+    lock_buckets(hash, b1, b2);
+
+    size_t b = b1;
+    int slot = find_in_bucket(&table->buckets[b1], tag, key);
+    if (slot < 0)
+    {
+        b = b2;
+        slot = find_in_bucket(&table->buckets[b2], tag, key);
+    }
+
+    if (slot >= 0)
+    {
+        CuckooValue *value = &table->values[b * CUCKOO_SLOTS + slot];
+        if (data)
+            *data = value->data;
+        if (size)
+            *size = value->size;
+
+        uint32_t *version = key_version(hash, h);
+        begin_key_write(version);
+        __atomic_store_n(&table->buckets[b].tags[slot], 0, __ATOMIC_RELEASE);
+        end_key_write(version);
+
+        __atomic_sub_fetch(&hash->size, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&hash->mod_count, 1, __ATOMIC_RELEASE);
+    }
+
+    unlock_buckets(hash, b1, b2);
+    pthread_rwlock_unlock(&hash->resize_latch);
+    return slot >= 0;
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a;
+    int32_t y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Rebuild the sorted view. Caller holds view_mutex.
+static bool rebuild_view(CuckooHash *hash)
+{
+    // Exclude writers so the view is one consistent snapshot
+    pthread_rwlock_wrlock(&hash->resize_latch);
+
+    CuckooTable *table = hash->table;
+    long count = 0;
+    int32_t *keys = (int32_t *)malloc((hash->size + 1) * sizeof(int32_t));
+    if (!keys)
+    {
+        pthread_rwlock_unlock(&hash->resize_latch);
+        return false;
+    }
+
+    for (size_t b = 0; b < table->num_buckets; b++)
+    {
+        for (int s = 0; s < CUCKOO_SLOTS; s++)
+        {
+            if (table->buckets[b].tags[s])
+                keys[count++] = table->buckets[b].keys[s];
+        }
+    }
+    hash->view_mod_count = hash->mod_count;
+
+    pthread_rwlock_unlock(&hash->resize_latch);
+
+    qsort(keys, count, sizeof(int32_t), compare_keys);
+    free(hash->view_keys);
+    hash->view_keys = keys;
+    hash->view_len = count;
+    return true;
+}
+
+// Make the sorted view current (view_mutex held)
+static bool ensure_view(CuckooHash *hash)
+{
+    if (hash->view_keys && hash->view_mod_count == __atomic_load_n(&hash->mod_count, __ATOMIC_ACQUIRE))
+        return true;
+    return rebuild_view(hash);
+}
+
+// Number of view keys < key (or <= key when past_equal)
+static long view_rank(CuckooHash *hash, int key, bool past_equal)
+{
+    long lo = 0, hi = hash->view_len;
+    while (lo < hi)
+    {
+        long mid = lo + (hi - lo) / 2;
+        int32_t k = hash->view_keys[mid];
+        if (k < key || (past_equal && k == key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Smallest key > key (or >= when inclusive) using the sorted view
+bool cuckoo_next_key(CuckooHash *hash, int key, bool inclusive, int *next_key)
+{
+    pthread_mutex_lock(&hash->view_mutex);
+
+    if (!ensure_view(hash))
+    {
+        pthread_mutex_unlock(&hash->view_mutex);
+        return false;
+    }
+
+    long pos = view_rank(hash, key, !inclusive);
+    bool found = pos < hash->view_len;
+    if (found)
+        *next_key = hash->view_keys[pos];
+
+    pthread_mutex_unlock(&hash->view_mutex);
+    return found;
+}
+
+// Largest key < key (or <= when inclusive) using the sorted view
+bool cuckoo_prev_key(CuckooHash *hash, int key, bool inclusive, int *prev_key)
+{
+    pthread_mutex_lock(&hash->view_mutex);
+
+    if (!ensure_view(hash))
+    {
+        pthread_mutex_unlock(&hash->view_mutex);
+        return false;
+    }
+
+    long pos = view_rank(hash, key, inclusive) - 1;
+    bool found = pos >= 0;
+    if (found)
+        *prev_key = hash->view_keys[pos];
+
+    pthread_mutex_unlock(&hash->view_mutex);
+    return found;
+}
+
+// Number of keys
+long cuckoo_size(CuckooHash *hash)
+{
+    return hash ? __atomic_load_n(&hash->size, __ATOMIC_RELAXED) : 0;
+}
@@ -1,283 +1,1012 @@
+#define _GNU_SOURCE // accept4
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <signal.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
 #include "../include/ram_bptree.h"
 #include "../include/free_space.h"
 #include "../include/wal.h"
+#include "../include/nvram_protocol.h"
 #include <unistd.h>
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
 
-// Client handling function
-// FIXED Client handling function in db_main.c
-void *handle_client(void *arg)
+// Event loops: each has its own listening socket on PORT (SO_REUSEPORT
+// lets the kernel spread connections over them) and epoll set, and
+// serves the sessions it accepted until they close
+#define MAX_EVENTS 256                // epoll events taken per wake-up
+#define SESSION_MAX_INPUT (2 << 20)   // Input buffer limit (fits a frame with NV_MAX_VALUE)
+#define SESSION_READ_BATCH (64 * 1024) // Most bytes read before running what came in
+#define OUT_BLOCK_SIZE (16 * 1024)     // Replies gathered per output block
+#define FLUSH_IOVECS 64                // Output blocks one writev takes
+
+// What a session speaks, settled by its first bytes
+typedef enum
+{
+    PROTOCOL_UNKNOWN, // Nothing received yet
+    PROTOCOL_TEXT,    // Newline-terminated commands
+    PROTOCOL_BINARY   // Frames of nvram_protocol.h
+} SessionProtocol;
+
+// A block of replies waiting to be sent. Replies are appended to the last
+// block and never move, however many a pipelined batch produces.
+typedef struct OutBlock
 {
-    int client_socket = *(int *)arg;
-    free(arg);
+    struct OutBlock *next;
+    size_t len, cap;
+    char data[];
+} OutBlock;
 
-    Table *current_table = NULL;
-    int current_txn_id = -1;
-    char buffer[BUFFER_SIZE * 2]; // Make buffer larger to handle leftovers
-    char *buffer_ptr = buffer;    // Pointer to the end of current data
-    int bytes_in_buffer = 0;
+// One client connection, touched only by its event loop's thread. An idle
+// session is just this and its buffers.
+typedef struct Session
+{
+    int fd;
+    SessionProtocol protocol;
+    Table *current_table;
+    int current_txn_id;
+    char *in;           // Received bytes not yet executed (NUL terminated)
+    size_t in_len, in_cap;
+    OutBlock *out, *out_tail; // Replies not yet sent
+    size_t out_sent;          // Bytes of the first block already sent
+    bool writing;       // Waiting for EPOLLOUT (reads pause meanwhile)
+    bool closing;       // Close once out is sent
+} Session;
 
-    memset(buffer, 0, sizeof(buffer));
+typedef struct EventLoop
+{
+    int epoll_fd;
+    int listen_fd;
+    pthread_t thread;
+} EventLoop;
 
-    while (1)
+// Queue a reply. The replies to everything read in one batch leave
+// together, in order, once the batch has run.
+static void session_reply(Session *s, const char *data, size_t len)
+{
+    while (len > 0)
     {
-        // Read new data and append it to our buffer
-        int n = recv(client_socket, buffer_ptr, BUFFER_SIZE, 0);
-        if (n <= 0)
+        OutBlock *b = s->out_tail;
+        if (!b || b->len == b->cap)
         {
-            break; // Connection closed or error
+            size_t cap = len > OUT_BLOCK_SIZE ? len : OUT_BLOCK_SIZE;
+            b = malloc(sizeof(OutBlock) + cap);
+            if (!b)
+            {
+                s->closing = true; // Can't answer: drop the connection
+                return;
+            }
+            b->next = NULL;
+            b->len = 0;
+            b->cap = cap;
+            if (s->out_tail)
+                s->out_tail->next = b;
+            else
+                s->out = b;
+            s->out_tail = b;
         }
-        bytes_in_buffer += n;
-        buffer_ptr += n;
 
-        char *command_start = buffer;
-        char *newline;
+        size_t n = b->cap - b->len < len ? b->cap - b->len : len;
+        memcpy(b->data + b->len, data, n);
+        b->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+// Transaction a multi-key command runs in: the session's if it has one
+// open, else one of its own for the whole batch (a snapshot for reads, a
+// deferred one for writes, which installs every row with one flush)
+static int batch_begin(Session *s, bool readonly)
+{
+    if (s->current_txn_id >= 0)
+        return s->current_txn_id;
+
+    int txn_id = readonly ? db_begin_readonly() : db_begin_transaction_mode(TXN_DEFERRED);
+    if (txn_id >= 0 && !readonly)
+        transaction_set_no_wait(&g_lock_manager, txn_id);
+    return txn_id;
+}
+
+// End a batch: commit its own transaction if every key went through, else
+// roll it back. The session's transaction stays open either way.
+static bool batch_end(Session *s, int txn_id, bool ok)
+{
+    if (txn_id == s->current_txn_id)
+        return ok;
+    if (ok)
+        return db_commit_transaction(txn_id);
+    db_abort_transaction(txn_id);
+    return false;
+}
+
+// Next space-separated token of a command, NULL at its end
+static char *next_token(char **ptr, size_t *len)
+{
+    char *p = *ptr;
+    while (*p == ' ') p++;
+    if (*p == '\0')
+        return NULL;
+
+    char *start = p;
+    while (*p != ' ' && *p != '\0') p++;
+    *len = p - start;
+    *ptr = p;
+    return start;
+}
+
+// MGET ROWS k1 k2 ...: one line per key
+static void session_mget(Session *s, char *ptr)
+{
+    int txn_id = batch_begin(s, true);
+    if (txn_id < 0)
+    {
+        session_reply(s, "Failed to start transaction\n", 28);
+        return;
+    }
 
-        // Process all complete commands currently in the buffer
-        while ((newline = strchr(command_start, '\n')) != NULL)
+    bool byte_keys = db_table_has_byte_keys(s->current_table);
+    char *key;
+    size_t key_len, size;
+    while ((key = next_token(&ptr, &key_len)) != NULL)
+    {
+        char *data = byte_keys ? db_get_row_bytes(s->current_table, txn_id, key, key_len, &size)
+                               : db_get_row(s->current_table, txn_id, atoi(key), &size);
+        char line[300];
+        int len = data ? snprintf(line, sizeof(line), "Row %.*s: ", (int)key_len, key)
+                       : snprintf(line, sizeof(line), "Row %.*s not found\n", (int)key_len, key);
+        session_reply(s, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+        if (data)
         {
-            *newline = '\0'; // Null-terminate the command
+            // Rows stored over the binary protocol need not end in a NUL
+            session_reply(s, data, strnlen(data, size));
+            session_reply(s, "\n", 1);
+        }
+    }
+    batch_end(s, txn_id, true);
+}
+
+// MPUT ROWS k1 'v1' k2 'v2' ... and MDEL ROWS k1 k2 ...: all keys or none
+// when run on their own, up to the failing key in a session transaction
+static void session_mwrite(Session *s, char *ptr, bool put)
+{
+    int txn_id = batch_begin(s, false);
+    if (txn_id < 0)
+    {
+        session_reply(s, "Failed to start transaction\n", 28);
+        return;
+    }
 
-            // Skip empty commands (which can happen with consecutive newlines)
-            if (strlen(command_start) > 0)
+    bool byte_keys = db_table_has_byte_keys(s->current_table);
+    bool ok = true;
+    int rows = 0;
+    char *key, *data = NULL, line[300];
+    size_t key_len, data_len = 0;
+    while (ok && (key = next_token(&ptr, &key_len)) != NULL)
+    {
+        if (put)
+        {
+            while (*ptr == ' ') ptr++;
+            char *end = *ptr == '\'' ? strchr(ptr + 1, '\'') : NULL;
+            if (!end)
             {
-                char command[32];
-                sscanf(command_start, "%s", command);
+                batch_end(s, txn_id, false);
+                session_reply(s, "Invalid format\n", 15);
+                return;
+            }
+            data = ptr + 1;
+            data_len = end - data;
+            *end = '\0'; // Stored with its NUL, as INSERT ROW does
+            ptr = end + 1;
+        }
 
-                if (strcmp(command, "CREATE") == 0 && strstr(command_start, "TABLE"))
-                {
-                    char table_name[64];
-                    sscanf(command_start, "CREATE TABLE %s", table_name);
-                    int table_id = db_create_table(table_name);
-                    if (table_id >= 0)
-                    {
-                        send(client_socket, "Table created\n", 14, 0);
-                    }
-                    else
-                    {
-                        send(client_socket, "Failed to create table\n", 23, 0);
-                    }
-                }
-                else if (strcmp(command, "USE") == 0 && strstr(command_start, "TABLE"))
-                {
-                    char table_name[64];
-                    sscanf(command_start, "USE TABLE %s", table_name);
-                    current_table = db_open_table(table_name);
-                    if (current_table)
-                    {
-                        send(client_socket, "Table opened\n", 13, 0);
-                    }
-                    else
-                    {
-                        send(client_socket, "Table not found\n", 16, 0);
-                    }
-                }
-                else if (strcmp(command, "BEGIN") == 0 && strstr(command_start, "TRANSACTION"))
-                {
-                    current_txn_id = db_begin_transaction();
-                    if (current_txn_id >= 0)
-                    {
-                        send(client_socket, "Transaction started\n", 20, 0);
-                    }
-                    else
-                    {
-                        send(client_socket, "Failed to start transaction\n", 28, 0);
-                    }
-                }
-                else if (strcmp(command, "COMMIT") == 0)
-                {
-                    if (current_txn_id >= 0)
-                    {
-                        if (db_commit_transaction(current_txn_id))
-                        {
-                            send(client_socket, "Transaction committed\n", 22, 0);
-                            current_txn_id = -1;
-                        }
-                        else
-                        {
-                            send(client_socket, "Failed to commit transaction\n", 29, 0);
-                        }
-                    }
-                    else
-                    {
-                        send(client_socket, "No active transaction\n", 22, 0);
-                    }
-                }
-                else if (strcmp(command, "ABORT") == 0)
+        if (put)
+            ok = byte_keys ? db_put_row_bytes(s->current_table, txn_id, key, key_len, data, data_len + 1)
+                           : db_put_row(s->current_table, txn_id, atoi(key), data, data_len + 1);
+        else
+            ok = byte_keys ? db_delete_row_bytes(s->current_table, txn_id, key, key_len)
+                           : db_delete_row(s->current_table, txn_id, atoi(key));
+        if (ok)
+            rows++;
+    }
+
+    int len;
+    if (!ok)
+        len = snprintf(line, sizeof(line), "Failed to %s row %.*s\n", put ? "insert" : "delete", (int)key_len, key);
+    else if (batch_end(s, txn_id, true))
+        len = snprintf(line, sizeof(line), "%d rows %s\n", rows, put ? "inserted" : "deleted");
+    else
+        len = snprintf(line, sizeof(line), "Failed to commit transaction\n");
+    if (!ok)
+        batch_end(s, txn_id, false);
+    session_reply(s, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+}
+
+// Run one text command. Transactions of a session never wait for a lock:
+// a blocked loop thread would stall every session it serves, the holder's
+// among them, so a conflict fails the request and the client aborts.
+static void session_command(Session *s, char *command_start)
+{
+    char command[32];
+    sscanf(command_start, "%31s", command);
+
+    if (strcmp(command, "CREATE") == 0 && strstr(command_start, "TABLE"))
+    {
+        char table_name[64];
+        char index_name[16] = "";
+        sscanf(command_start, "CREATE TABLE %63s USING %15s", table_name, index_name);
+        IndexType index_type = INDEX_BPTREE;
+        if (strcmp(index_name, "ART") == 0)
+            index_type = INDEX_ART;
+        else if (strcmp(index_name, "CUCKOO") == 0)
+            index_type = INDEX_CUCKOO;
+        else if (strcmp(index_name, "VARKEY") == 0)
+            index_type = INDEX_VARKEY;
+        // Optional "PARTITIONS n" spreads the keys over n hash partitions
+        char *partitions = strstr(command_start, "PARTITIONS");
+        int table_id = partitions
+                           ? db_create_partitioned_table(table_name, index_type, PARTITION_HASH, atoi(partitions + 10), NULL)
+                           : db_create_table_with_index(table_name, index_type);
+        if (table_id >= 0)
+        {
+            session_reply(s, "Table created\n", 14);
+        }
+        else
+        {
+            session_reply(s, "Failed to create table\n", 23);
+        }
+    }
+    else if (strcmp(command, "USE") == 0 && strstr(command_start, "TABLE"))
+    {
+        char table_name[64];
+        sscanf(command_start, "USE TABLE %s", table_name);
+        s->current_table = db_open_table(table_name);
+        if (s->current_table)
+        {
+            session_reply(s, "Table opened\n", 13);
+        }
+        else
+        {
+            session_reply(s, "Table not found\n", 16);
+        }
+    }
+    else if (strcmp(command, "BEGIN") == 0 && strstr(command_start, "TRANSACTION"))
+    {
+        s->current_txn_id = db_begin_transaction();
+        if (s->current_txn_id >= 0)
+        {
+            transaction_set_no_wait(&g_lock_manager, s->current_txn_id);
+            session_reply(s, "Transaction started\n", 20);
+        }
+        else
+        {
+            session_reply(s, "Failed to start transaction\n", 28);
+        }
+    }
+    else if (strcmp(command, "COMMIT") == 0)
+    {
+        if (s->current_txn_id >= 0)
+        {
+            if (db_commit_transaction(s->current_txn_id))
+            {
+                session_reply(s, "Transaction committed\n", 22);
+                s->current_txn_id = -1;
+            }
+            else
+            {
+                session_reply(s, "Failed to commit transaction\n", 29);
+            }
+        }
+        else
+        {
+            session_reply(s, "No active transaction\n", 22);
+        }
+    }
+    else if (strcmp(command, "ABORT") == 0)
+    {
+        if (s->current_txn_id >= 0)
+        {
+            if (db_abort_transaction(s->current_txn_id))
+            {
+                session_reply(s, "Transaction aborted\n", 20);
+                s->current_txn_id = -1;
+            }
+            else
+            {
+                session_reply(s, "Failed to abort transaction\n", 28);
+            }
+        }
+        else
+        {
+            session_reply(s, "No active transaction\n", 22);
+        }
+    }
+    else if (strcmp(command, "INSERT") == 0 && strstr(command_start, "ROW"))
+    {
+        if (!s->current_table)
+        {
+            session_reply(s, "No table selected\n", 18);
+        }
+        else if (s->current_txn_id < 0)
+        {
+            session_reply(s, "No active transaction\n", 22);
+        }
+        else
+        {
+            int key;
+            char *ptr = strstr(command_start, "ROW") + 3;
+            while (*ptr == ' ') ptr++;
+            key = atoi(ptr);
+            // VARKEY tables take the whole token as the key
+            char *key_start = ptr;
+            while (*ptr != ' ' && *ptr != '\0') ptr++;
+            size_t key_len = ptr - key_start;
+            while (*ptr == ' ') ptr++;
+            if (*ptr == '\'')
+            {
+                ptr++;
+                char *data_start = ptr;
+                while (*ptr != '\'' && *ptr != '\0') ptr++;
+                if (*ptr == '\'')
                 {
-                    if (current_txn_id >= 0)
-                    {
-                        if (db_abort_transaction(current_txn_id))
-                        {
-                            send(client_socket, "Transaction aborted\n", 20, 0);
-                            current_txn_id = -1;
-                        }
-                        else
-                        {
-                            send(client_socket, "Failed to abort transaction\n", 28, 0);
-                        }
-                    }
+                    // Stored in place with its NUL: the line can be as long
+                    // as SESSION_MAX_INPUT, so it is never copied
+                    size_t data_len = ptr - data_start;
+                    *ptr = '\0';
+                    bool status;
+                    if (db_table_has_byte_keys(s->current_table))
+                        status = db_put_row_bytes(s->current_table, s->current_txn_id, key_start, key_len, data_start, data_len + 1);
                     else
+                        status = db_put_row(s->current_table, s->current_txn_id, key, data_start, data_len + 1);
+                    if (status)
                     {
-                        send(client_socket, "No active transaction\n", 22, 0);
-                    }
-                }
-                else if (strcmp(command, "INSERT") == 0 && strstr(command_start, "ROW"))
-                {
-                    if (!current_table)
-                    {
-                        send(client_socket, "No table selected\n", 18, 0);
-                    }
-                    else if (current_txn_id < 0)
-                    {
-                        send(client_socket, "No active transaction\n", 22, 0);
+                        session_reply(s, "Row inserted\n", 13);
                     }
                     else
                     {
-                        int key;
-                        char data[256];
-                        char *ptr = strstr(command_start, "ROW") + 3;
-                        while (*ptr == ' ') ptr++;
-                        key = atoi(ptr);
-                        while (*ptr != ' ' && *ptr != '\0') ptr++;
-                        while (*ptr == ' ') ptr++;
-                        if (*ptr == '\'')
-                        {
-                            ptr++;
-                            char *data_start = ptr;
-                            while (*ptr != '\'' && *ptr != '\0') ptr++;
-                            if (*ptr == '\'')
-                            {
-                                size_t data_len = ptr - data_start;
-                                strncpy(data, data_start, data_len);
-                                data[data_len] = '\0';
-                                bool status = db_put_row(current_table, current_txn_id, key, data, strlen(data) + 1);
-                                if (status)
-                                {
-                                    send(client_socket, "Row inserted\n", 13, 0);
-                                }
-                                else
-                                {
-                                    send(client_socket, "Row already exists\n", 19, 0);
-                                }
-                            }
-                            else
-                            {
-                                send(client_socket, "Invalid format\n", 15, 0);
-                            }
-                        }
-                        else
-                        {
-                            send(client_socket, "Invalid format\n", 15, 0);
-                        }
-                    }
-                }
-                else if (strcmp(command, "GET") == 0 && strstr(command_start, "ROW"))
-                {
-                     if (!current_table) {
-                        send(client_socket, "No table selected\n", 18, 0);
-                    } else if (current_txn_id < 0) {
-                        send(client_socket, "No active transaction\n", 22, 0);
-                    } else {
-                        int key;
-                        sscanf(command_start, "GET ROW %d", &key);
-                        size_t size;
-                        void *data = db_get_row(current_table, current_txn_id, key, &size);
-                        if (data)
-                        {
-                            char response[256];
-                            snprintf(response, sizeof(response), "Row %d: %s\n", key, (char *)data);
-                            send(client_socket, response, strlen(response), 0);
-                        }
-                        else
-                        {
-                            send(client_socket, "Row not found\n", 14, 0);
-                        }
-                    }
-                }
-                else if (strcmp(command, "DELETE") == 0 && strstr(command_start, "ROW"))
-                {
-                     if (!current_table) {
-                        send(client_socket, "No table selected\n", 18, 0);
-                    } else if (current_txn_id < 0) {
-                        send(client_socket, "No active transaction\n", 22, 0);
-                    } else {
-                        int key;
-                        sscanf(command_start, "DELETE ROW %d", &key);
-                        if (db_delete_row(current_table, current_txn_id, key))
-                        {
-                            send(client_socket, "Row deleted\n", 12, 0);
-                        }
-                        else
-                        {
-                            send(client_socket, "Failed to delete row\n", 21, 0);
-                        }
+                        session_reply(s, "Row already exists\n", 19);
                     }
                 }
-                else if (strcmp(command, "SHOW") == 0 && strstr(command_start, "WAL"))
-                {
-                    wal_show_data();
-                    send(client_socket, "WAL data displayed in server console\n", 37, 0);
-                }
-                else if (strcmp(command, "EXIT") == 0)
-                {
-                    send(client_socket, "Goodbye\n", 8, 0);
-                    if (current_txn_id >= 0) db_abort_transaction(current_txn_id);
-                    close(client_socket);
-                    return NULL;
-                }
                 else
                 {
-                    send(client_socket, "Invalid command\n", 16, 0);
+                    session_reply(s, "Invalid format\n", 15);
                 }
-            } // end if(strlen > 0)
+            }
+            else
+            {
+                session_reply(s, "Invalid format\n", 15);
+            }
+        }
+    }
+    else if (strcmp(command, "GET") == 0 && strstr(command_start, "ROW"))
+    {
+         if (!s->current_table) {
+            session_reply(s, "No table selected\n", 18);
+        } else if (s->current_txn_id < 0) {
+            session_reply(s, "No active transaction\n", 22);
+        } else {
+            int key = 0;
+            char key_str[256] = "";
+            size_t size;
+            void *data;
+            sscanf(command_start, "GET ROW %255s", key_str);
+            if (db_table_has_byte_keys(s->current_table))
+            {
+                data = db_get_row_bytes(s->current_table, s->current_txn_id, key_str, strlen(key_str), &size);
+            }
+            else
+            {
+                key = atoi(key_str);
+                data = db_get_row(s->current_table, s->current_txn_id, key, &size);
+            }
+            if (data)
+            {
+                // The row goes out whole, after a prefix that fits (key_str
+                // is at most 255 bytes)
+                char prefix[300];
+                int len = db_table_has_byte_keys(s->current_table)
+                              ? snprintf(prefix, sizeof(prefix), "Row %s: ", key_str)
+                              : snprintf(prefix, sizeof(prefix), "Row %d: ", key);
+                session_reply(s, prefix, len);
+                // Rows stored over the binary protocol need not end in a NUL
+                session_reply(s, data, strnlen(data, size));
+                session_reply(s, "\n", 1);
+            }
+            else
+            {
+                session_reply(s, "Row not found\n", 14);
+            }
+        }
+    }
+    else if (strcmp(command, "DELETE") == 0 && strstr(command_start, "ROW"))
+    {
+         if (!s->current_table) {
+            session_reply(s, "No table selected\n", 18);
+        } else if (s->current_txn_id < 0) {
+            session_reply(s, "No active transaction\n", 22);
+        } else {
+            char key_str[256] = "";
+            bool deleted;
+            sscanf(command_start, "DELETE ROW %255s", key_str);
+            if (db_table_has_byte_keys(s->current_table))
+                deleted = db_delete_row_bytes(s->current_table, s->current_txn_id, key_str, strlen(key_str));
+            else
+                deleted = db_delete_row(s->current_table, s->current_txn_id, atoi(key_str));
+            if (deleted)
+            {
+                session_reply(s, "Row deleted\n", 12);
+            }
+            else
+            {
+                session_reply(s, "Failed to delete row\n", 21);
+            }
+        }
+    }
+    else if ((strcmp(command, "MGET") == 0 || strcmp(command, "MPUT") == 0 || strcmp(command, "MDEL") == 0) &&
+             strstr(command_start, "ROWS"))
+    {
+        // Many keys in one transaction round; outside a transaction the
+        // command runs in its own
+        char *ptr = strstr(command_start, "ROWS") + 4;
+        if (!s->current_table)
+            session_reply(s, "No table selected\n", 18);
+        else if (command[1] == 'G')
+            session_mget(s, ptr);
+        else
+            session_mwrite(s, ptr, command[1] == 'P');
+    }
+    else if (strcmp(command, "SHOW") == 0 && strstr(command_start, "WAL"))
+    {
+        wal_show_data();
+        session_reply(s, "WAL data displayed in server console\n", 37);
+    }
+    else if (strcmp(command, "STATS") == 0 && strstr(command_start, "LOCKS"))
+    {
+        LockStats stats;
+        char response[2048];
+        lock_stats_collect(&g_lock_manager, &stats);
+        int len = lock_stats_format(&stats, response, sizeof(response));
+        session_reply(s, response, len < (int)sizeof(response) ? len : (int)sizeof(response) - 1);
+    }
+    else if (strcmp(command, "EXIT") == 0)
+    {
+        session_reply(s, "Goodbye\n", 8);
+        s->closing = true; // Closed once the reply is out
+    }
+    else
+    {
+        session_reply(s, "Invalid command\n", 16);
+    }
+}
+
+static Session *session_create(int fd)
+{
+    Session *s = calloc(1, sizeof(Session));
+    if (!s)
+        return NULL;
+    s->in = malloc(BUFFER_SIZE + 1);
+    if (!s->in)
+    {
+        free(s);
+        return NULL;
+    }
+    s->fd = fd;
+    s->in_cap = BUFFER_SIZE;
+    s->current_txn_id = -1;
+    return s;
+}
+
+// Close a session, aborting its open transaction
+static void session_close(Session *s)
+{
+    if (s->current_txn_id >= 0)
+        db_abort_transaction(s->current_txn_id);
+    close(s->fd); // Also takes it out of the epoll set
+    while (s->out)
+    {
+        OutBlock *b = s->out;
+        s->out = b->next;
+        free(b);
+    }
+    free(s->in);
+    free(s);
+}
 
-            // Move to the start of the next command
-            command_start = newline + 1;
+// Watch the session for input, or for room to send while replies are
+// pending. Not reading meanwhile holds back a client that doesn't read
+// its replies.
+static bool session_watch(EventLoop *loop, Session *s, bool writing)
+{
+    if (s->writing == writing)
+        return true;
+    struct epoll_event ev = {writing ? EPOLLOUT : EPOLLIN, {.ptr = s}};
+    s->writing = writing;
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, s->fd, &ev) == 0;
+}
+
+// Send what the socket takes, all blocks in one writev. False if the
+// session is done with.
+static bool session_flush(EventLoop *loop, Session *s)
+{
+    while (s->out)
+    {
+        struct iovec iov[FLUSH_IOVECS];
+        int count = 0;
+        size_t skip = s->out_sent;
+        for (OutBlock *b = s->out; b && count < FLUSH_IOVECS; b = b->next)
+        {
+            iov[count].iov_base = b->data + skip;
+            iov[count].iov_len = b->len - skip;
+            skip = 0;
+            count++;
         }
 
-        // Move any leftover, incomplete command data to the beginning of the buffer
-        int remaining_bytes = bytes_in_buffer - (command_start - buffer);
-        memmove(buffer, command_start, remaining_bytes);
-        bytes_in_buffer = remaining_bytes;
-        buffer_ptr = buffer + remaining_bytes;
+        ssize_t n = writev(s->fd, iov, count);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return session_watch(loop, s, true);
+        if (n <= 0)
+            return false;
+
+        // Free the blocks that went out
+        while (n > 0)
+        {
+            OutBlock *b = s->out;
+            size_t left = b->len - s->out_sent;
+            if ((size_t)n < left)
+            {
+                s->out_sent += n;
+                break;
+            }
+            n -= left;
+            s->out = b->next;
+            s->out_sent = 0;
+            free(b);
+        }
     }
+    s->out_tail = NULL;
+    return !s->closing && session_watch(loop, s, false);
+}
+
+// Queue a binary response
+static void session_respond(Session *s, uint8_t opcode, NvStatus status, int32_t result,
+                            const void *value, size_t len)
+{
+    unsigned char header[NV_RESPONSE_HEADER];
+    NvResponse resp = {(uint32_t)len, status, opcode, result};
+    nv_encode_response(header, &resp);
+    session_reply(s, (const char *)header, sizeof(header));
+    if (len)
+        session_reply(s, value, len);
+}
 
-    if (current_txn_id >= 0)
+// Table a frame names, opening it as USE TABLE would
+static Table *frame_table(const NvRequest *req)
+{
+    return req->table <= INT32_MAX ? db_open_table_by_id((int)req->table) : NULL;
+}
+
+// Run an NV_OP_MGET, NV_OP_MPUT or NV_OP_MDELETE of req->key int keys
+static void session_frame_multi(Session *s, const NvRequest *req, Table *table, const unsigned char *value)
+{
+    size_t count = req->key >= 0 ? (size_t)req->key : 0;
+    size_t entry = req->opcode == NV_OP_MPUT ? 8 : 4;
+    if (req->key < 0 || req->key_len || (req->opcode != NV_OP_MPUT && count * 4 != req->value_len) ||
+        count * entry > req->value_len)
     {
-        db_abort_transaction(current_txn_id);
+        session_respond(s, req->opcode, NV_BAD_REQUEST, 0, NULL, 0);
+        return;
     }
-    close(client_socket);
-    return NULL;
+
+    int txn_id = batch_begin(s, req->opcode == NV_OP_MGET);
+    if (txn_id < 0)
+    {
+        session_respond(s, req->opcode, NV_FAILED, 0, NULL, 0);
+        return;
+    }
+
+    if (req->opcode == NV_OP_MGET)
+    {
+        // Find every row first: the header carries the total length
+        NVRAMPtr *rows = malloc(sizeof(NVRAMPtr) * count + 1);
+        size_t *sizes = malloc(sizeof(size_t) * count + 1);
+        size_t total = count * 4;
+        int32_t found = 0;
+        for (size_t i = 0; rows && sizes && i < count; i++)
+        {
+            rows[i] = db_get_row(table, txn_id, (int32_t)nv_get_u32(value + i * 4), &sizes[i]);
+            if (rows[i])
+            {
+                total += sizes[i];
+                found++;
+            }
+        }
+
+        if (!rows || !sizes || total > NV_MAX_RESPONSE)
+            session_respond(s, req->opcode, NV_FAILED, 0, NULL, 0);
+        else
+        {
+            unsigned char header[NV_RESPONSE_HEADER], length[4];
+            NvResponse resp = {(uint32_t)total, NV_OK, req->opcode, found};
+            nv_encode_response(header, &resp);
+            session_reply(s, (const char *)header, sizeof(header));
+            for (size_t i = 0; i < count; i++)
+            {
+                nv_put_u32(length, rows[i] ? (uint32_t)sizes[i] : NV_ABSENT);
+                session_reply(s, (const char *)length, 4);
+                if (rows[i])
+                    session_reply(s, rows[i], sizes[i]);
+            }
+        }
+        free(rows);
+        free(sizes);
+        batch_end(s, txn_id, true);
+        return;
+    }
+
+    const unsigned char *p = value, *end = value + req->value_len;
+    int32_t rows = 0;
+    bool ok = true;
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        if (req->opcode == NV_OP_MDELETE)
+        {
+            ok = db_delete_row(table, txn_id, (int32_t)nv_get_u32(p));
+            p += 4;
+        }
+        else
+        {
+            if (end - p < 8 || nv_get_u32(p + 4) > (size_t)(end - p) - 8)
+            {
+                batch_end(s, txn_id, false);
+                session_respond(s, req->opcode, NV_BAD_REQUEST, rows, NULL, 0);
+                return;
+            }
+            uint32_t len = nv_get_u32(p + 4);
+            ok = db_put_row(table, txn_id, (int32_t)nv_get_u32(p), (void *)(p + 8), len);
+            p += 8 + len;
+        }
+        if (ok)
+            rows++;
+    }
+
+    ok = batch_end(s, txn_id, ok);
+    session_respond(s, req->opcode, ok ? NV_OK : NV_FAILED, rows, NULL, 0);
 }
 
-void db_init_with_recovery()
+// Run one binary request. Row operations use the session's transaction,
+// like the text commands; a byte-string key (key_len > 0) needs a table
+// ordered by bytes, or the operation fails.
+static void session_frame(Session *s, const NvRequest *req, const unsigned char *key, const unsigned char *value)
 {
-    // Initialize database structures
-    db_init();
+    char name[64];
+    Table *table = NULL;
+    NvStatus status = NV_OK;
+    int32_t result = 0;
+    NVRAMPtr data = NULL;
+    size_t size = 0;
 
-    // wal_recover();
+    switch (req->opcode)
+    {
+    case NV_OP_CREATE:
+    case NV_OP_OPEN:
+        if (req->value_len == 0 || req->value_len >= sizeof(name))
+        {
+            status = NV_BAD_REQUEST;
+            break;
+        }
+        memcpy(name, value, req->value_len);
+        name[req->value_len] = '\0';
+        if (req->opcode == NV_OP_CREATE)
+        {
+            IndexType index_type = req->key >= INDEX_BPTREE && req->key <= INDEX_VARKEY ? (IndexType)req->key : INDEX_BPTREE;
+            result = req->table > 0 ? db_create_partitioned_table(name, index_type, PARTITION_HASH, (int)req->table, NULL)
+                                    : db_create_table_with_index(name, index_type);
+            status = result >= 0 ? NV_OK : NV_FAILED;
+        }
+        else
+        {
+            table = db_open_table(name);
+            result = table ? db_table_id(table) : -1;
+            status = table ? NV_OK : NV_NO_TABLE;
+        }
+        break;
 
-    printf("Database initialization complete\n");
+    case NV_OP_BEGIN:
+        if (s->current_txn_id >= 0)
+        {
+            status = NV_FAILED; // One transaction at a time
+            break;
+        }
+        s->current_txn_id = (req->flags & NV_BEGIN_READONLY) ? db_begin_readonly() : db_begin_transaction();
+        if (s->current_txn_id >= 0 && !(req->flags & NV_BEGIN_READONLY))
+            transaction_set_no_wait(&g_lock_manager, s->current_txn_id);
+        result = s->current_txn_id;
+        status = result >= 0 ? NV_OK : NV_FAILED;
+        break;
+
+    case NV_OP_COMMIT:
+    case NV_OP_ABORT:
+        if (s->current_txn_id < 0)
+        {
+            status = NV_NO_TRANSACTION;
+            break;
+        }
+        // A failed commit has rolled back, so the transaction is over either way
+        if (!(req->opcode == NV_OP_COMMIT ? db_commit_transaction(s->current_txn_id)
+                                          : db_abort_transaction(s->current_txn_id)))
+            status = NV_FAILED;
+        s->current_txn_id = -1;
+        break;
+
+    case NV_OP_GET:
+    case NV_OP_PUT:
+    case NV_OP_DELETE:
+        table = frame_table(req);
+        if (!table)
+        {
+            status = NV_NO_TABLE;
+            break;
+        }
+        if (s->current_txn_id < 0)
+        {
+            status = NV_NO_TRANSACTION;
+            break;
+        }
+        if (req->opcode == NV_OP_GET)
+        {
+            data = req->key_len ? db_get_row_bytes(table, s->current_txn_id, key, req->key_len, &size)
+                                : db_get_row(table, s->current_txn_id, req->key, &size);
+            status = data ? NV_OK : NV_NOT_FOUND;
+        }
+        else if (req->opcode == NV_OP_PUT)
+        {
+            bool ok = req->key_len ? db_put_row_bytes(table, s->current_txn_id, key, req->key_len, (void *)value, req->value_len)
+                                   : db_put_row(table, s->current_txn_id, req->key, (void *)value, req->value_len);
+            status = ok ? NV_OK : NV_FAILED;
+        }
+        else
+        {
+            bool ok = req->key_len ? db_delete_row_bytes(table, s->current_txn_id, key, req->key_len)
+                                   : db_delete_row(table, s->current_txn_id, req->key);
+            status = ok ? NV_OK : NV_FAILED;
+        }
+        break;
+
+    case NV_OP_MGET:
+    case NV_OP_MPUT:
+    case NV_OP_MDELETE:
+        table = frame_table(req);
+        if (table)
+            session_frame_multi(s, req, table, value);
+        else
+            session_respond(s, req->opcode, NV_NO_TABLE, 0, NULL, 0);
+        return;
+
+    default:
+        status = NV_BAD_REQUEST;
+        break;
+    }
+
+    session_respond(s, req->opcode, status, result, data, status == NV_OK ? size : 0);
 }
 
-int main()
+// Run every complete text command from s->in + used on; returns the
+// bytes used up
+static size_t session_execute_text(Session *s, size_t used)
 {
-    db_init_with_recovery();
+    char *command_start = s->in + used;
+    char *newline;
+
+    while (!s->closing && (newline = memchr(command_start, '\n', s->in_len - (command_start - s->in))) != NULL)
+    {
+        *newline = '\0';
+        // Skip empty commands (which can happen with consecutive newlines)
+        if (*command_start != '\0')
+            session_command(s, command_start);
+        command_start = newline + 1;
+    }
+    return command_start - s->in;
+}
+
+// Run every complete frame from s->in + used on; returns the bytes used up
+static size_t session_execute_binary(Session *s, size_t used)
+{
+    while (!s->closing && s->in_len - used >= NV_REQUEST_HEADER)
+    {
+        const unsigned char *p = (const unsigned char *)s->in + used;
+        NvRequest req;
+        nv_decode_request(p, &req);
+        if (req.key_len > NV_MAX_KEY || req.value_len > NV_MAX_VALUE)
+        {
+            s->closing = true; // Out of step with the client: give up on it
+            break;
+        }
+
+        size_t frame = NV_REQUEST_HEADER + req.key_len + req.value_len;
+        if (s->in_len - used < frame)
+            break;
+        session_frame(s, &req, p + NV_REQUEST_HEADER, p + NV_REQUEST_HEADER + req.key_len);
+        used += frame;
+    }
+    return used;
+}
+
+// Run everything complete that was received. The first bytes pick the
+// protocol: NV_HELLO for frames, anything else is a text command.
+static void session_execute(Session *s)
+{
+    size_t used = 0;
+
+    if (s->protocol == PROTOCOL_UNKNOWN)
+    {
+        if (s->in[0] != NV_HELLO[0])
+            s->protocol = PROTOCOL_TEXT;
+        else if (s->in_len < NV_HELLO_LEN + 1)
+            return;
+        else if (memcmp(s->in, NV_HELLO, NV_HELLO_LEN) != 0)
+        {
+            s->closing = true;
+            return;
+        }
+        else
+        {
+            char hello[NV_HELLO_LEN + 1];
+            memcpy(hello, NV_HELLO, NV_HELLO_LEN);
+            hello[NV_HELLO_LEN] = NV_VERSION;
+            session_reply(s, hello, sizeof(hello));
+            s->protocol = PROTOCOL_BINARY;
+            used = NV_HELLO_LEN + 1;
+        }
+    }
+
+    used = s->protocol == PROTOCOL_TEXT ? session_execute_text(s, used) : session_execute_binary(s, used);
+
+    // Keep an incomplete command for the next read
+    s->in_len -= used;
+    memmove(s->in, s->in + used, s->in_len);
+    s->in[s->in_len] = '\0';
+}
+
+// Read what has arrived and answer it. A pipelining client's requests
+// are read up to SESSION_READ_BATCH at a time, so one writev answers many
+// of them. False if the session is done with.
+static bool session_read(EventLoop *loop, Session *s)
+{
+    size_t batch = 0;
+
+    while (batch < SESSION_READ_BATCH)
+    {
+        if (s->in_cap - s->in_len < BUFFER_SIZE)
+        {
+            size_t cap = s->in_cap * 2;
+            char *in = cap <= SESSION_MAX_INPUT ? realloc(s->in, cap + 1) : NULL;
+            if (!in)
+                return false; // A command longer than any we accept
+            s->in = in;
+            s->in_cap = cap;
+        }
+
+        size_t room = s->in_cap - s->in_len;
+        ssize_t n = recv(s->fd, s->in + s->in_len, room, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+            return false; // Connection closed or error
+
+        s->in_len += n;
+        batch += n;
+        if ((size_t)n < room)
+            break; // Drained: don't spend a recv to hear EAGAIN
+    }
+    if (batch == 0)
+        return true;
+
+    s->in[s->in_len] = '\0';
+    session_execute(s);
+    return session_flush(loop, s);
+}
+
+// Take every pending connection of the loop's listener
+static void loop_accept(EventLoop *loop)
+{
+    for (;;)
+    {
+        int fd = accept4(loop->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept");
+            return;
+        }
+
+        // Replies are whole messages; don't hold them back for more
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Session *s = session_create(fd);
+        struct epoll_event ev = {EPOLLIN, {.ptr = s}};
+        if (!s || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            perror("session");
+            if (s)
+                session_close(s);
+            else
+                close(fd);
+        }
+    }
+}
+
+static void *event_loop_main(void *arg)
+{
+    EventLoop *loop = (EventLoop *)arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    for (;;)
+    {
+        int n = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            return NULL;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            Session *s = (Session *)events[i].data.ptr;
+            if (!s)
+            {
+                loop_accept(loop);
+                continue;
+            }
+
+            bool open = true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                open = false;
+            else if (s->writing)
+                open = session_flush(loop, s);
+            else if (events[i].events & EPOLLIN)
+                open = session_read(loop, s);
+            if (!open)
+                session_close(s);
+        }
+    }
+    return NULL;
+}
 
-    int server_socket = socket(AF_INET, SOCK_STREAM, 0);
+// A non-blocking listener on PORT that shares the port with the other loops
+static int open_listener()
+{
+    int server_socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (server_socket < 0)
     {
         perror("socket");
-        exit(1);
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+    {
+        perror("SO_REUSEPORT");
+        close(server_socket);
+        return -1;
     }
 
     struct sockaddr_in server_addr;
@@ -289,44 +1018,68 @@ int main()
     if (bind(server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
     {
         perror("bind");
-        exit(1);
+        close(server_socket);
+        return -1;
     }
 
-    if (listen(server_socket, 10) < 0)
+    if (listen(server_socket, SOMAXCONN) < 0)
     {
         perror("listen");
-        exit(1);
+        close(server_socket);
+        return -1;
     }
+    return server_socket;
+}
 
-    printf("Server listening on port %d\n", PORT);
+void db_init_with_recovery()
+{
+    // Initialize database structures
+    db_init();
+
+    // wal_recover();
+
+    printf("Database initialization complete\n");
+}
+
+// Usage: db_main [event loops], one per CPU by default
+int main(int argc, char **argv)
+{
+    int loop_count = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (loop_count < 1)
+        loop_count = 1;
+
+    db_init_with_recovery();
 
-    while (1)
+    // A client gone while we write to it shows up as EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop *loops = calloc(loop_count, sizeof(EventLoop));
+    for (int i = 0; i < loop_count; i++)
     {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        int client_socket = accept(server_socket, (struct sockaddr *)&client_addr, &client_len);
-        if (client_socket < 0)
-        {
-            perror("accept");
-            continue;
-        }
+        EventLoop *loop = &loops[i];
+        loop->listen_fd = open_listener();
+        loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop->listen_fd < 0 || loop->epoll_fd < 0)
+            exit(1);
 
-        pthread_t thread;
-        int *sock_ptr = malloc(sizeof(int));
-        *sock_ptr = client_socket;
-        if (pthread_create(&thread, NULL, handle_client, sock_ptr) != 0)
-        {
-            perror("pthread_create");
-            close(client_socket);
-            free(sock_ptr);
-        }
-        else
+        struct epoll_event ev = {EPOLLIN, {.ptr = NULL}};
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->listen_fd, &ev) < 0 ||
+            pthread_create(&loop->thread, NULL, event_loop_main, loop) != 0)
         {
-            pthread_detach(thread);
+            perror("event loop");
+            exit(1);
         }
     }
 
-    close(server_socket);
+    printf("Server listening on port %d (%d event loops)\n", PORT, loop_count);
+
+    for (int i = 0; i < loop_count; i++)
+    {
+        pthread_join(loops[i].thread, NULL);
+        close(loops[i].epoll_fd);
+        close(loops[i].listen_fd);
+    }
+    free(loops);
     db_shutdown();
     return 0;
 }
@@ -4,6 +4,7 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdbool.h>
 #include <pthread.h>
 
 #include "postgres.h"   // Required for ereport
@@ -23,6 +24,77 @@ typedef struct FreeBlock
 } FreeBlock;
 
 FreeBlock *freeList = NULL; // Head of free space list
+
+// Freed blocks of a few whole lines are kept on one list per size,
+// without merging. Rows and WAL entries come in a handful of such sizes,
+// so they are recycled in O(1) instead of walking the sorted list, which
+// then only holds the large and odd-sized ranges. When first-fit finds
+// nothing, the size lists are merged back into the sorted list.
+#define SMALL_LINE 64
+#define SMALL_CLASSES 64
+static FreeBlock *smallFree[SMALL_CLASSES + 1]; // Indexed by size / SMALL_LINE
+static size_t smallCount;                        // Blocks on all size lists
+
+static int small_class(size_t size)
+{
+    if (size % SMALL_LINE != 0 || size / SMALL_LINE > SMALL_CLASSES)
+        return 0;
+    return (int)(size / SMALL_LINE);
+}
+
+static int compare_offsets(const void *a, const void *b)
+{
+    size_t x = (*(FreeBlock *const *)a)->offset, y = (*(FreeBlock *const *)b)->offset;
+    return x < y ? -1 : x > y;
+}
+
+// Move every size-listed block into the sorted list and merge neighbours.
+// Caller holds free_space_mutex. False if nothing could be moved.
+static bool merge_small_blocks()
+{
+    size_t count = smallCount;
+    for (FreeBlock *b = freeList; b; b = b->next)
+        count++;
+
+    FreeBlock **blocks = (FreeBlock **)malloc(sizeof(FreeBlock *) * (count + 1));
+    if (!blocks || smallCount == 0)
+    {
+        free(blocks);
+        return false;
+    }
+
+    size_t n = 0;
+    for (FreeBlock *b = freeList; b; b = b->next)
+        blocks[n++] = b;
+    for (int i = 1; i <= SMALL_CLASSES; i++)
+    {
+        for (FreeBlock *b = smallFree[i]; b; b = b->next)
+            blocks[n++] = b;
+        smallFree[i] = NULL;
+    }
+    smallCount = 0;
+    qsort(blocks, n, sizeof(FreeBlock *), compare_offsets);
+
+    // Rebuild the sorted list, folding each block into an adjacent predecessor
+    FreeBlock *tail = blocks[0];
+    freeList = tail;
+    for (size_t i = 1; i < n; i++)
+    {
+        if (tail->offset + tail->size == blocks[i]->offset)
+        {
+            tail->size += blocks[i]->size;
+            free(blocks[i]);
+        }
+        else
+        {
+            tail->next = blocks[i];
+            tail = blocks[i];
+        }
+    }
+    tail->next = NULL;
+    free(blocks);
+    return true;
+}
 void *nvram_map = NULL;     // Pointer to mapped NVRAM
 int fd = -1;
 
@@ -52,7 +124,24 @@ void init_free_space()
 void *allocate_memory(size_t size)
 {
     pthread_mutex_lock(&free_space_mutex);
-    FreeBlock *current = freeList, *prev = NULL;
+
+    // A freed block of exactly this size
+    int cls = small_class(size);
+    if (cls && smallFree[cls])
+    {
+        FreeBlock *block = smallFree[cls];
+        smallFree[cls] = block->next;
+        smallCount--;
+        pthread_mutex_unlock(&free_space_mutex);
+        void *allocated_memory = (char *)nvram_map + block->offset;
+        free(block);
+        return allocated_memory;
+    }
+
+    FreeBlock *current, *prev;
+retry:
+    current = freeList;
+    prev = NULL;
 
     while (current)
     {
@@ -82,6 +171,10 @@ void *allocate_memory(size_t size)
         prev = current;
         current = current->next;
     }
+
+    // The space may be there in pieces on the size lists
+    if (merge_small_blocks())
+        goto retry;
     pthread_mutex_unlock(&free_space_mutex);
     return NULL;
 }
@@ -96,6 +189,16 @@ void free_memory(void *ptr, size_t size)
     newBlock->offset = offset;
     newBlock->next = NULL;
 
+    int cls = small_class(size);
+    if (cls)
+    {
+        newBlock->next = smallFree[cls];
+        smallFree[cls] = newBlock;
+        smallCount++;
+        pthread_mutex_unlock(&free_space_mutex);
+        return;
+    }
+
     FreeBlock *current = freeList, *prev = NULL;
     while (current && current->offset < newBlock->offset)
     {
@@ -143,4 +246,15 @@ void cleanup_free_space()
         current = current->next;
         free(temp);
     }
+    freeList = NULL;
+    for (int i = 1; i <= SMALL_CLASSES; i++)
+    {
+        while (smallFree[i])
+        {
+            FreeBlock *temp = smallFree[i];
+            smallFree[i] = temp->next;
+            free(temp);
+        }
+    }
+    smallCount = 0;
 }
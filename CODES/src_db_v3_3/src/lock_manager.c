@@ -1,63 +1,251 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include "../include/lock_manager.h"
 
+// Latch order: bucket latch, then transaction latch.
+
+// Which modes can be granted together, indexed [held][requested]
+static const bool lock_compatible[LOCK_MODES][LOCK_MODES] = {
+    //            IS     IX     S      SIX    X
+    /* IS  */ {true, true, true, true, false},
+    /* IX  */ {true, true, false, false, false},
+    /* S   */ {true, false, true, false, false},
+    /* SIX */ {true, false, false, false, false},
+    /* X   */ {false, false, false, false, false},
+};
+
+// Weakest mode at least as strong as both, indexed [held][requested]
+static const LockMode lock_supremum[LOCK_MODES][LOCK_MODES] = {
+    /* IS  */ {LOCK_INTENTION_SHARED, LOCK_INTENTION_EXCLUSIVE, LOCK_SHARED, LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_EXCLUSIVE},
+    /* IX  */ {LOCK_INTENTION_EXCLUSIVE, LOCK_INTENTION_EXCLUSIVE, LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_EXCLUSIVE},
+    /* S   */ {LOCK_SHARED, LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_SHARED, LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_EXCLUSIVE},
+    /* SIX */ {LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_SHARED_INTENTION_EXCLUSIVE, LOCK_EXCLUSIVE},
+    /* X   */ {LOCK_EXCLUSIVE, LOCK_EXCLUSIVE, LOCK_EXCLUSIVE, LOCK_EXCLUSIVE, LOCK_EXCLUSIVE},
+};
+
+// Contended resources each thread tracks. A new one replaces the least
+// counted and inherits its count (space-saving), so a resource that keeps
+// coming back rises to the top.
+#define LOCK_HOT_TRACKED 16
+
+typedef struct {
+    uint64_t resource_id;
+    bool is_table;
+    unsigned long events;
+} HotSlot;
+
+// Counters of one thread. Only the owner writes them, with relaxed atomic
+// stores, so collecting them never stalls the lock paths.
+typedef struct LockThreadStats {
+    unsigned long acquires, cached, waits, deaths, deadlocks, released, escalations, wait_us;
+    unsigned long wait_hist[LOCK_WAIT_BUCKETS];
+    int max_queue;
+    HotSlot hot[LOCK_HOT_TRACKED];
+    struct LockThreadStats *next;
+} __attribute__((aligned(64))) LockThreadStats;
+
+#define STAT_ADD(field, n) __atomic_store_n(&(field), (field) + (n), __ATOMIC_RELAXED)
+
+// Blocks of running threads; an exiting thread adds its counts to retired
+// and leaves its block for the next thread
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LockThreadStats *stats_live;
+static LockThreadStats *stats_free;
+static LockThreadStats stats_retired;
+static HotSlot retired_hot[LOCK_HOT_TRACKED * 4];
+static pthread_key_t stats_key;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static __thread LockThreadStats *my_stats;
+
+// Count events against a resource in a space-saving table
+static void hot_note(HotSlot *hot, int n, uint64_t resource_id, bool is_table, unsigned long events)
+{
+    int victim = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (hot[i].events > 0 && hot[i].resource_id == resource_id && hot[i].is_table == is_table)
+        {
+            STAT_ADD(hot[i].events, events);
+            return;
+        }
+        if (hot[i].events < hot[victim].events)
+            victim = i;
+    }
+    __atomic_store_n(&hot[victim].resource_id, resource_id, __ATOMIC_RELAXED);
+    __atomic_store_n(&hot[victim].is_table, is_table, __ATOMIC_RELAXED);
+    STAT_ADD(hot[victim].events, events);
+}
+
+// Thread exit: fold the block into the retired totals and free it
+static void stats_thread_exit(void *arg)
+{
+    LockThreadStats *ts = (LockThreadStats *)arg;
+
+    pthread_mutex_lock(&stats_mutex);
+    stats_retired.acquires += ts->acquires;
+    stats_retired.cached += ts->cached;
+    stats_retired.waits += ts->waits;
+    stats_retired.deaths += ts->deaths;
+    stats_retired.deadlocks += ts->deadlocks;
+    stats_retired.released += ts->released;
+    stats_retired.escalations += ts->escalations;
+    stats_retired.wait_us += ts->wait_us;
+    for (int b = 0; b < LOCK_WAIT_BUCKETS; b++)
+        stats_retired.wait_hist[b] += ts->wait_hist[b];
+    if (ts->max_queue > stats_retired.max_queue)
+        stats_retired.max_queue = ts->max_queue;
+    for (int i = 0; i < LOCK_HOT_TRACKED; i++)
+    {
+        if (ts->hot[i].events > 0)
+            hot_note(retired_hot, LOCK_HOT_TRACKED * 4, ts->hot[i].resource_id, ts->hot[i].is_table, ts->hot[i].events);
+    }
+
+    LockThreadStats **link = &stats_live;
+    while (*link != ts)
+        link = &(*link)->next;
+    *link = ts->next;
+    memset(ts, 0, sizeof(*ts));
+    ts->next = stats_free;
+    stats_free = ts;
+    pthread_mutex_unlock(&stats_mutex);
+    my_stats = NULL;
+}
+
+static void stats_key_create(void)
+{
+    pthread_key_create(&stats_key, stats_thread_exit);
+}
+
+// This thread's counters, registered on first use
+static LockThreadStats *thread_stats(void)
+{
+    if (my_stats)
+        return my_stats;
+
+    pthread_once(&stats_once, stats_key_create);
+    pthread_mutex_lock(&stats_mutex);
+    LockThreadStats *ts = stats_free;
+    if (ts)
+        stats_free = ts->next;
+    else
+        ts = (LockThreadStats *)aligned_alloc(64, sizeof(LockThreadStats));
+    if (ts)
+    {
+        memset(ts, 0, sizeof(*ts));
+        ts->next = stats_live;
+        stats_live = ts;
+    }
+    pthread_mutex_unlock(&stats_mutex);
+
+    // Out of memory: count into a block nobody reads
+    static __thread LockThreadStats discard;
+    if (!ts)
+        return &discard;
+    pthread_setspecific(stats_key, ts);
+    my_stats = ts;
+    return ts;
+}
+
+static unsigned long elapsed_us(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000UL + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
 // Initialize lock manager
 void lock_manager_init(LockManager *lm)
 {
-    lm->lock_table = NULL;
-    lm->transactions = NULL;
-    pthread_mutex_init(&lm->mutex, NULL);
+    lm->buckets = (LockBucket *)aligned_alloc(64, sizeof(LockBucket) * LOCK_BUCKETS);
+    for (int i = 0; i < LOCK_BUCKETS; i++)
+    {
+        pthread_mutex_init(&lm->buckets[i].latch, NULL);
+        lm->buckets[i].entries = NULL;
+    }
+    lm->transactions = (Transaction *)aligned_alloc(64, sizeof(Transaction) * TXN_SLOTS);
+    for (int i = 0; i < TXN_SLOTS; i++)
+    {
+        lm->transactions[i].id = 0;
+        lm->transactions[i].in_use = 0;
+        lm->transactions[i].active = false;
+        lm->transactions[i].deadlock_victim = false;
+        lm->transactions[i].held_locks = NULL;
+        lm->transactions[i].table_lock_count = 0;
+        pthread_mutex_init(&lm->transactions[i].latch, NULL);
+    }
     lm->next_txn_id = 1;
+    lm->policy = LOCK_WAIT_DIE;
+    lm->waiting = 0;
+    pthread_mutex_init(&lm->detector_latch, NULL);
+    pthread_cond_init(&lm->detector_cond, NULL);
+
+    // Lock records are recycled through pools instead of malloc/free
+    mem_pool_init(&lm->request_pool, "lock_request", sizeof(LockRequest), false);
+    mem_pool_init(&lm->entry_pool, "lock_entry", sizeof(LockEntry), false);
 }
 
 // Start a new transaction
 int transaction_begin(LockManager *lm)
 {
-    pthread_mutex_lock(&lm->mutex);
-
-    // Create new transaction
-    Transaction *txn = (Transaction *)malloc(sizeof(Transaction));
-    if (!txn)
+    // Take the next id whose slot is free. A slot is only still busy if
+    // TXN_SLOTS transactions started since its owner did.
+    for (int tries = 0; tries < TXN_SLOTS; tries++)
     {
-        pthread_mutex_unlock(&lm->mutex);
-        return -1;
-    }
-
-    txn->id = lm->next_txn_id++;
-    txn->active = true;
-    txn->held_locks = NULL;
-
-    // Add to transaction list
-    txn->next = lm->transactions;
-    lm->transactions = txn;
+        int txn_id = (int)(__atomic_fetch_add(&lm->next_txn_id, 1, __ATOMIC_RELAXED) & (TXN_ID_LIMIT - 1));
+        Transaction *txn = &lm->transactions[txn_id & (TXN_SLOTS - 1)];
+        int expected = 0;
 
-    int txn_id = txn->id;
-    pthread_mutex_unlock(&lm->mutex);
+        if (txn_id <= 0 || !__atomic_compare_exchange_n(&txn->in_use, &expected, 1, false,
+                                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
 
-    return txn_id;
+        pthread_mutex_lock(&txn->latch);
+        __atomic_store_n(&txn->id, txn_id, __ATOMIC_RELEASE);
+        txn->active = true;
+        txn->deadlock_victim = false;
+        txn->no_wait = false;
+        txn->held_locks = NULL;
+        txn->table_lock_count = 0;
+        pthread_mutex_unlock(&txn->latch);
+        return txn_id;
+    }
+    return -1;
 }
 
 // Find a transaction by ID
 static Transaction *find_transaction(LockManager *lm, int txn_id)
 {
-    Transaction *txn = lm->transactions;
-    while (txn)
-    {
-        if (txn->id == txn_id)
-        {
-            return txn;
-        }
-        txn = txn->next;
-    }
-    return NULL;
+    if (txn_id <= 0)
+        return NULL;
+
+    Transaction *txn = &lm->transactions[txn_id & (TXN_SLOTS - 1)];
+    if (__atomic_load_n(&txn->in_use, __ATOMIC_ACQUIRE) == 0 ||
+        __atomic_load_n(&txn->id, __ATOMIC_ACQUIRE) != txn_id)
+        return NULL;
+    return txn;
+}
+
+// Bucket a resource hashes to
+static LockBucket *lock_bucket(LockManager *lm, uint64_t resource_id, bool is_table)
+{
+    // All 64 bits feed the bucket, so the same key in different tables
+    // lands in different chains
+    uint64_t h = resource_id ^ ((uint64_t)is_table << 63);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return &lm->buckets[h & (LOCK_BUCKETS - 1)];
 }
 
-// Find a lock entry
-static LockEntry *find_lock_entry(LockManager *lm, int resource_id, bool is_table)
+// Find a lock entry (caller holds the bucket latch)
+static LockEntry *find_lock_entry(LockBucket *bucket, uint64_t resource_id, bool is_table)
 {
-    LockEntry *entry = lm->lock_table;
+    LockEntry *entry = bucket->entries;
     while (entry)
     {
         if (entry->resource_id == resource_id && entry->is_table == is_table)
@@ -69,300 +257,448 @@ static LockEntry *find_lock_entry(LockManager *lm, int resource_id, bool is_tabl
     return NULL;
 }
 
-// Add a lock request to transaction's held locks
-static void add_lock_to_transaction(Transaction *txn, int resource_id, bool is_table, LockMode mode)
+// Free an entry nobody holds or waits for, so the chains only hold live locks
+static void release_idle_entry(LockManager *lm, LockBucket *bucket, LockEntry *entry)
 {
-    LockRequest *req = (LockRequest *)malloc(sizeof(LockRequest));
-    if (!req)
+    if (entry->granted || entry->waiter_count > 0)
         return;
 
+    LockEntry **link = &bucket->entries;
+    while (*link != entry)
+        link = &(*link)->next;
+    *link = entry->next;
+    pthread_cond_destroy(&entry->cond);
+    mem_pool_free(&lm->entry_pool, entry);
+}
+
+// Oldest holder (lowest transaction id) a request conflicts with, 0 if none
+static int oldest_conflict(LockEntry *entry, LockMode mode, int txn_id)
+{
+    // Most requests (intention locks on a table, shared row locks) find no
+    // incompatible grant at all and skip the holder walk
+    bool any = false;
+    for (int m = 0; m < LOCK_MODES; m++)
+    {
+        if (!lock_compatible[m][mode] && entry->granted_count[m] > 0)
+            any = true;
+    }
+    if (!any)
+        return 0;
+
+    // A transaction never conflicts with its own grants, so it can upgrade
+    int oldest = 0;
+    for (LockRequest *h = entry->granted; h; h = h->next_granted)
+    {
+        if (h->transaction_id != txn_id && !lock_compatible[h->mode][mode] &&
+            (oldest == 0 || h->transaction_id < oldest))
+            oldest = h->transaction_id;
+    }
+    return oldest;
+}
+
+// Record a granted lock on the entry and the transaction (caller holds
+// the bucket latch and txn->latch)
+static bool grant_lock(LockManager *lm, LockEntry *entry, Transaction *txn, LockMode mode)
+{
+    LockRequest *req = (LockRequest *)mem_pool_alloc(&lm->request_pool);
+    if (!req)
+        return false;
+
     req->transaction_id = txn->id;
-    req->resource_id = resource_id;
-    req->is_table = is_table;
+    req->resource_id = entry->resource_id;
+    req->is_table = entry->is_table;
     req->mode = mode;
 
     req->next = txn->held_locks;
     txn->held_locks = req;
+
+    req->prev_granted = NULL;
+    req->next_granted = entry->granted;
+    if (entry->granted)
+        entry->granted->prev_granted = req;
+    entry->granted = req;
+    entry->granted_count[mode]++;
+    return true;
 }
 
-// Can a lock be granted?
-static bool can_grant_lock(LockEntry *entry, LockMode mode, int txn_id)
+// Slot of a table in the transaction's table lock cache, -1 if absent
+static int cached_table_lock(Transaction *txn, int table_id)
 {
-    if (mode == LOCK_SHARED)
+    for (int i = 0; i < txn->table_lock_count; i++)
     {
-        // Shared lock can be granted if:
-        // 1. No exclusive lock
-        // 2. Exclusive lock is held by the same transaction
-        return (entry->exclusive_owner == -1 || entry->exclusive_owner == txn_id);
-    }
-    else
-    { // LOCK_EXCLUSIVE
-        // Exclusive lock can be granted if:
-        // 1. No exclusive lock and no shared locks
-        // 2. The transaction already holds the exclusive lock
-        return ((entry->exclusive_owner == -1 && entry->shared_count == 0) ||
-                entry->exclusive_owner == txn_id);
+        if (txn->table_locks[i].table_id == table_id)
+            return i;
     }
+    return -1;
 }
 
-// Process waiting lock requests
-static void process_waiting_requests(LockManager *lm, LockEntry *entry)
+// Does a table lock in table_mode make a row lock in row_mode redundant?
+static bool table_covers_row(LockMode table_mode, LockMode row_mode)
 {
-    LockRequest *prev = NULL;
-    LockRequest *curr = entry->waiting_list;
+    if (row_mode == LOCK_INTENTION_EXCLUSIVE || row_mode == LOCK_EXCLUSIVE)
+        return table_mode == LOCK_EXCLUSIVE;
+    return table_mode == LOCK_SHARED || table_mode == LOCK_SHARED_INTENTION_EXCLUSIVE ||
+           table_mode == LOCK_EXCLUSIVE;
+}
 
-    while (curr)
-    {
-        if (can_grant_lock(entry, curr->mode, curr->transaction_id))
-        {
-            // Grant the lock
-            Transaction *txn = find_transaction(lm, curr->transaction_id);
-            if (txn)
-            {
-                if (curr->mode == LOCK_SHARED)
-                {
-                    entry->shared_count++;
-                }
-                else
-                { // LOCK_EXCLUSIVE
-                    entry->exclusive_owner = txn->id;
-                }
+static void escalate_row_locks(LockManager *lm, Transaction *txn, int slot, LockMode row_mode);
 
-                add_lock_to_transaction(txn, curr->resource_id, curr->is_table, curr->mode);
-            }
+bool transaction_set_no_wait(LockManager *lm, int txn_id)
+{
+    Transaction *txn = find_transaction(lm, txn_id);
+    if (!txn)
+        return false;
+    txn->no_wait = true;
+    return true;
+}
 
-            // Remove from waiting list
-            if (prev)
-            {
-                prev->next = curr->next;
-            }
-            else
-            {
-                entry->waiting_list = curr->next;
-            }
+// Does the transaction hold the table in a mode that covers mode?
+bool lock_table_held(LockManager *lm, int txn_id, int table_id, LockMode mode)
+{
+    Transaction *txn = find_transaction(lm, txn_id);
+    if (!txn)
+        return false;
 
-            LockRequest *to_free = curr;
-            curr = curr->next;
-            free(to_free);
-        }
-        else
-        {
-            prev = curr;
-            curr = curr->next;
-        }
-    }
+    int slot = cached_table_lock(txn, table_id);
+    return slot >= 0 && lock_supremum[txn->table_locks[slot].mode][mode] == txn->table_locks[slot].mode;
 }
 
-// Acquire a lock
-bool lock_acquire(LockManager *lm, int txn_id, int resource_id, bool is_table, LockMode mode)
+// Would mode on the resource conflict with another transaction's lock?
+bool lock_conflict_held(LockManager *lm, int txn_id, uint64_t resource_id, bool is_table, LockMode mode)
 {
-    pthread_mutex_lock(&lm->mutex);
+    LockBucket *bucket = lock_bucket(lm, resource_id, is_table);
+    pthread_mutex_lock(&bucket->latch);
+    LockEntry *entry = find_lock_entry(bucket, resource_id, is_table);
+    bool conflict = entry && oldest_conflict(entry, mode, txn_id) != 0;
+    pthread_mutex_unlock(&bucket->latch);
+    return conflict;
+}
 
+// Acquire a lock
+bool lock_acquire(LockManager *lm, int txn_id, uint64_t resource_id, bool is_table, LockMode mode)
+{
     // Find the transaction
     Transaction *txn = find_transaction(lm, txn_id);
     if (!txn || !txn->active)
     {
-        pthread_mutex_unlock(&lm->mutex);
         return false;
     }
 
+    LockThreadStats *ts = thread_stats();
+    STAT_ADD(ts->acquires, 1);
+
+    // A table lock already held in a covering mode needs no trip to the
+    // lock table; every row operation after the first lands here. The
+    // same goes for a row of a table held (or escalated to) S or X.
+    int slot = -1;
+    bool covered;
+    if (is_table)
+    {
+        slot = cached_table_lock(txn, (int)resource_id);
+        covered = slot >= 0 && lock_supremum[txn->table_locks[slot].mode][mode] == txn->table_locks[slot].mode;
+    }
+    else
+    {
+        slot = cached_table_lock(txn, (int)(resource_id >> 32));
+        covered = slot >= 0 && table_covers_row(txn->table_locks[slot].mode, mode);
+    }
+    if (covered)
+    {
+        STAT_ADD(ts->cached, 1);
+        return true;
+    }
+
+    LockBucket *bucket = lock_bucket(lm, resource_id, is_table);
+    pthread_mutex_lock(&bucket->latch);
+
     // Find or create lock entry
-    LockEntry *entry = find_lock_entry(lm, resource_id, is_table);
+    LockEntry *entry = find_lock_entry(bucket, resource_id, is_table);
     if (!entry)
     {
-        entry = (LockEntry *)malloc(sizeof(LockEntry));
+        entry = (LockEntry *)mem_pool_alloc(&lm->entry_pool);
         if (!entry)
         {
-            pthread_mutex_unlock(&lm->mutex);
+            pthread_mutex_unlock(&bucket->latch);
             return false;
         }
 
         entry->resource_id = resource_id;
         entry->is_table = is_table;
-        entry->shared_count = 0;
-        entry->exclusive_owner = -1;
-        entry->waiting_list = NULL;
+        memset(entry->granted_count, 0, sizeof(entry->granted_count));
+        entry->granted = NULL;
+        entry->waiter_count = 0;
+        entry->waiters = NULL;
+        pthread_cond_init(&entry->cond, NULL);
 
-        entry->next = lm->lock_table;
-        lm->lock_table = entry;
+        entry->next = bucket->entries;
+        bucket->entries = entry;
     }
 
-    // Check if lock can be granted immediately
-    if (can_grant_lock(entry, mode, txn_id))
+    // Wait-die: wait while every conflicting holder is younger, die if one
+    // is older. Detection: wait until granted or picked as a victim.
+    // Only blocked requests read the clock, and a wait costs far more.
+    bool detect = lm->policy == LOCK_DETECT;
+    int holder;
+    bool waited = false, victim = false;
+    struct timespec wait_start;
+    LockWaiter waiter = {txn_id, mode, NULL};
+    while ((holder = oldest_conflict(entry, mode, txn_id)) != 0 && !txn->no_wait && (detect || txn_id < holder))
     {
-        if (mode == LOCK_SHARED)
+        if (txn->deadlock_victim)
         {
-            entry->shared_count++;
+            victim = true;
+            break;
         }
-        else
-        { // LOCK_EXCLUSIVE
-            entry->exclusive_owner = txn_id;
+        if (!waited)
+        {
+            waited = true;
+            clock_gettime(CLOCK_MONOTONIC, &wait_start);
+            if (entry->waiter_count + 1 > ts->max_queue)
+                __atomic_store_n(&ts->max_queue, entry->waiter_count + 1, __ATOMIC_RELAXED);
+            waiter.next = entry->waiters;
+            entry->waiters = &waiter;
+            __atomic_add_fetch(&lm->waiting, 1, __ATOMIC_RELAXED);
         }
-
-        add_lock_to_transaction(txn, resource_id, is_table, mode);
-        pthread_mutex_unlock(&lm->mutex);
-        return true;
+        entry->waiter_count++;
+        pthread_cond_wait(&entry->cond, &bucket->latch);
+        entry->waiter_count--;
+    }
+    if (waited)
+    {
+        LockWaiter **link = &entry->waiters;
+        while (*link != &waiter)
+            link = &(*link)->next;
+        *link = waiter.next;
+        txn->deadlock_victim = false;
+        __atomic_sub_fetch(&lm->waiting, 1, __ATOMIC_RELAXED);
     }
 
-    // Lock cannot be granted immediately - add to waiting list
-    // Note: This is a simplified version without deadlock detection
-    LockRequest *req = (LockRequest *)malloc(sizeof(LockRequest));
-    if (!req)
+    bool granted = false;
+    if (holder == 0)
     {
-        pthread_mutex_unlock(&lm->mutex);
-        return false;
+        pthread_mutex_lock(&txn->latch);
+        if (txn->active)
+            granted = grant_lock(lm, entry, txn, mode);
+        pthread_mutex_unlock(&txn->latch);
     }
 
-    req->transaction_id = txn_id;
-    req->resource_id = resource_id;
-    req->is_table = is_table;
-    req->mode = mode;
-    req->next = NULL;
+    release_idle_entry(lm, bucket, entry);
+    pthread_mutex_unlock(&bucket->latch);
 
-    // Add to end of waiting list
-    if (entry->waiting_list == NULL)
+    if (waited)
     {
-        entry->waiting_list = req;
+        unsigned long us = elapsed_us(&wait_start);
+        int b = 0;
+        while (b < LOCK_WAIT_BUCKETS - 1 && us >= (1UL << b))
+            b++;
+        STAT_ADD(ts->waits, 1);
+        STAT_ADD(ts->wait_us, us);
+        STAT_ADD(ts->wait_hist[b], 1);
     }
-    else
+    if (victim)
+        STAT_ADD(ts->deadlocks, 1);
+    else if (holder != 0)
+        STAT_ADD(ts->deaths, 1);
+    if (waited || holder != 0)
+        hot_note(ts->hot, LOCK_HOT_TRACKED, resource_id, is_table, 1);
+
+    // Remember the combined mode now held on the table. A full cache just
+    // means later requests go to the lock table again.
+    if (granted && is_table)
     {
-        LockRequest *last = entry->waiting_list;
-        while (last->next)
+        if (slot >= 0)
         {
-            last = last->next;
+            txn->table_locks[slot].mode = lock_supremum[txn->table_locks[slot].mode][mode];
+        }
+        else if (txn->table_lock_count < TXN_TABLE_LOCKS)
+        {
+            txn->table_locks[txn->table_lock_count].table_id = (int)resource_id;
+            txn->table_locks[txn->table_lock_count].mode = mode;
+            txn->table_locks[txn->table_lock_count].row_locks = 0;
+            txn->table_lock_count++;
         }
-        last->next = req;
     }
 
-    pthread_mutex_unlock(&lm->mutex);
+    // Too many row locks on one table: trade them for the table lock
+    if (granted && !is_table && slot >= 0 &&
+        ++txn->table_locks[slot].row_locks > LOCK_ESCALATION_THRESHOLD)
+        escalate_row_locks(lm, txn, slot, mode);
+    return granted;
+}
 
-    // In a real implementation, we would wait here and return when the lock is granted
-    // For simplicity, we just return false to indicate the lock couldn't be acquired immediately
-    return false;
+// Drop one granted lock from its entry and wake the waiters (caller holds
+// the bucket latch; req is already off its transaction's list)
+static void release_granted(LockManager *lm, LockBucket *bucket, LockEntry *entry, LockRequest *req)
+{
+    if (req->prev_granted)
+        req->prev_granted->next_granted = req->next_granted;
+    else
+        entry->granted = req->next_granted;
+    if (req->next_granted)
+        req->next_granted->prev_granted = req->prev_granted;
+
+    entry->granted_count[req->mode]--;
+    mem_pool_free(&lm->request_pool, req);
+    STAT_ADD(thread_stats()->released, 1);
+
+    if (entry->waiter_count > 0)
+        pthread_cond_broadcast(&entry->cond);
+    release_idle_entry(lm, bucket, entry);
 }
 
 // Release a lock
-bool lock_release(LockManager *lm, int txn_id, int resource_id, bool is_table)
+bool lock_release(LockManager *lm, int txn_id, uint64_t resource_id, bool is_table)
 {
-    pthread_mutex_lock(&lm->mutex);
-
     // Find the transaction
     Transaction *txn = find_transaction(lm, txn_id);
     if (!txn)
     {
-        pthread_mutex_unlock(&lm->mutex);
         return false;
     }
 
+    LockBucket *bucket = lock_bucket(lm, resource_id, is_table);
+    pthread_mutex_lock(&bucket->latch);
+
     // Find the lock entry
-    LockEntry *entry = find_lock_entry(lm, resource_id, is_table);
+    LockEntry *entry = find_lock_entry(bucket, resource_id, is_table);
     if (!entry)
     {
-        pthread_mutex_unlock(&lm->mutex);
+        pthread_mutex_unlock(&bucket->latch);
         return false;
     }
 
-    // Remove lock from transaction's held locks
-    LockRequest *prev = NULL;
-    LockRequest *curr = txn->held_locks;
-    bool found = false;
+    // Remove every grant on the resource from the transaction's held locks
+    // (an upgrade leaves one per mode requested)
+    pthread_mutex_lock(&txn->latch);
+    LockRequest **link = &txn->held_locks;
+    LockRequest *released = NULL;
 
-    while (curr)
+    while (*link)
     {
+        LockRequest *curr = *link;
         if (curr->resource_id == resource_id && curr->is_table == is_table)
         {
-            if (prev)
-            {
-                prev->next = curr->next;
-            }
-            else
-            {
-                txn->held_locks = curr->next;
-            }
-
-            LockMode mode = curr->mode;
-            free(curr);
-
-            // Update lock entry
-            if (mode == LOCK_SHARED)
-            {
-                entry->shared_count--;
-            }
-            else
-            { // LOCK_EXCLUSIVE
-                entry->exclusive_owner = -1;
-            }
-
-            found = true;
-            break;
+            *link = curr->next;
+            curr->next = released;
+            released = curr;
+        }
+        else
+        {
+            link = &curr->next;
         }
-
-        prev = curr;
-        curr = curr->next;
     }
+    pthread_mutex_unlock(&txn->latch);
 
-    if (!found)
+    int count = 0;
+    while (released)
     {
-        pthread_mutex_unlock(&lm->mutex);
-        return false;
+        LockRequest *req = released;
+        released = req->next;
+        release_granted(lm, bucket, entry, req);
+        count++;
     }
+    pthread_mutex_unlock(&bucket->latch);
 
-    // Process waiting requests
-    process_waiting_requests(lm, entry);
-
-    pthread_mutex_unlock(&lm->mutex);
-    return true;
+    int slot = cached_table_lock(txn, (int)(is_table ? resource_id : resource_id >> 32));
+    if (slot >= 0 && is_table)
+        txn->table_locks[slot] = txn->table_locks[--txn->table_lock_count];
+    else if (slot >= 0)
+        txn->table_locks[slot].row_locks -= count;
+    return count > 0;
 }
 
-// Release all locks held by a transaction
-static void release_all_locks(LockManager *lm, Transaction *txn)
+// Release all locks held by a transaction. It is already inactive, so no
+// grant can add to its list while we walk it.
+static void release_all_locks(LockManager *lm, LockRequest *held)
 {
-    while (txn->held_locks)
+    while (held)
     {
-        LockRequest *req = txn->held_locks;
-        txn->held_locks = req->next;
+        LockRequest *req = held;
+        held = req->next;
 
         // Find the lock entry
-        LockEntry *entry = find_lock_entry(lm, req->resource_id, req->is_table);
+        LockBucket *bucket = lock_bucket(lm, req->resource_id, req->is_table);
+        pthread_mutex_lock(&bucket->latch);
+        LockEntry *entry = find_lock_entry(bucket, req->resource_id, req->is_table);
         if (entry)
         {
-            if (req->mode == LOCK_SHARED)
+            release_granted(lm, bucket, entry, req);
+        }
+        pthread_mutex_unlock(&bucket->latch);
+    }
+}
+
+// Replace a transaction's row locks on a table by one table lock (X for
+// writes, S for reads) and drop the row locks it covers. If the table
+// lock is refused (an older transaction holds a conflicting one) the row
+// locks stay, and the next try comes after another threshold's worth.
+static void escalate_row_locks(LockManager *lm, Transaction *txn, int slot, LockMode row_mode)
+{
+    int table_id = txn->table_locks[slot].table_id;
+    LockMode mode = (row_mode == LOCK_INTENTION_EXCLUSIVE || row_mode == LOCK_EXCLUSIVE) ? LOCK_EXCLUSIVE : LOCK_SHARED;
+
+    if (!lock_acquire(lm, txn->id, table_id, true, mode))
+    {
+        txn->table_locks[slot].row_locks = 0;
+        return;
+    }
+    LockMode held = txn->table_locks[slot].mode;
+
+    // Take the covered row locks off the transaction's list
+    LockRequest *covered = NULL;
+    int kept = 0;
+    pthread_mutex_lock(&txn->latch);
+    LockRequest **link = &txn->held_locks;
+    while (*link)
+    {
+        LockRequest *req = *link;
+        if (!req->is_table && (int)(req->resource_id >> 32) == table_id)
+        {
+            if (table_covers_row(held, req->mode))
             {
-                entry->shared_count--;
-            }
-            else
-            { // LOCK_EXCLUSIVE
-                entry->exclusive_owner = -1;
+                *link = req->next;
+                req->next = covered;
+                covered = req;
+                continue;
             }
-
-            // Process waiting requests
-            process_waiting_requests(lm, entry);
+            kept++;
         }
-
-        free(req);
+        link = &req->next;
     }
+    pthread_mutex_unlock(&txn->latch);
+
+    txn->table_locks[slot].row_locks = kept;
+    release_all_locks(lm, covered);
+    STAT_ADD(thread_stats()->escalations, 1);
 }
 
 // Commit a transaction
 bool transaction_commit(LockManager *lm, int txn_id)
 {
-    pthread_mutex_lock(&lm->mutex);
-
     // Find the transaction
     Transaction *txn = find_transaction(lm, txn_id);
-    if (!txn || !txn->active)
+    if (!txn)
     {
-        pthread_mutex_unlock(&lm->mutex);
         return false;
     }
 
-    // Release all locks
-    release_all_locks(lm, txn);
-
-    // Mark transaction as inactive
+    // Mark transaction as inactive and take its locks
+    pthread_mutex_lock(&txn->latch);
+    if (!txn->active)
+    {
+        pthread_mutex_unlock(&txn->latch);
+        return false;
+    }
     txn->active = false;
+    LockRequest *held = txn->held_locks;
+    txn->held_locks = NULL;
+    pthread_mutex_unlock(&txn->latch);
 
-    pthread_mutex_unlock(&lm->mutex);
+    // Release all locks
+    release_all_locks(lm, held);
+
+    // Recycle the slot
+    __atomic_store_n(&txn->in_use, 0, __ATOMIC_RELEASE);
     return true;
 }
 
@@ -374,42 +710,486 @@ bool transaction_abort(LockManager *lm, int txn_id)
     return transaction_commit(lm, txn_id);
 }
 
-// Clean up lock manager
-void lock_manager_cleanup(LockManager *lm)
+// Waits-for graph the detector builds from the lock queues. Nodes are the
+// blocked transactions (each waits on one resource); edges run from a
+// waiter to every holder whose grant blocks it, kept only when the holder
+// is itself blocked, since a cycle can only pass through blocked nodes.
+typedef struct {
+    int txn_id;
+    uint64_t resource_id; // What it waits for
+    bool is_table;
+} WaitNode;
+
+typedef struct {
+    int waiter, holder; // Transaction ids, then node indexes
+} WaitEdge;
+
+typedef struct {
+    WaitNode *nodes;
+    int node_count, node_cap;
+    WaitEdge *edges;
+    int edge_count, edge_cap;
+    int *first;  // Edges of node i are edges[first[i] .. first[i + 1])
+    char *state; // 0 unvisited, 1 on the DFS stack, 2 done, 3 victim
+    int *stack, *cursor;
+} WaitGraph;
+
+static int compare_node(const void *a, const void *b)
+{
+    int x = ((const WaitNode *)a)->txn_id, y = ((const WaitNode *)b)->txn_id;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_edge(const void *a, const void *b)
 {
-    // Free all lock entries
-    while (lm->lock_table)
+    const WaitEdge *x = (const WaitEdge *)a, *y = (const WaitEdge *)b;
+    if (x->waiter != y->waiter)
+        return x->waiter < y->waiter ? -1 : 1;
+    return x->holder < y->holder ? -1 : x->holder > y->holder;
+}
+
+// Node index of a transaction, -1 if it is not blocked
+static int graph_node(WaitGraph *g, int txn_id)
+{
+    int lo = 0, hi = g->node_count - 1;
+    while (lo <= hi)
     {
-        LockEntry *entry = lm->lock_table;
-        lm->lock_table = entry->next;
+        int mid = (lo + hi) / 2;
+        if (g->nodes[mid].txn_id == txn_id)
+            return mid;
+        if (g->nodes[mid].txn_id < txn_id)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
 
-        // Free waiting list
-        while (entry->waiting_list)
+static bool graph_grow(void **array, int *cap, int count, size_t size)
+{
+    if (count < *cap)
+        return true;
+    int new_cap = *cap ? *cap * 2 : 256;
+    void *grown = realloc(*array, size * new_cap);
+    if (!grown)
+        return false;
+    *array = grown;
+    *cap = new_cap;
+    return true;
+}
+
+// Copy the waits of every queue, one bucket latch at a time. The picture
+// is not atomic, so a cycle found may already be gone; that only costs
+// an unneeded abort, and a real deadlock never goes away by itself.
+static bool graph_collect(LockManager *lm, WaitGraph *g)
+{
+    for (int i = 0; i < LOCK_BUCKETS; i++)
+    {
+        LockBucket *bucket = &lm->buckets[i];
+        pthread_mutex_lock(&bucket->latch);
+        for (LockEntry *entry = bucket->entries; entry; entry = entry->next)
         {
-            LockRequest *req = entry->waiting_list;
-            entry->waiting_list = req->next;
-            free(req);
+            for (LockWaiter *w = entry->waiters; w; w = w->next)
+            {
+                if (!graph_grow((void **)&g->nodes, &g->node_cap, g->node_count, sizeof(WaitNode)))
+                {
+                    pthread_mutex_unlock(&bucket->latch);
+                    return false;
+                }
+                g->nodes[g->node_count++] = (WaitNode){w->transaction_id, entry->resource_id, entry->is_table};
+
+                for (LockRequest *h = entry->granted; h; h = h->next_granted)
+                {
+                    if (h->transaction_id == w->transaction_id || lock_compatible[h->mode][w->mode])
+                        continue;
+                    if (!graph_grow((void **)&g->edges, &g->edge_cap, g->edge_count, sizeof(WaitEdge)))
+                    {
+                        pthread_mutex_unlock(&bucket->latch);
+                        return false;
+                    }
+                    g->edges[g->edge_count++] = (WaitEdge){w->transaction_id, h->transaction_id};
+                }
+            }
         }
+        pthread_mutex_unlock(&bucket->latch);
+    }
+    return true;
+}
+
+// Index the graph: nodes by transaction id, edges by waiter (CSR)
+static bool graph_index(WaitGraph *g)
+{
+    int n = g->node_count;
+    qsort(g->nodes, n, sizeof(WaitNode), compare_node);
+    qsort(g->edges, g->edge_count, sizeof(WaitEdge), compare_edge);
+
+    g->first = (int *)malloc(sizeof(int) * (n + 1));
+    g->state = (char *)calloc(n, 1);
+    g->stack = (int *)malloc(sizeof(int) * n);
+    g->cursor = (int *)malloc(sizeof(int) * n);
+    if (!g->first || !g->state || !g->stack || !g->cursor)
+        return false;
 
-        free(entry);
+    // Keep the edges into blocked nodes, renumbered to node indexes; they
+    // stay grouped by waiter in node order
+    int kept = 0, node = 0;
+    for (int e = 0; e < g->edge_count; e++)
+    {
+        int from = graph_node(g, g->edges[e].waiter);
+        int to = graph_node(g, g->edges[e].holder);
+        if (from < 0 || to < 0 || (kept > 0 && g->edges[kept - 1].waiter == from && g->edges[kept - 1].holder == to))
+            continue;
+        while (node <= from)
+            g->first[node++] = kept;
+        g->edges[kept++] = (WaitEdge){from, to};
     }
+    while (node <= n)
+        g->first[node++] = kept;
+    g->edge_count = kept;
+    return true;
+}
 
-    // Free all transactions
-    while (lm->transactions)
+// Find a cycle avoiding victims; returns its length with its nodes in
+// cycle (part of stack), 0 if there is none
+static int graph_find_cycle(WaitGraph *g, int **cycle)
+{
+    for (int i = 0; i < g->node_count; i++)
     {
-        Transaction *txn = lm->transactions;
-        lm->transactions = txn->next;
+        if (g->state[i] != 3)
+            g->state[i] = 0;
+    }
 
-        // Free held locks
-        while (txn->held_locks)
+    for (int root = 0; root < g->node_count; root++)
+    {
+        if (g->state[root] != 0)
+            continue;
+        int depth = 0;
+        g->stack[depth] = root;
+        g->cursor[depth++] = g->first[root];
+        g->state[root] = 1;
+
+        while (depth > 0)
         {
-            LockRequest *req = txn->held_locks;
-            txn->held_locks = req->next;
-            free(req);
+            int u = g->stack[depth - 1];
+            if (g->cursor[depth - 1] == g->first[u + 1])
+            {
+                g->state[u] = 2;
+                depth--;
+                continue;
+            }
+            int v = g->edges[g->cursor[depth - 1]++].holder;
+            if (g->state[v] == 0)
+            {
+                g->stack[depth] = v;
+                g->cursor[depth++] = g->first[v];
+                g->state[v] = 1;
+            }
+            else if (g->state[v] == 1)
+            {
+                int start = depth - 1;
+                while (g->stack[start] != v)
+                    start--;
+                *cycle = &g->stack[start];
+                return depth - start;
+            }
         }
+    }
+    return 0;
+}
 
-        free(txn);
+// Locks a transaction holds, the detector's measure of its work so far
+static int held_lock_count(LockManager *lm, int txn_id)
+{
+    Transaction *txn = find_transaction(lm, txn_id);
+    int count = 0;
+    if (!txn)
+        return 0;
+    pthread_mutex_lock(&txn->latch);
+    if (txn->id == txn_id)
+    {
+        for (LockRequest *req = txn->held_locks; req; req = req->next)
+            count++;
     }
+    pthread_mutex_unlock(&txn->latch);
+    return count;
+}
 
-    pthread_mutex_destroy(&lm->mutex);
-}
\ No newline at end of file
+// Wake a victim with false, if it is still waiting where it was seen
+static void wake_victim(LockManager *lm, WaitNode *node)
+{
+    LockBucket *bucket = lock_bucket(lm, node->resource_id, node->is_table);
+    pthread_mutex_lock(&bucket->latch);
+    LockEntry *entry = find_lock_entry(bucket, node->resource_id, node->is_table);
+    for (LockWaiter *w = entry ? entry->waiters : NULL; w; w = w->next)
+    {
+        Transaction *txn;
+        if (w->transaction_id == node->txn_id && (txn = find_transaction(lm, node->txn_id)))
+        {
+            txn->deadlock_victim = true;
+            pthread_cond_broadcast(&entry->cond);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&bucket->latch);
+}
+
+// One detector pass: break every cycle in the current waits-for graph
+static void detect_deadlocks(LockManager *lm)
+{
+    WaitGraph g;
+    memset(&g, 0, sizeof(g));
+
+    if (graph_collect(lm, &g) && g.node_count > 1 && graph_index(&g))
+    {
+        int *cycle, length;
+        while ((length = graph_find_cycle(&g, &cycle)) > 0)
+        {
+            // Least work lost first, then the youngest
+            int victim = cycle[0], victim_work = held_lock_count(lm, g.nodes[victim].txn_id);
+            for (int i = 1; i < length; i++)
+            {
+                int work = held_lock_count(lm, g.nodes[cycle[i]].txn_id);
+                if (work < victim_work || (work == victim_work && g.nodes[cycle[i]].txn_id > g.nodes[victim].txn_id))
+                {
+                    victim = cycle[i];
+                    victim_work = work;
+                }
+            }
+            g.state[victim] = 3;
+            wake_victim(lm, &g.nodes[victim]);
+        }
+    }
+
+    free(g.nodes);
+    free(g.edges);
+    free(g.first);
+    free(g.state);
+    free(g.stack);
+    free(g.cursor);
+}
+
+static void *deadlock_detector(void *arg)
+{
+    LockManager *lm = (LockManager *)arg;
+
+    pthread_mutex_lock(&lm->detector_latch);
+    while (!lm->detector_stop)
+    {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += LOCK_DETECT_INTERVAL_MS * 1000000L;
+        until.tv_sec += until.tv_nsec / 1000000000L;
+        until.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&lm->detector_cond, &lm->detector_latch, &until);
+        if (lm->detector_stop)
+            break;
+
+        pthread_mutex_unlock(&lm->detector_latch);
+        if (__atomic_load_n(&lm->waiting, __ATOMIC_RELAXED) > 1)
+            detect_deadlocks(lm);
+        pthread_mutex_lock(&lm->detector_latch);
+    }
+    pthread_mutex_unlock(&lm->detector_latch);
+    return NULL;
+}
+
+// Switch deadlock handling
+bool lock_manager_set_policy(LockManager *lm, DeadlockPolicy policy)
+{
+    if (policy == lm->policy)
+        return true;
+
+    if (policy == LOCK_DETECT)
+    {
+        lm->detector_stop = false;
+        if (pthread_create(&lm->detector, NULL, deadlock_detector, lm) != 0)
+        {
+            printf("Error: Failed to start the deadlock detector\n");
+            return false;
+        }
+    }
+    else
+    {
+        pthread_mutex_lock(&lm->detector_latch);
+        lm->detector_stop = true;
+        pthread_cond_signal(&lm->detector_cond);
+        pthread_mutex_unlock(&lm->detector_latch);
+        pthread_join(lm->detector, NULL);
+    }
+    lm->policy = policy;
+    return true;
+}
+
+// Clean up lock manager
+void lock_manager_cleanup(LockManager *lm)
+{
+    lock_manager_set_policy(lm, LOCK_WAIT_DIE);
+    pthread_mutex_destroy(&lm->detector_latch);
+    pthread_cond_destroy(&lm->detector_cond);
+
+    // Every lock entry and request lives in the pools, so unmapping their
+    // arenas releases them all at once
+    for (int i = 0; i < LOCK_BUCKETS; i++)
+    {
+        pthread_mutex_destroy(&lm->buckets[i].latch);
+    }
+    free(lm->buckets);
+    lm->buckets = NULL;
+    for (int i = 0; i < TXN_SLOTS; i++)
+    {
+        pthread_mutex_destroy(&lm->transactions[i].latch);
+    }
+    free(lm->transactions);
+    lm->transactions = NULL;
+
+    mem_pool_destroy(&lm->request_pool);
+    mem_pool_destroy(&lm->entry_pool);
+}
+
+// Order hot slots by resource, so equal ones sit next to each other
+static int compare_hot(const void *a, const void *b)
+{
+    const HotSlot *x = (const HotSlot *)a, *y = (const HotSlot *)b;
+    if (x->resource_id != y->resource_id)
+        return x->resource_id < y->resource_id ? -1 : 1;
+    return (int)x->is_table - (int)y->is_table;
+}
+
+// Add a thread's (or the retired) hot slots to a merge array
+static int gather_hot(HotSlot *all, int count, const HotSlot *hot, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        HotSlot slot;
+        slot.events = __atomic_load_n(&hot[i].events, __ATOMIC_RELAXED);
+        slot.resource_id = __atomic_load_n(&hot[i].resource_id, __ATOMIC_RELAXED);
+        slot.is_table = __atomic_load_n(&hot[i].is_table, __ATOMIC_RELAXED);
+        if (slot.events > 0)
+            all[count++] = slot;
+    }
+    return count;
+}
+
+// Add one block's counters to the totals
+static void add_counts(LockStats *stats, LockThreadStats *ts)
+{
+    stats->acquires += __atomic_load_n(&ts->acquires, __ATOMIC_RELAXED);
+    stats->cached += __atomic_load_n(&ts->cached, __ATOMIC_RELAXED);
+    stats->waits += __atomic_load_n(&ts->waits, __ATOMIC_RELAXED);
+    stats->deaths += __atomic_load_n(&ts->deaths, __ATOMIC_RELAXED);
+    stats->deadlocks += __atomic_load_n(&ts->deadlocks, __ATOMIC_RELAXED);
+    stats->released += __atomic_load_n(&ts->released, __ATOMIC_RELAXED);
+    stats->escalations += __atomic_load_n(&ts->escalations, __ATOMIC_RELAXED);
+    stats->wait_us += __atomic_load_n(&ts->wait_us, __ATOMIC_RELAXED);
+    for (int b = 0; b < LOCK_WAIT_BUCKETS; b++)
+        stats->wait_hist[b] += __atomic_load_n(&ts->wait_hist[b], __ATOMIC_RELAXED);
+    int queue = __atomic_load_n(&ts->max_queue, __ATOMIC_RELAXED);
+    if (queue > stats->max_queue)
+        stats->max_queue = queue;
+}
+
+// Sum the statistics
+void lock_stats_collect(LockManager *lm, LockStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&stats_mutex);
+    int blocks = 0;
+    for (LockThreadStats *ts = stats_live; ts; ts = ts->next)
+        blocks++;
+    int capacity = blocks * LOCK_HOT_TRACKED + LOCK_HOT_TRACKED * 4;
+    HotSlot *all = (HotSlot *)malloc(sizeof(HotSlot) * capacity);
+    int count = 0;
+
+    add_counts(stats, &stats_retired);
+    for (LockThreadStats *ts = stats_live; ts; ts = ts->next)
+    {
+        add_counts(stats, ts);
+        if (all)
+            count = gather_hot(all, count, ts->hot, LOCK_HOT_TRACKED);
+    }
+    if (all)
+        count = gather_hot(all, count, retired_hot, LOCK_HOT_TRACKED * 4);
+    pthread_mutex_unlock(&stats_mutex);
+
+    // Merge the slots of each resource, then keep the top LOCK_STATS_TOP
+    if (all)
+    {
+        qsort(all, count, sizeof(HotSlot), compare_hot);
+        for (int i = 0; i < count;)
+        {
+            LockHotResource hot = {all[i].resource_id, all[i].is_table, 0};
+            int j = i;
+            while (j < count && compare_hot(&all[j], &all[i]) == 0)
+                hot.events += all[j++].events;
+            i = j;
+
+            int pos;
+            if (stats->hot_count < LOCK_STATS_TOP)
+                pos = stats->hot_count++;
+            else if (hot.events > stats->hot[LOCK_STATS_TOP - 1].events)
+                pos = LOCK_STATS_TOP - 1;
+            else
+                continue;
+            while (pos > 0 && stats->hot[pos - 1].events < hot.events)
+            {
+                stats->hot[pos] = stats->hot[pos - 1];
+                pos--;
+            }
+            stats->hot[pos] = hot;
+        }
+        free(all);
+    }
+
+    // Current queues, one bucket at a time
+    for (int i = 0; i < LOCK_BUCKETS; i++)
+    {
+        LockBucket *bucket = &lm->buckets[i];
+        pthread_mutex_lock(&bucket->latch);
+        for (LockEntry *entry = bucket->entries; entry; entry = entry->next)
+        {
+            stats->entries++;
+            stats->waiting += entry->waiter_count;
+            if (entry->waiter_count > stats->longest_queue)
+                stats->longest_queue = entry->waiter_count;
+        }
+        pthread_mutex_unlock(&bucket->latch);
+    }
+}
+
+// Format statistics as text
+int lock_stats_format(const LockStats *stats, char *buf, size_t size)
+{
+    size_t len = 0;
+#define APPEND(...) len += snprintf(buf + (len < size ? len : size), len < size ? size - len : 0, __VA_ARGS__)
+
+    APPEND("acquires %lu (%lu from the table lock cache), released %lu, escalations %lu\n",
+           stats->acquires, stats->cached, stats->released, stats->escalations);
+    APPEND("waits %lu (avg %lu us, longest queue %d), wait-die aborts %lu, deadlock victims %lu\n",
+           stats->waits, stats->waits ? stats->wait_us / stats->waits : 0, stats->max_queue,
+           stats->deaths, stats->deadlocks);
+    APPEND("wait time:");
+    for (int b = 0; b < LOCK_WAIT_BUCKETS; b++)
+    {
+        if (stats->wait_hist[b] == 0)
+            continue;
+        if (b < LOCK_WAIT_BUCKETS - 1)
+            APPEND(" <%luus %lu", 1UL << b, stats->wait_hist[b]);
+        else
+            APPEND(" >=%luus %lu", 1UL << (b - 1), stats->wait_hist[b]);
+    }
+    APPEND("\nnow: %d entries, %d waiting, longest queue %d\n",
+           stats->entries, stats->waiting, stats->longest_queue);
+    APPEND("hottest:");
+    for (int i = 0; i < stats->hot_count; i++)
+    {
+        const LockHotResource *hot = &stats->hot[i];
+        if (hot->is_table)
+            APPEND(" table %d (%lu)", (int)hot->resource_id, hot->events);
+        else
+            APPEND(" row %d:%d (%lu)", (int)(hot->resource_id >> 32), (int)(uint32_t)hot->resource_id, hot->events);
+    }
+    APPEND("\n");
+#undef APPEND
+    return (int)len;
+}
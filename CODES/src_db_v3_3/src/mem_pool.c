@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "../include/mem_pool.h"
+
+// Per-thread free list for one pool
+typedef struct ThreadCache
+{
+    unsigned generation; // Generation of the pool the objects belong to
+    void *head;          // Singly linked free objects
+    int count;           // Number of objects in the list
+} ThreadCache;
+
+static __thread ThreadCache thread_caches[MEM_POOL_MAX_POOLS];
+static __thread bool thread_registered;
+
+static MemPool *pools[MEM_POOL_MAX_POOLS]; // Pool of each id, NULL if free
+static unsigned next_generation = 1;
+static pthread_mutex_t pool_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t cache_key; // Drains a thread's caches when it exits
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+// Free objects are linked through their first word
+#define NEXT_FREE(obj) (*(void **)(obj))
+
+// Map a new arena, trying explicit huge pages first if requested
+static MemPoolArena *map_arena(MemPool *pool)
+{
+    MemPoolArena *arena = (MemPoolArena *)malloc(sizeof(MemPoolArena));
+    if (!arena)
+        return NULL;
+
+    void *base = MAP_FAILED;
+    arena->huge = false;
+
+#ifdef MAP_HUGETLB
+    if (pool->use_huge_pages)
+    {
+        base = mmap(NULL, MEM_POOL_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        arena->huge = (base != MAP_FAILED);
+    }
+#endif
+
+    if (base == MAP_FAILED)
+    {
+        base = mmap(NULL, MEM_POOL_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            free(arena);
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        // Fall back to transparent huge pages when available
+        if (pool->use_huge_pages)
+            madvise(base, MEM_POOL_ARENA_SIZE, MADV_HUGEPAGE);
+#endif
+    }
+
+    arena->base = base;
+    arena->size = MEM_POOL_ARENA_SIZE;
+    arena->next = pool->arenas;
+    pool->arenas = arena;
+    pool->arena_count++;
+
+    return arena;
+}
+
+// Take one object from the shared free list or the current arena.
+// Caller holds pool->mutex.
+static void *take_object_locked(MemPool *pool)
+{
+    if (pool->free_list)
+    {
+        void *obj = pool->free_list;
+        pool->free_list = NEXT_FREE(obj);
+        return obj;
+    }
+
+    if (pool->bump_ptr == NULL || pool->bump_ptr + pool->obj_size > pool->bump_end)
+    {
+        MemPoolArena *arena = map_arena(pool);
+        if (!arena)
+            return NULL;
+        pool->bump_ptr = (char *)arena->base;
+        pool->bump_end = (char *)arena->base + arena->size;
+    }
+
+    void *obj = pool->bump_ptr;
+    pool->bump_ptr += pool->obj_size;
+    return obj;
+}
+
+// Hand an exiting thread's cached objects back to their pools, or they
+// would be lost with the thread
+static void cache_thread_exit(void *arg)
+{
+    ThreadCache *caches = (ThreadCache *)arg;
+
+    // The registry mutex keeps mem_pool_destroy from unmapping the objects
+    // while they are linked in
+    pthread_mutex_lock(&pool_registry_mutex);
+    for (int i = 0; i < MEM_POOL_MAX_POOLS; i++)
+    {
+        ThreadCache *cache = &caches[i];
+        MemPool *pool = pools[i];
+        if (cache->head && pool && cache->generation == pool->generation)
+        {
+            void *last = cache->head;
+            while (NEXT_FREE(last))
+                last = NEXT_FREE(last);
+
+            pthread_mutex_lock(&pool->mutex);
+            NEXT_FREE(last) = pool->free_list;
+            pool->free_list = cache->head;
+            pthread_mutex_unlock(&pool->mutex);
+        }
+        cache->head = NULL;
+        cache->count = 0;
+    }
+    pthread_mutex_unlock(&pool_registry_mutex);
+}
+
+static void cache_key_create(void)
+{
+    pthread_key_create(&cache_key, cache_thread_exit);
+}
+
+// Get this thread's cache for a pool, or NULL if the pool has none
+static ThreadCache *get_thread_cache(MemPool *pool)
+{
+    if (pool->pool_id < 0)
+        return NULL;
+
+    if (!thread_registered)
+    {
+        pthread_once(&cache_once, cache_key_create);
+        pthread_setspecific(cache_key, thread_caches);
+        thread_registered = true;
+    }
+
+    ThreadCache *cache = &thread_caches[pool->pool_id];
+    if (cache->generation != pool->generation)
+    {
+        // Objects cached for a destroyed pool are gone with its arenas
+        cache->generation = pool->generation;
+        cache->head = NULL;
+        cache->count = 0;
+    }
+    return cache;
+}
+
+// Initialize a pool of objects of obj_size bytes
+void mem_pool_init(MemPool *pool, const char *name, size_t obj_size, bool use_huge_pages)
+{
+    memset(pool, 0, sizeof(MemPool));
+
+    // Objects must hold the free-list link; keep larger objects on
+    // their own cache lines so neighbours do not false-share
+    if (obj_size < sizeof(void *))
+        obj_size = sizeof(void *);
+    size_t align = obj_size >= 64 ? 64 : 16;
+    pool->obj_size = (obj_size + align - 1) & ~(align - 1);
+
+    pool->name = name;
+    pool->use_huge_pages = use_huge_pages;
+    pthread_mutex_init(&pool->mutex, NULL);
+
+    pthread_mutex_lock(&pool_registry_mutex);
+    pool->pool_id = -1;
+    for (int i = 0; i < MEM_POOL_MAX_POOLS; i++)
+    {
+        if (!pools[i])
+        {
+            pools[i] = pool;
+            pool->pool_id = i;
+            break;
+        }
+    }
+    pool->generation = next_generation++;
+    pthread_mutex_unlock(&pool_registry_mutex);
+}
+
+// Allocate one object (uninitialized), NULL if out of memory
+void *mem_pool_alloc(MemPool *pool)
+{
+    ThreadCache *cache = get_thread_cache(pool);
+
+    if (cache && cache->head)
+    {
+        void *obj = cache->head;
+        cache->head = NEXT_FREE(obj);
+        cache->count--;
+        return obj;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    void *obj = take_object_locked(pool);
+
+    // Refill the thread's free list in the same critical section
+    if (obj && cache)
+    {
+        while (cache->count < MEM_POOL_CACHE_SIZE / 2)
+        {
+            void *extra = take_object_locked(pool);
+            if (!extra)
+                break;
+            NEXT_FREE(extra) = cache->head;
+            cache->head = extra;
+            cache->count++;
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return obj;
+}
+
+// Return an object to the pool
+void mem_pool_free(MemPool *pool, void *obj)
+{
+    if (!obj)
+        return;
+
+    ThreadCache *cache = get_thread_cache(pool);
+    if (!cache)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        NEXT_FREE(obj) = pool->free_list;
+        pool->free_list = obj;
+        pthread_mutex_unlock(&pool->mutex);
+        return;
+    }
+
+    NEXT_FREE(obj) = cache->head;
+    cache->head = obj;
+    cache->count++;
+
+    if (cache->count > MEM_POOL_CACHE_SIZE)
+    {
+        // Hand half of the cached objects back to the shared list
+        void *first = cache->head;
+        void *last = first;
+        for (int i = 1; i < MEM_POOL_CACHE_SIZE / 2; i++)
+            last = NEXT_FREE(last);
+
+        cache->head = NEXT_FREE(last);
+        cache->count -= MEM_POOL_CACHE_SIZE / 2;
+
+        pthread_mutex_lock(&pool->mutex);
+        NEXT_FREE(last) = pool->free_list;
+        pool->free_list = first;
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+// Unmap all arenas; every object of the pool becomes invalid
+void mem_pool_destroy(MemPool *pool)
+{
+    // Invalidate every thread's cache of this pool and free its slot
+    // first, so no exiting thread hands objects back to it from here on
+    pthread_mutex_lock(&pool_registry_mutex);
+    pool->generation = next_generation++;
+    if (pool->pool_id >= 0)
+        pools[pool->pool_id] = NULL;
+    pool->pool_id = -1;
+    pthread_mutex_unlock(&pool_registry_mutex);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->arenas)
+    {
+        MemPoolArena *arena = pool->arenas;
+        pool->arenas = arena->next;
+        munmap(arena->base, arena->size);
+        free(arena);
+    }
+    pool->free_list = NULL;
+    pool->bump_ptr = NULL;
+    pool->bump_end = NULL;
+    pool->arena_count = 0;
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+// Bytes of address space mapped by the pool
+size_t mem_pool_mapped_bytes(MemPool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    size_t bytes = pool->arena_count * (size_t)MEM_POOL_ARENA_SIZE;
+    pthread_mutex_unlock(&pool->mutex);
+    return bytes;
+}
@@ -0,0 +1,450 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include "../include/nvram_client.h"
+
+struct NvClient
+{
+    int fd;
+    unsigned char *value; // Value of the last response
+    size_t value_cap;
+    unsigned char *out;   // Queued requests not yet sent
+    size_t out_len, out_cap;
+};
+
+// Write all of iov, however the socket splits it
+static bool write_all(int fd, struct iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        // Drop what went out
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *buf, size_t len)
+{
+    char *p = (char *)buf;
+    while (len > 0)
+    {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Room for len more queued bytes
+static bool reserve(NvClient *client, size_t len)
+{
+    if (client->out_len + len <= client->out_cap)
+        return true;
+
+    size_t cap = client->out_cap ? client->out_cap : 4096;
+    while (cap < client->out_len + len)
+        cap *= 2;
+    unsigned char *grown = realloc(client->out, cap);
+    if (!grown)
+        return false;
+    client->out = grown;
+    client->out_cap = cap;
+    return true;
+}
+
+// Queue one request, sent with the next flush
+static NvStatus queue(NvClient *client, const NvRequest *req, const void *key, const void *value)
+{
+    if (!reserve(client, NV_REQUEST_HEADER + req->key_len + req->value_len))
+        return NV_DISCONNECTED;
+
+    unsigned char *p = client->out + client->out_len;
+    nv_encode_request(p, req);
+    if (req->key_len)
+        memcpy(p + NV_REQUEST_HEADER, key, req->key_len);
+    if (req->value_len)
+        memcpy(p + NV_REQUEST_HEADER + req->key_len, value, req->value_len);
+    client->out_len += NV_REQUEST_HEADER + req->key_len + req->value_len;
+    return NV_OK;
+}
+
+// Wait for the next response. Its value is left in client->value;
+// *result gets the response's result field.
+static NvStatus receive(NvClient *client, int32_t *result, size_t *value_len)
+{
+    if (client->out_len && nv_flush(client) != NV_OK)
+        return NV_DISCONNECTED;
+
+    unsigned char response[NV_RESPONSE_HEADER];
+    NvResponse resp;
+    if (!read_all(client->fd, response, sizeof(response)))
+        return NV_DISCONNECTED;
+    nv_decode_response(response, &resp);
+    if (resp.value_len > NV_MAX_RESPONSE)
+        return NV_DISCONNECTED; // Not a response we understand
+
+    if (resp.value_len > client->value_cap)
+    {
+        unsigned char *grown = realloc(client->value, resp.value_len);
+        if (!grown)
+            return NV_DISCONNECTED;
+        client->value = grown;
+        client->value_cap = resp.value_len;
+    }
+    if (!read_all(client->fd, client->value, resp.value_len))
+        return NV_DISCONNECTED;
+
+    if (result)
+        *result = resp.result;
+    if (value_len)
+        *value_len = resp.value_len;
+    return (NvStatus)resp.status;
+}
+
+// Send one request and wait for its response
+static NvStatus call(NvClient *client, const NvRequest *req, const void *key, const void *value,
+                     int32_t *result, size_t *value_len)
+{
+    if (client->out_len)
+        return NV_BAD_REQUEST; // Its response would be one still queued
+    if (queue(client, req, key, value) != NV_OK)
+        return NV_DISCONNECTED;
+    return receive(client, result, value_len);
+}
+
+NvClient *nv_connect(const char *host, int port)
+{
+    char service[16];
+    struct addrinfo hints, *addrs;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+    if (getaddrinfo(host, service, &hints, &addrs) != 0)
+    {
+        printf("Error: Unknown host %s\n", host);
+        return NULL;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *a = addrs; a && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) < 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addrs);
+    if (fd < 0)
+    {
+        printf("Error: Cannot connect to %s:%d\n", host, port);
+        return NULL;
+    }
+
+    // Requests are whole messages; don't hold them back for more
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // Ask for frames; the server answers with its own hello
+    unsigned char hello[NV_HELLO_LEN + 1], answer[NV_HELLO_LEN + 1];
+    memcpy(hello, NV_HELLO, NV_HELLO_LEN);
+    hello[NV_HELLO_LEN] = NV_VERSION;
+    struct iovec iov = {hello, sizeof(hello)};
+    if (!write_all(fd, &iov, 1) || !read_all(fd, answer, sizeof(answer)) ||
+        memcmp(answer, NV_HELLO, NV_HELLO_LEN) != 0 || answer[NV_HELLO_LEN] != NV_VERSION)
+    {
+        printf("Error: %s:%d does not speak protocol version %d\n", host, port, NV_VERSION);
+        close(fd);
+        return NULL;
+    }
+
+    NvClient *client = calloc(1, sizeof(NvClient));
+    if (!client)
+    {
+        close(fd);
+        return NULL;
+    }
+    client->fd = fd;
+    return client;
+}
+
+void nv_close(NvClient *client)
+{
+    if (!client)
+        return;
+    close(client->fd);
+    free(client->value);
+    free(client->out);
+    free(client);
+}
+
+// CREATE and OPEN send the name as the value
+static NvStatus table_call(NvClient *client, uint8_t opcode, const char *name, int index_type, int partitions, int *handle)
+{
+    size_t len = strlen(name);
+    NvRequest req = {(uint32_t)len, 0, opcode, 0, (uint32_t)partitions, index_type};
+    int32_t result = -1;
+    NvStatus status = call(client, &req, NULL, name, &result, NULL);
+    if (handle)
+        *handle = result;
+    return status;
+}
+
+NvStatus nv_create_table(NvClient *client, const char *name, int index_type, int partitions, int *handle)
+{
+    return table_call(client, NV_OP_CREATE, name, index_type, partitions > 0 ? partitions : 0, handle);
+}
+
+NvStatus nv_open_table(NvClient *client, const char *name, int *handle)
+{
+    return table_call(client, NV_OP_OPEN, name, 0, 0, handle);
+}
+
+static NvStatus simple_call(NvClient *client, uint8_t opcode, uint8_t flags)
+{
+    NvRequest req = {0, 0, opcode, flags, 0, 0};
+    return call(client, &req, NULL, NULL, NULL, NULL);
+}
+
+NvStatus nv_begin(NvClient *client, bool readonly)
+{
+    return simple_call(client, NV_OP_BEGIN, readonly ? NV_BEGIN_READONLY : 0);
+}
+
+NvStatus nv_commit(NvClient *client)
+{
+    return simple_call(client, NV_OP_COMMIT, 0);
+}
+
+NvStatus nv_abort(NvClient *client)
+{
+    return simple_call(client, NV_OP_ABORT, 0);
+}
+
+// A row operation: int key when key is NULL
+static NvStatus row_call(NvClient *client, uint8_t opcode, int table, int int_key, const void *key, size_t key_len,
+                         const void *value, size_t size, const void **out, size_t *out_size)
+{
+    if (key_len > NV_MAX_KEY || size > NV_MAX_VALUE)
+        return NV_BAD_REQUEST;
+
+    NvRequest req = {(uint32_t)size, (uint16_t)key_len, opcode, 0, (uint32_t)table, int_key};
+    size_t len = 0;
+    NvStatus status = call(client, &req, key, value, NULL, &len);
+    if (out)
+        *out = status == NV_OK ? client->value : NULL;
+    if (out_size)
+        *out_size = len;
+    return status;
+}
+
+NvStatus nv_get(NvClient *client, int table, int key, const void **value, size_t *size)
+{
+    return row_call(client, NV_OP_GET, table, key, NULL, 0, NULL, 0, value, size);
+}
+
+NvStatus nv_put(NvClient *client, int table, int key, const void *value, size_t size)
+{
+    return row_call(client, NV_OP_PUT, table, key, NULL, 0, value, size, NULL, NULL);
+}
+
+NvStatus nv_delete(NvClient *client, int table, int key)
+{
+    return row_call(client, NV_OP_DELETE, table, key, NULL, 0, NULL, 0, NULL, NULL);
+}
+
+NvStatus nv_get_bytes(NvClient *client, int table, const void *key, size_t key_len, const void **value, size_t *size)
+{
+    return row_call(client, NV_OP_GET, table, 0, key, key_len, NULL, 0, value, size);
+}
+
+NvStatus nv_put_bytes(NvClient *client, int table, const void *key, size_t key_len, const void *value, size_t size)
+{
+    return row_call(client, NV_OP_PUT, table, 0, key, key_len, value, size, NULL, NULL);
+}
+
+NvStatus nv_delete_bytes(NvClient *client, int table, const void *key, size_t key_len)
+{
+    return row_call(client, NV_OP_DELETE, table, 0, key, key_len, NULL, 0, NULL, NULL);
+}
+
+NvStatus nv_queue_get(NvClient *client, int table, int key)
+{
+    NvRequest req = {0, 0, NV_OP_GET, 0, (uint32_t)table, key};
+    return queue(client, &req, NULL, NULL);
+}
+
+NvStatus nv_queue_put(NvClient *client, int table, int key, const void *value, size_t size)
+{
+    if (size > NV_MAX_VALUE)
+        return NV_BAD_REQUEST;
+    NvRequest req = {(uint32_t)size, 0, NV_OP_PUT, 0, (uint32_t)table, key};
+    return queue(client, &req, NULL, value);
+}
+
+NvStatus nv_queue_delete(NvClient *client, int table, int key)
+{
+    NvRequest req = {0, 0, NV_OP_DELETE, 0, (uint32_t)table, key};
+    return queue(client, &req, NULL, NULL);
+}
+
+NvStatus nv_flush(NvClient *client)
+{
+    struct iovec iov = {client->out, client->out_len};
+    client->out_len = 0;
+    return iov.iov_len == 0 || write_all(client->fd, &iov, 1) ? NV_OK : NV_DISCONNECTED;
+}
+
+NvStatus nv_receive(NvClient *client, const void **value, size_t *size)
+{
+    size_t len = 0;
+    NvStatus status = receive(client, NULL, &len);
+    if (value)
+        *value = status == NV_OK ? client->value : NULL;
+    if (size)
+        *size = len;
+    return status;
+}
+
+// Request value of an MGET or MDELETE: the keys
+static unsigned char *encode_keys(const int *keys, int count)
+{
+    unsigned char *buf = malloc((size_t)count * 4 + 1);
+    for (int i = 0; buf && i < count; i++)
+        nv_put_u32(buf + i * 4, (uint32_t)keys[i]);
+    return buf;
+}
+
+NvStatus nv_mget(NvClient *client, int table, const int *keys, int count, NvValue *values, int *found)
+{
+    if (count < 0 || (size_t)count * 4 > NV_MAX_VALUE)
+        return NV_BAD_REQUEST;
+    unsigned char *buf = encode_keys(keys, count);
+    if (!buf)
+        return NV_DISCONNECTED;
+
+    NvRequest req = {(uint32_t)count * 4, 0, NV_OP_MGET, 0, (uint32_t)table, count};
+    int32_t result = 0;
+    size_t len = 0;
+    NvStatus status = call(client, &req, NULL, buf, &result, &len);
+    free(buf);
+    if (found)
+        *found = status == NV_OK ? result : 0;
+    if (status != NV_OK)
+        return status;
+
+    // Point each value into the response
+    size_t pos = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (len - pos < 4)
+            return NV_DISCONNECTED;
+        uint32_t size = nv_get_u32(client->value + pos);
+        pos += 4;
+        values[i].found = size != NV_ABSENT;
+        values[i].value = values[i].found ? client->value + pos : NULL;
+        values[i].size = values[i].found ? size : 0;
+        if (values[i].size > len - pos)
+            return NV_DISCONNECTED;
+        pos += values[i].size;
+    }
+    return NV_OK;
+}
+
+NvStatus nv_mput(NvClient *client, int table, const int *keys, const void *const *values, const size_t *sizes,
+                 int count, int *rows)
+{
+    size_t len = 0;
+    for (int i = 0; i < count; i++)
+        len += 8 + sizes[i];
+    if (count < 0 || len > NV_MAX_VALUE)
+        return NV_BAD_REQUEST;
+    unsigned char *buf = malloc(len + 1);
+    if (!buf)
+        return NV_DISCONNECTED;
+
+    unsigned char *p = buf;
+    for (int i = 0; i < count; i++)
+    {
+        nv_put_u32(p, (uint32_t)keys[i]);
+        nv_put_u32(p + 4, (uint32_t)sizes[i]);
+        memcpy(p + 8, values[i], sizes[i]);
+        p += 8 + sizes[i];
+    }
+
+    NvRequest req = {(uint32_t)len, 0, NV_OP_MPUT, 0, (uint32_t)table, count};
+    int32_t result = 0;
+    NvStatus status = call(client, &req, NULL, buf, &result, NULL);
+    free(buf);
+    if (rows)
+        *rows = result;
+    return status;
+}
+
+NvStatus nv_mdelete(NvClient *client, int table, const int *keys, int count, int *rows)
+{
+    if (count < 0 || (size_t)count * 4 > NV_MAX_VALUE)
+        return NV_BAD_REQUEST;
+    unsigned char *buf = encode_keys(keys, count);
+    if (!buf)
+        return NV_DISCONNECTED;
+
+    NvRequest req = {(uint32_t)count * 4, 0, NV_OP_MDELETE, 0, (uint32_t)table, count};
+    int32_t result = 0;
+    NvStatus status = call(client, &req, NULL, buf, &result, NULL);
+    free(buf);
+    if (rows)
+        *rows = result;
+    return status;
+}
+
+const char *nv_status_name(NvStatus status)
+{
+    switch (status)
+    {
+    case NV_OK:
+        return "ok";
+    case NV_NOT_FOUND:
+        return "not found";
+    case NV_FAILED:
+        return "failed";
+    case NV_NO_TABLE:
+        return "no such table";
+    case NV_NO_TRANSACTION:
+        return "no active transaction";
+    case NV_BAD_REQUEST:
+        return "bad request";
+    case NV_DISCONNECTED:
+        return "disconnected";
+    }
+    return "unknown status";
+}
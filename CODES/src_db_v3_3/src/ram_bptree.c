@@ -1,25 +1,44 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include "../include/free_space.h"
 #include "../include/ram_bptree.h"
 #include "../include/wal.h"
 #include "../include/lock_manager.h"
+#include "../include/mem_pool.h"
+#include "../include/art.h"
+#include "../include/cuckoo_hash.h"
+#include "../include/var_bptree.h"
 
-// Maximum number of tables
-#define MAX_TABLES 10
 #define MAX_TABLE_NAME 64
 
+// Table catalog sizing
+#define CATALOG_INITIAL_SLOTS 64 // Name slots before the first growth (power of two)
+#define CATALOG_ID_CHUNK 256     // Tables per chunk of the by-id directory
+#define CATALOG_ID_CHUNKS 4096   // Chunks, so up to 1M table ids
+
+// Keys a hash-indexed table has room for before it first grows
+#define CUCKOO_INITIAL_CAPACITY 1024
+
+// Latch-free descents of a B+ Tree a lookup tries before taking the latch
+#define BP_OPTIMISTIC_TRIES 4
+
 // B+ Tree node structure (in RAM)
 struct BPTreeNode
 {
     bool is_leaf;           // Is this a leaf node?
     int num_keys;           // Number of keys currently stored
-    int keys[BP_ORDER - 1]; // Array of keys (row IDs)
+    int keys[BP_ORDER];     // Array of keys (row IDs), one spare slot before a split
 
     union
     {
-        BPTreeNode *children[BP_ORDER]; // Internal node: pointers to children
+        struct
+        {
+            BPTreeNode *children[BP_ORDER + 1]; // Internal node: pointers to children
+            int counts[BP_ORDER + 1];           // Keys stored under each child
+        };
         struct
         {
             NVRAMPtr data_ptrs[BP_ORDER - 1]; // Leaf node: pointers to data in NVRAM
@@ -28,6 +47,7 @@ struct BPTreeNode
     };
 
     BPTreeNode *next_leaf; // Pointer to next leaf (for range queries)
+    BPTreeNode *prev_leaf; // Pointer to previous leaf (for reverse scans)
 };
 
 // B+ Tree structure (in RAM)
@@ -37,6 +57,8 @@ struct BPTree
     int height;       // Height of the tree
     int node_count;   // Number of nodes
     int record_count; // Number of records
+    pthread_rwlock_t latch; // Writers exclude; readers share it when they can't do without
+    uint64_t version;       // Odd during a change (lookups retry, cursors re-seek on mismatch)
 };
 
 // Table structure (in RAM)
@@ -44,22 +66,357 @@ struct Table
 {
     char name[MAX_TABLE_NAME]; // Table name
     int table_id;              // Unique ID
-    BPTree *index;             // B+ Tree index
+    IndexType index_type;      // Which index structure is used
+    BPTree *index;             // B+ Tree index (INDEX_BPTREE)
+    ArtTree *art;              // Radix tree index (INDEX_ART)
+    CuckooHash *hash;          // Hash index (INDEX_CUCKOO)
+    VarBPTree *vbt;            // Byte-string key index (INDEX_VARKEY)
+    int wal_id;                // WAL stream rows are logged to
+    PartitionMethod partition_method;
+    int num_partitions;        // 0 unless partitioned
+    Table **partitions;        // Sub-tables, each with its own index and WAL stream
+    int *bounds;               // PARTITION_RANGE: partition i holds keys < bounds[i]
     bool is_open;              // Is table open
 };
 
+// A row key as the API received it: an int, or a byte string
+typedef struct RowKey
+{
+    int value;                  // Int key (when bytes is NULL)
+    const unsigned char *bytes; // Byte-string key, or NULL
+    size_t len;                 // Length of bytes
+} RowKey;
+
+// Multi-version rows. The index maps a key to a RowHead in NVRAM, which
+// points to the newest RowVersion; each version points to the one it
+// replaced. begin_ts/end_ts hold commit timestamps, or TS_TXN | id while
+// the writing transaction is still running.
+#define TS_INFINITY UINT64_MAX           // end_ts of a live version
+#define TS_TXN (1ULL << 63)              // Flags an in-flight writer's id
+#define TS_COMMITTING (UINT64_MAX - 1)   // commit_ts while the timestamp is taken
+#define TS_ABORTED (UINT64_MAX - 2)      // commit_ts of a rolled back transaction
+
+// Row and WAL allocations are whole cache lines: a flush never covers a
+// neighbour's bytes, and a freed block always fits the next request
+// instead of leaving slivers in the first-fit free list
+#define NVRAM_ALIGN(n) (((n) + 63) & ~(size_t)63)
+
+// Pending deletes collected per pass once every snapshot sees them
+#define GC_BATCH 256
+
+// Read-only transactions that can run at once (power of two)
+#define READONLY_SLOTS 1024
+
+// Most NVRAM one block of a commit's write batch takes; larger write sets
+// are installed in several blocks
+#define WRITE_BATCH_BYTES (1 << 20)
+
+typedef struct RowVersion
+{
+    uint64_t begin_ts;         // Commit of the insert that created it
+    uint64_t end_ts;           // Commit of the delete that ended it, TS_INFINITY while live
+    struct RowVersion *older;  // Version this one replaced
+    size_t size;               // Bytes of row data
+    size_t alloc_size;         // NVRAM bytes the version occupies
+    unsigned char data[];
+} RowVersion;
+
+// What the index stores for a key. It stays put while versions come and
+// go, so only the first insert and the final reclaim touch the index.
+typedef struct RowHead
+{
+    RowVersion *latest;
+} RowHead;
+
+// NVRAM a head occupies: a whole line, so the head and the version
+// allocated with it each free back a multiple of 64 bytes
+#define ROW_HEAD_SIZE NVRAM_ALIGN(sizeof(RowHead))
+
+// A row a transaction inserted or deleted. Kept on the transaction until
+// it ends (abort undoes it); a committed delete then waits on the garbage
+// list until no snapshot can see the deleted version.
+typedef struct RowChange
+{
+    struct RowChange *next;
+    Table *part;          // Partition holding the row
+    RowHead *head;
+    RowVersion *version;  // Version created (insert) or ended (delete)
+    bool is_delete;
+    uint64_t commit_ts;   // Set when the transaction commits
+    int key;              // Int key, or...
+    bool byte_key;        // ...key_len bytes of key_bytes
+    size_t key_len;
+    unsigned char key_bytes[];
+} RowChange;
+
+// A row an optimistic transaction read, or looked up before writing it,
+// with the version its snapshot saw (NULL if none). Commit checks that
+// nobody has changed the row since.
+typedef struct RowRead
+{
+    struct RowRead *next;
+    Table *part;          // Partition holding the row
+    int table_id;         // Table and row lock a writer of the row takes
+    uint64_t lock_id;
+    RowVersion *version;
+    int key;              // Int key, or...
+    bool byte_key;        // ...key_len bytes of key_bytes
+    size_t key_len;
+    unsigned char key_bytes[];
+} RowRead;
+
+// A write a buffered (optimistic or deferred) transaction keeps in DRAM
+// until it commits
+typedef struct PendingWrite
+{
+    struct PendingWrite *next; // In the order issued
+    struct PendingWrite *older; // Previous write of the same key, if any
+    Table *table;
+    uint64_t lock_id;          // Row lock (optimistic: taken at commit)
+    bool is_delete;
+    bool superseded;           // A later write of the key replaces it
+    void *data;                // Row bytes, stored after the key
+    size_t size;
+    int key;
+    bool byte_key;
+    size_t key_len;
+    unsigned char key_bytes[];
+} PendingWrite;
+
+// One key's net change when a buffered transaction commits
+typedef struct BatchOp
+{
+    PendingWrite *w;     // Newest write of the key
+    Table *part;         // Partition holding the row
+    RowKey key;
+    RowHead *head;       // Head in the index, NULL if the key is new to it
+    RowVersion *prior;   // Its newest version, live or not
+    bool ends;           // The transaction deletes the live prior version
+    bool put;            // ...and/or leaves w's data as a new version
+    size_t log_size;     // NVRAM for the key's WAL entries
+    size_t row_size;     // NVRAM for its version (and head if new)
+    RowVersion *version; // Filled in by the batch
+} BatchOp;
+
+// WAL entries of one stream in a batch, chained in order
+typedef struct WalChain
+{
+    int wal_id;
+    WALEntry *first, *last;
+} WalChain;
+
+// A key a buffered transaction has written or (optimistic) read
+typedef struct PendingKey
+{
+    PendingWrite *write; // Newest buffered write, NULL if none
+    RowRead *read;       // The read recorded for validation, NULL if none
+} PendingKey;
+
+// Keys of a buffered transaction, open addressing on the row lock id
+typedef struct PendingIndex
+{
+    size_t mask;  // Number of slots - 1
+    size_t count;
+    PendingKey slots[];
+} PendingIndex;
+
+// Row-version state of the transaction in each lock manager slot
+typedef struct TxnState
+{
+    int id;             // Transaction the state belongs to
+    TxnMode mode;
+    uint64_t commit_ts; // 0 while running, then TS_COMMITTING, its timestamp or TS_ABORTED
+    RowChange *changes; // Newest first
+    RowRead *reads;     // Optimistic only: rows to validate at commit
+    PendingWrite *writes, *last_write; // Buffered modes: writes to apply at commit
+    bool untracked;     // Optimistic only: a read could not be recorded, so commit fails
+    PendingIndex *pending; // Buffered modes: writes by key
+} __attribute__((aligned(64))) TxnState;
+
+// A read-only transaction: just a snapshot, alone on its cache line.
+// Its id is TXN_ID_LIMIT | generation | slot, so it never matches a
+// lock manager transaction and a stale id never matches a reused slot.
+typedef struct ReadonlySlot
+{
+    uint64_t snapshot;   // TS_INFINITY while free, 0 while being claimed
+    int id;              // Transaction in the slot, 0 if none
+    unsigned generation; // Bumped by each claim
+} __attribute__((aligned(64))) ReadonlySlot;
+
+// NVRAM unlinked from every chain, freed once the readers that could
+// still hold it have finished
+typedef struct Garbage
+{
+    struct Garbage *next;
+    void *ptr;
+    size_t size;
+    uint64_t unlinked_ts; // Clock when it was unlinked
+} Garbage;
+
+// Name lookup table of the catalog: open addressing with linear probing.
+// Tables are never dropped, so there are no tombstones and a probe stops
+// at the first empty slot.
+typedef struct CatalogNames
+{
+    size_t mask;                  // Number of slots - 1
+    struct CatalogNames *retired; // Smaller arrays it replaced (freed at shutdown)
+    Table *slots[];               // NULL = empty
+} CatalogNames;
+
 // Global state
-static Table *tables[MAX_TABLES] = {NULL};
+
+// Table catalog. Readers take no lock: a table is published with a
+// release store once it is fully built, and a grown name array replaces
+// the old one the same way. Replaced arrays stay allocated until
+// db_shutdown, so a reader still probing one never touches freed memory.
+static CatalogNames *catalog_names = NULL;
+static Table **catalog_ids[CATALOG_ID_CHUNKS]; // By id, in chunks that never move
+static pthread_mutex_t catalog_mutex = PTHREAD_MUTEX_INITIALIZER; // Serializes table creation
+static int table_count = 0;
 static int next_table_id = 0;
+static int next_wal_id = 0;
 static bool is_initialized = false;
 
 // Global lock manager
 LockManager g_lock_manager;
 
+// Snapshots. A transaction reads versions committed at or before the
+// clock value it saw at begin; commits take clock + 1. snapshots[] holds
+// that value per transaction slot (TS_INFINITY when idle) in a dense
+// array so the garbage collector can scan it quickly.
+static uint64_t commit_clock = 0;
+static TxnState *txn_states = NULL;
+static uint64_t *snapshots = NULL;
+static int active_snapshots = 0;
+
+// Read-only transactions keep their snapshots apart, so beginning one
+// takes no lock manager slot and touches no shared counter. A thread
+// goes back to the slot it used last, and the collector scans only the
+// slots below readonly_high.
+static ReadonlySlot *readonly_slots = NULL;
+static int readonly_high = 0;       // Slots ever claimed are below this
+static unsigned readonly_next = 0;  // Hands each thread its first slot
+static __thread int readonly_hint = -1;
+
+// Garbage collection
+static pthread_mutex_t gc_run_mutex = PTHREAD_MUTEX_INITIALIZER; // Held by the one collecting thread
+static pthread_mutex_t gc_mutex = PTHREAD_MUTEX_INITIALIZER;     // Protects the two lists
+static RowChange *gc_pending = NULL; // Committed deletes not yet reclaimed
+static int gc_pending_count = 0;
+static Garbage *gc_unlinked = NULL;
+static int gc_unlinked_count = 0;
+
+static uint32_t name_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+    {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static CatalogNames *catalog_names_create(size_t slots)
+{
+    CatalogNames *names = (CatalogNames *)calloc(1, sizeof(CatalogNames) + slots * sizeof(Table *));
+    if (names)
+        names->mask = slots - 1;
+    return names;
+}
+
+// Look a table up by name without locking
+static Table *catalog_find(const char *name)
+{
+    CatalogNames *names = __atomic_load_n(&catalog_names, __ATOMIC_ACQUIRE);
+    if (!names)
+        return NULL;
+
+    for (size_t i = name_hash(name) & names->mask;; i = (i + 1) & names->mask)
+    {
+        Table *table = __atomic_load_n(&names->slots[i], __ATOMIC_ACQUIRE);
+        if (!table)
+            return NULL;
+        if (strcmp(table->name, name) == 0)
+            return table;
+    }
+}
+
+// Look a table up by id without locking
+static Table *catalog_get(int table_id)
+{
+    if (table_id < 0 || table_id >= CATALOG_ID_CHUNK * CATALOG_ID_CHUNKS)
+        return NULL;
+
+    Table **chunk = __atomic_load_n(&catalog_ids[table_id / CATALOG_ID_CHUNK], __ATOMIC_ACQUIRE);
+    if (!chunk)
+        return NULL;
+    return __atomic_load_n(&chunk[table_id % CATALOG_ID_CHUNK], __ATOMIC_ACQUIRE);
+}
+
+static void names_insert(CatalogNames *names, Table *table)
+{
+    size_t i = name_hash(table->name) & names->mask;
+    while (names->slots[i])
+        i = (i + 1) & names->mask;
+    __atomic_store_n(&names->slots[i], table, __ATOMIC_RELEASE);
+}
+
+// Publish a fully built table (caller holds catalog_mutex)
+static bool catalog_add(Table *table)
+{
+    CatalogNames *names = catalog_names;
+    int chunk_idx = table->table_id / CATALOG_ID_CHUNK;
+
+    if (chunk_idx >= CATALOG_ID_CHUNKS)
+    {
+        printf("Error: Maximum number of tables reached\n");
+        return false;
+    }
+
+    if (!catalog_ids[chunk_idx])
+    {
+        Table **chunk = (Table **)calloc(CATALOG_ID_CHUNK, sizeof(Table *));
+        if (!chunk)
+        {
+            printf("Error: Failed to allocate memory for the table catalog\n");
+            return false;
+        }
+        __atomic_store_n(&catalog_ids[chunk_idx], chunk, __ATOMIC_RELEASE);
+    }
+
+    // Keep the name table at most half full
+    if ((size_t)(table_count + 1) * 2 > names->mask + 1)
+    {
+        CatalogNames *grown = catalog_names_create((names->mask + 1) * 2);
+        if (!grown)
+        {
+            printf("Error: Failed to allocate memory for the table catalog\n");
+            return false;
+        }
+        for (size_t i = 0; i <= names->mask; i++)
+        {
+            if (names->slots[i])
+                names_insert(grown, names->slots[i]);
+        }
+        grown->retired = names;
+        __atomic_store_n(&catalog_names, grown, __ATOMIC_RELEASE);
+        names = grown;
+    }
+
+    names_insert(names, table);
+    __atomic_store_n(&catalog_ids[chunk_idx][table->table_id % CATALOG_ID_CHUNK], table, __ATOMIC_RELEASE);
+    table_count++;
+    return true;
+}
+
+// Pool all B+ Tree nodes are carved from
+static MemPool node_pool;
+
 // Helper function to allocate a new node in RAM
 static BPTreeNode *create_node(bool is_leaf)
 {
-    BPTreeNode *node = (BPTreeNode *)malloc(sizeof(BPTreeNode));
+    BPTreeNode *node = (BPTreeNode *)mem_pool_alloc(&node_pool);
     if (!node)
         return NULL;
 
@@ -67,6 +424,7 @@ static BPTreeNode *create_node(bool is_leaf)
     node->is_leaf = is_leaf;
     node->num_keys = 0;
     node->next_leaf = NULL;
+    node->prev_leaf = NULL;
 
     // Clear memory
     memset(node->keys, 0, sizeof(node->keys));
@@ -104,6 +462,14 @@ static BPTree *create_tree()
     tree->height = 1;
     tree->node_count = 1;
     tree->record_count = 0;
+    // Readers take no row locks, so a steady stream of them would keep a
+    // reader-preferring latch shared forever and starve inserts
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&tree->latch, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    tree->version = 0;
 
     return tree;
 }
@@ -139,8 +505,11 @@ static BPTreeNode *split_leaf(BPTree *tree, BPTreeNode *leaf, int *up_key)
     new_leaf->num_keys = leaf->num_keys - mid;
     leaf->num_keys = mid;
 
-    // Link leaves for sequential access
+    // Link leaves for sequential access in both directions
     new_leaf->next_leaf = leaf->next_leaf;
+    new_leaf->prev_leaf = leaf;
+    if (leaf->next_leaf)
+        leaf->next_leaf->prev_leaf = new_leaf;
     leaf->next_leaf = new_leaf;
 
     // Update tree stats
@@ -241,6 +610,25 @@ static int find_key_in_leaf(BPTreeNode *leaf, int key)
     return -1; // Key not found
 }
 
+// Number of keys stored under a node
+static int subtree_count(BPTreeNode *node)
+{
+    if (node->is_leaf)
+        return node->num_keys;
+
+    int total = 0;
+    for (int i = 0; i <= node->num_keys; i++)
+        total += node->counts[i];
+    return total;
+}
+
+// Recompute an internal node's per-child counts after its children changed
+static void refresh_counts(BPTreeNode *node)
+{
+    for (int i = 0; i <= node->num_keys; i++)
+        node->counts[i] = subtree_count(node->children[i]);
+}
+
 // Helper function to insert key recursively
 static bool insert_recursive(BPTree *tree, BPTreeNode *node, int key, void *data, size_t size, int *up_key, BPTreeNode **new_node)
 {
@@ -309,25 +697,28 @@ static bool insert_recursive(BPTree *tree, BPTreeNode *node, int key, void *data
             return false;
         }
 
-        // If child did not split, we're done
+        // If child did not split, only its count changed
         if (new_child == NULL)
         {
+            node->counts[i] = subtree_count(child);
             return true;
         }
 
         // If child split, we need to insert the new key and child
-        if (node->num_keys < BP_ORDER - 1)
+        insert_in_internal(tree, node, child_up_key, new_child);
+        if (node->num_keys < BP_ORDER)
         {
-            // Node has space
-            return insert_in_internal(tree, node, child_up_key, new_child);
-        }
-        else
-        {
-            // Node needs to split
-            insert_in_internal(tree, node, child_up_key, new_child);
-            *new_node = split_internal(tree, node, up_key);
-            return *new_node != NULL;
+            // Node had space
+            refresh_counts(node);
+            return true;
         }
+
+        // Node needs to split
+        *new_node = split_internal(tree, node, up_key);
+        refresh_counts(node);
+        if (*new_node)
+            refresh_counts(*new_node);
+        return *new_node != NULL;
     }
 }
 
@@ -366,6 +757,8 @@ static bool merge_nodes(BPTreeNode *left, BPTreeNode *right, int parent_key_idx,
 
         left->num_keys += right->num_keys;
         left->next_leaf = right->next_leaf;
+        if (right->next_leaf)
+            right->next_leaf->prev_leaf = left;
     }
     else
     {
@@ -381,6 +774,7 @@ static bool merge_nodes(BPTreeNode *left, BPTreeNode *right, int parent_key_idx,
 
         left->children[left->num_keys + right->num_keys] = right->children[right->num_keys];
         left->num_keys += right->num_keys;
+        refresh_counts(left);
     }
 
     // Remove parent key and adjust child pointers
@@ -397,7 +791,7 @@ static bool merge_nodes(BPTreeNode *left, BPTreeNode *right, int parent_key_idx,
     parent->num_keys--;
 
     // Free the right node
-    free(right);
+    mem_pool_free(&node_pool, right);
 
     return true;
 }
@@ -417,10 +811,7 @@ static bool remove_recursive(BPTree *tree, BPTreeNode *node, int key, BPTreeNode
             return false;
         }
 
-        // Free NVRAM data
-        free_memory(node->data_ptrs[pos], node->data_sizes[pos]);
-
-        // Remove key and shift others
+        // Remove key and shift others (the caller reclaims the row)
         for (int i = pos; i < node->num_keys - 1; i++)
         {
             node->keys[i] = node->keys[i + 1];
@@ -538,11 +929,14 @@ static bool remove_recursive(BPTree *tree, BPTreeNode *node, int key, BPTreeNode
             // ...
         }
 
+        // Children may have shrunk, borrowed or merged
+        refresh_counts(node);
+
         // If parent has become empty (only happens when root becomes empty)
         if (node == tree->root && node->num_keys == 0)
         {
             tree->root = node->children[0];
-            free(node);
+            mem_pool_free(&node_pool, node);
             tree->height--;
             tree->node_count--;
         }
@@ -566,7 +960,7 @@ static void free_node(BPTreeNode *node)
         }
     }
 
-    free(node);
+    mem_pool_free(&node_pool, node);
 }
 
 // Helper function to free a B+ Tree
@@ -575,603 +969,3059 @@ static void free_tree(BPTree *tree)
     if (tree)
     {
         free_node(tree->root);
+        pthread_rwlock_destroy(&tree->latch);
         free(tree);
     }
 }
 
-// Initialize database system
-void db_init()
+// Insert a new key into a B+ Tree (the key must not exist yet)
+static bool bptree_insert(BPTree *tree, int key, NVRAMPtr data, size_t size)
 {
-    if (is_initialized)
-        return;
+    // Handle empty tree case
+    if (tree->root == NULL)
+    {
+        tree->root = create_node(true);
+        if (!tree->root)
+        {
+            printf("Error: Failed to create root node\n");
+            return false;
+        }
 
-    // Initialize NVRAM free space manager
-    init_free_space();
+        tree->root->keys[0] = key;
+        tree->root->data_ptrs[0] = data;
+        tree->root->data_sizes[0] = size;
+        tree->root->num_keys = 1;
+        tree->record_count++;
+        return true;
+    }
 
-    // Initialize lock manager
-    lock_manager_init(&g_lock_manager);
+    // Recursive insertion
+    int up_key;
+    BPTreeNode *new_node = NULL;
 
-    // Initialize tables array
-    for (int i = 0; i < MAX_TABLES; i++)
+    if (!insert_recursive(tree, tree->root, key, data, size, &up_key, &new_node))
     {
-        tables[i] = NULL;
+        printf("Error: Failed to insert key\n");
+        return false;
     }
 
-    is_initialized = true;
-    printf("Database system initialized\n");
-}
-
-// Shutdown database system
-void db_shutdown()
-{
-    if (!is_initialized)
-        return;
-
-    // Close and free all tables
-    for (int i = 0; i < MAX_TABLES; i++)
+    // Root split case
+    if (new_node != NULL)
     {
-        if (tables[i])
+        // Create new root
+        BPTreeNode *new_root = create_node(false);
+        if (!new_root)
         {
-            // Free NVRAM data for all records
-            if (tables[i]->index)
-            {
-                // We would need to traverse all leaves and free NVRAM data
-                // For brevity, this code is omitted
-                free_tree(tables[i]->index);
-            }
-            free(tables[i]);
-            tables[i] = NULL;
+            printf("Error: Failed to create new root\n");
+            free_node(new_node);
+            return false;
         }
-    }
-
-    // Clean up NVRAM
-    cleanup_free_space();
 
-    // Clean up lock manager
-    lock_manager_cleanup(&g_lock_manager);
+        // Set up new root
+        new_root->keys[0] = up_key;
+        new_root->children[0] = tree->root;
+        new_root->children[1] = new_node;
+        new_root->num_keys = 1;
+        refresh_counts(new_root);
 
-    is_initialized = false;
-    printf("Database system shut down\n");
-}
+        // Update tree
+        tree->root = new_root;
+        tree->height++;
+        tree->node_count++;
+    }
 
-// Begin a transaction
-int db_begin_transaction()
-{
-    return transaction_begin(&g_lock_manager);
+    // Update record count
+    tree->record_count++;
+    return true;
 }
 
-// Modified commit transaction to update WAL commit pointers
-bool db_commit_transaction(int txn_id)
+// Smallest key in a B+ Tree that is greater than key (or >= when inclusive)
+static bool bptree_next_key(BPTree *tree, int key, bool inclusive, int *next_key)
 {
-    bool result = transaction_commit(&g_lock_manager, txn_id);
+    BPTreeNode *leaf = find_leaf(tree, key);
 
-    if (result)
+    while (leaf)
     {
-        // Update WAL commit pointers for all tables
-        // In a real implementation, you would track which tables were modified
-        // by the transaction and only update those
-        for (int i = 0; i < MAX_TABLES; i++)
+        for (int i = 0; i < leaf->num_keys; i++)
         {
-            if (tables[i] != NULL)
+            if (leaf->keys[i] > key || (inclusive && leaf->keys[i] == key))
             {
-                wal_advance_commit_ptr(tables[i]->table_id, txn_id);
+                *next_key = leaf->keys[i];
+                return true;
             }
         }
+        leaf = leaf->next_leaf;
     }
 
-    return result;
-}
-// Abort a transaction
-// In src/ram_bptree.c
-bool db_abort_transaction(int txn_id)
-{
-    return transaction_abort(&g_lock_manager, txn_id);
+    return false;
 }
 
-// Create a new table
-int db_create_table(const char *name)
+// Largest key in a B+ Tree that is smaller than key (or <= when inclusive)
+static bool bptree_prev_key(BPTree *tree, int key, bool inclusive, int *prev_key)
 {
-    if (!is_initialized)
-    {
-        printf("Error: Database not initialized\n");
-        return -1;
-    }
+    BPTreeNode *leaf = find_leaf(tree, key);
 
-    // Find a free slot in tables array
-    int slot = -1;
-    for (int i = 0; i < MAX_TABLES; i++)
+    while (leaf)
     {
-        if (tables[i] == NULL)
+        for (int i = leaf->num_keys - 1; i >= 0; i--)
         {
-            slot = i;
-            break;
+            if (leaf->keys[i] < key || (inclusive && leaf->keys[i] == key))
+            {
+                *prev_key = leaf->keys[i];
+                return true;
+            }
         }
+        leaf = leaf->prev_leaf;
     }
 
-    if (slot == -1)
-    {
-        printf("Error: Maximum number of tables reached\n");
-        return -1;
-    }
+    return false;
+}
 
-    // Check if table with same name already exists
-    for (int i = 0; i < MAX_TABLES; i++)
+// Number of keys in a B+ Tree smaller than key (or <= key when inclusive).
+// Sums the counts left of the search path, so it costs one root descent.
+static long bptree_rank(BPTree *tree, int key, bool inclusive)
+{
+    BPTreeNode *node = tree->root;
+    long rank = 0;
+
+    if (!node)
+        return 0;
+
+    while (!node->is_leaf)
     {
-        if (tables[i] && strcmp(tables[i]->name, name) == 0)
+        int i;
+        for (i = 0; i < node->num_keys; i++)
         {
-            printf("Error: Table '%s' already exists\n", name);
-            return -1;
+            if (key < node->keys[i])
+                break;
+            rank += node->counts[i];
         }
+        node = node->children[i];
     }
 
-    // Create table structure
-    Table *table = (Table *)malloc(sizeof(Table));
-    if (!table)
+    for (int i = 0; i < node->num_keys; i++)
     {
-        printf("Error: Failed to allocate memory for table\n");
-        return -1;
+        if (node->keys[i] > key || (!inclusive && node->keys[i] == key))
+            break;
+        rank++;
     }
 
-    // Create B+ Tree index
-    BPTree *tree = create_tree();
-    if (!tree)
-    {
-        printf("Error: Failed to create index for table\n");
-        free(table);
-        return -1;
-    }
+    return rank;
+}
 
-    // Initialize table
-    strncpy(table->name, name, MAX_TABLE_NAME - 1);
-    table->name[MAX_TABLE_NAME - 1] = '\0';
-    table->table_id = next_table_id++;
-    table->index = tree;
-    table->is_open = true;
+// Key at 0-based position rank in key order
+static bool bptree_select(BPTree *tree, long rank, int *key)
+{
+    BPTreeNode *node = tree->root;
 
-    // Create WAL table in NVRAM
-    void *wal_table_ptr = allocate_memory(sizeof(WALTable));
-    if (!wal_table_ptr)
-    {
-        printf("Error: Failed to allocate NVRAM for WAL table\n");
-        free_tree(tree);
-        free(table);
-        return -1;
-    }
+    if (!node || rank < 0 || rank >= tree->record_count)
+        return false;
 
-    // Initialize WAL table
-    if (!wal_create_table(table->table_id, wal_table_ptr))
+    while (!node->is_leaf)
     {
-        printf("Error: Failed to create WAL table\n");
-        free_memory(wal_table_ptr, sizeof(WALTable));
-        free_tree(tree);
-        free(table);
-        return -1;
+        int i;
+        for (i = 0; i < node->num_keys && rank >= node->counts[i]; i++)
+            rank -= node->counts[i];
+        node = node->children[i];
     }
 
-    // Add to tables array
-    tables[slot] = table;
+    if (rank >= node->num_keys)
+        return false;
 
-    printf("Table '%s' created with ID %d\n", name, table->table_id);
-    return table->table_id;
+    *key = node->keys[rank];
+    return true;
 }
 
-// Open an existing table
-Table *db_open_table(const char *name)
+// Encode an int key so that byte order matches numeric order
+static void encode_int_key(int key, unsigned char out[4])
 {
-    if (!is_initialized)
-    {
-        printf("Error: Database not initialized\n");
-        return NULL;
-    }
+    uint32_t u = (uint32_t)key ^ 0x80000000u;
+    out[0] = (unsigned char)(u >> 24);
+    out[1] = (unsigned char)(u >> 16);
+    out[2] = (unsigned char)(u >> 8);
+    out[3] = (unsigned char)u;
+}
+
+static int decode_int_key(const unsigned char in[4])
+{
+    uint32_t u = ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+    return (int)(u ^ 0x80000000u);
+}
 
-    for (int i = 0; i < MAX_TABLES; i++)
+// Byte form of a key for the byte-ordered indexes (ints use encode_int_key)
+static const unsigned char *key_bytes(const RowKey *rk, unsigned char buf[4], size_t *len)
+{
+    if (rk->bytes)
     {
-        if (tables[i] && strcmp(tables[i]->name, name) == 0)
-        {
-            tables[i]->is_open = true;
-            return tables[i];
-        }
+        *len = rk->len;
+        return rk->bytes;
     }
-
-    printf("Error: Table '%s' not found\n", name);
-    return NULL;
+    encode_int_key(rk->value, buf);
+    *len = 4;
+    return buf;
 }
 
-// Close a table
-void db_close_table(Table *table)
+// Row lock resource for a key of a table (partitions share their
+// table's id). Int keys lock themselves; byte strings lock a 32-bit
+// FNV-1a hash, so a collision only costs a false conflict.
+static uint64_t key_lock_id(int table_id, const RowKey *rk)
 {
-    if (table)
+    if (!rk->bytes)
+        return LOCK_ROW_ID(table_id, rk->value);
+
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < rk->len; i++)
     {
-        table->is_open = false;
-        printf("Table '%s' closed\n", table->name);
+        h ^= rk->bytes[i];
+        h *= 16777619u;
     }
+    return LOCK_ROW_ID(table_id, h);
 }
 
-// Get a row by its key
-NVRAMPtr db_get_row(Table *table, int txn_id, int key, size_t *size)
+// Partition index for an int key under range partitioning
+static int range_partition(Table *table, int key)
 {
-    if (!table || !table->is_open)
+    int lo = 0, hi = table->num_partitions - 1;
+
+    // First partition whose upper bound is above key
+    while (lo < hi)
     {
-        printf("Error: Invalid or closed table\n");
-        return NULL;
+        int mid = (lo + hi) / 2;
+        if (key < table->bounds[mid])
+            hi = mid;
+        else
+            lo = mid + 1;
     }
+    return lo;
+}
 
-    // Acquire locks
-    if (!lock_acquire(&g_lock_manager, txn_id, table->table_id, true, LOCK_SHARED))
+// Partition that holds a key (the table itself when not partitioned)
+static Table *partition_for(Table *table, const RowKey *rk)
+{
+    uint32_t h;
+
+    if (table->num_partitions == 0)
+        return table;
+
+    if (table->partition_method == PARTITION_RANGE)
+        return table->partitions[range_partition(table, rk->value)];
+
+    if (rk->bytes)
+    {
+        h = 2166136261u;
+        for (size_t i = 0; i < rk->len; i++)
+        {
+            h ^= rk->bytes[i];
+            h *= 16777619u;
+        }
+    }
+    else
+    {
+        // Murmur3 finalizer; the indexes hash the low bits on their own
+        h = (uint32_t)rk->value;
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+    }
+    return table->partitions[((uint64_t)h * table->num_partitions) >> 32];
+}
+
+// Log a row change, with the key bytes inline for byte-string keys
+static bool wal_log_row(Table *table, const RowKey *rk, NVRAMPtr data, int op, void *entry_ptr, size_t size)
+{
+    if (rk->bytes)
+        return wal_add_entry_bytes(table->wal_id, rk->bytes, rk->len, data, op, entry_ptr, size);
+    return wal_add_entry(table->wal_id, rk->value, data, op, entry_ptr, size);
+}
+
+// Writers bracket every change of a B+ Tree with these, under the write
+// latch: the version is odd while the tree is inconsistent
+static void tree_change_begin(BPTree *tree)
+{
+    __atomic_store_n(&tree->version, tree->version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void tree_change_end(BPTree *tree)
+{
+    __atomic_store_n(&tree->version, tree->version + 1, __ATOMIC_RELEASE);
+}
+
+// Version a latch-free read starts from; odd means a change is under way
+static uint64_t tree_read_begin(BPTree *tree)
+{
+    return __atomic_load_n(&tree->version, __ATOMIC_ACQUIRE);
+}
+
+// Is the tree still at the version a latch-free read started from?
+static bool tree_unchanged(BPTree *tree, uint64_t version)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&tree->version, __ATOMIC_RELAXED) == version;
+}
+
+// Look a key up without the latch. Every pointer is checked against the
+// tree version before it is followed, so the descent only ever steps
+// through a consistent tree; a node freed under it is still pool memory
+// (see mem_pool.h), and whatever was read from it fails the check. Returns
+// false, having found nothing, if writers kept getting in the way.
+// The node reads race with writers by design and are hidden from the
+// thread sanitizer; the version reads are not, so it still sees the
+// ordering they give.
+__attribute__((no_sanitize("thread")))
+static bool bptree_search_optimistic(BPTree *tree, int key, NVRAMPtr *data, size_t *size, bool *found)
+{
+    for (int attempt = 0; attempt < BP_OPTIMISTIC_TRIES; attempt++)
+    {
+        uint64_t version = tree_read_begin(tree);
+        if (version & 1)
+            continue;
+
+        BPTreeNode *node = tree->root;
+        bool consistent = tree_unchanged(tree, version);
+        while (consistent && node && !node->is_leaf)
+        {
+            // A stale count must not run off the arrays before the check
+            int n = node->num_keys;
+            n = n < 0 ? 0 : n > BP_ORDER ? BP_ORDER : n;
+            int i = 0;
+            while (i < n && key >= node->keys[i])
+                i++;
+            node = node->children[i];
+            consistent = tree_unchanged(tree, version);
+        }
+        if (!consistent)
+            continue;
+
+        int pos = -1;
+        NVRAMPtr leaf_data = NULL;
+        size_t leaf_size = 0;
+        if (node)
+        {
+            int n = node->num_keys;
+            n = n < 0 ? 0 : n > BP_ORDER - 1 ? BP_ORDER - 1 : n;
+            for (int i = 0; i < n && pos == -1; i++)
+            {
+                if (node->keys[i] == key)
+                    pos = i;
+            }
+            if (pos != -1)
+            {
+                leaf_data = node->data_ptrs[pos];
+                leaf_size = node->data_sizes[pos];
+            }
+        }
+        if (!tree_unchanged(tree, version))
+            continue;
+
+        *found = pos != -1;
+        if (*found && data)
+            *data = leaf_data;
+        if (*found && size)
+            *size = leaf_size;
+        return true;
+    }
+    return false;
+}
+
+// Look up a key in the table's index
+static bool index_lookup(Table *table, const RowKey *rk, NVRAMPtr *data, size_t *size)
+{
+    int key = rk->value;
+
+    if (table->index_type == INDEX_ART || table->index_type == INDEX_VARKEY)
+    {
+        unsigned char buf[4];
+        size_t len;
+        const unsigned char *k = key_bytes(rk, buf, &len);
+        if (table->index_type == INDEX_ART)
+            return art_search(table->art, k, len, data, size);
+        return vbt_search(table->vbt, k, len, data, size);
+    }
+
+    if (table->index_type == INDEX_CUCKOO)
+    {
+        return cuckoo_get(table->hash, key, data, size);
+    }
+
+    bool found;
+    if (bptree_search_optimistic(table->index, key, data, size, &found))
+        return found;
+
+    pthread_rwlock_rdlock(&table->index->latch);
+    BPTreeNode *leaf = find_leaf(table->index, key);
+    int pos = leaf ? find_key_in_leaf(leaf, key) : -1;
+    if (pos != -1)
+    {
+        if (data)
+            *data = leaf->data_ptrs[pos];
+        if (size)
+            *size = leaf->data_sizes[pos];
+    }
+    pthread_rwlock_unlock(&table->index->latch);
+    return pos != -1;
+}
+
+// Add a new key to the table's index
+static bool index_insert(Table *table, const RowKey *rk, NVRAMPtr data, size_t size)
+{
+    if (table->index_type == INDEX_ART || table->index_type == INDEX_VARKEY)
+    {
+        unsigned char buf[4];
+        size_t len;
+        const unsigned char *k = key_bytes(rk, buf, &len);
+        if (table->index_type == INDEX_ART)
+            return art_insert(table->art, k, len, data, size);
+        return vbt_insert(table->vbt, k, len, data, size);
+    }
+
+    if (table->index_type == INDEX_CUCKOO)
+    {
+        return cuckoo_put(table->hash, rk->value, data, size);
+    }
+
+    pthread_rwlock_wrlock(&table->index->latch);
+    tree_change_begin(table->index);
+    bool result = bptree_insert(table->index, rk->value, data, size);
+    tree_change_end(table->index);
+    pthread_rwlock_unlock(&table->index->latch);
+    return result;
+}
+
+// Remove a key from the table's index. Its row is not freed: readers may
+// still be looking at it, so the caller retires it.
+static bool index_remove(Table *table, const RowKey *rk)
+{
+    NVRAMPtr data;
+    size_t size;
+
+    if (table->index_type == INDEX_ART || table->index_type == INDEX_VARKEY)
+    {
+        unsigned char buf[4];
+        size_t len;
+        const unsigned char *k = key_bytes(rk, buf, &len);
+        return table->index_type == INDEX_ART ? art_delete(table->art, k, len, &data, &size)
+                                              : vbt_delete(table->vbt, k, len, &data, &size);
+    }
+
+    if (table->index_type == INDEX_CUCKOO)
+    {
+        return cuckoo_delete(table->hash, rk->value, &data, &size);
+    }
+
+    pthread_rwlock_wrlock(&table->index->latch);
+    tree_change_begin(table->index);
+    bool result = false;
+    if (table->index->root != NULL)
+    {
+        // Recursive deletion
+        result = remove_recursive(table->index, table->index->root, rk->value, NULL, 0);
+    }
+    if (result)
+    {
+        // Update record count
+        table->index->record_count--;
+    }
+    tree_change_end(table->index);
+    pthread_rwlock_unlock(&table->index->latch);
+    return result;
+}
+
+static bool index_next(Table *table, int key, bool inclusive, int *next_key);
+static bool index_prev(Table *table, int key, bool inclusive, int *prev_key);
+
+// index_next / index_prev over all partitions: the nearest key any of them
+// has. Range partitions are ordered, so the first one with a hit wins.
+static bool partitions_step(Table *table, int key, bool inclusive, bool forward, int *found_key)
+{
+    int n = table->num_partitions;
+    bool found = false;
+
+    if (table->partition_method == PARTITION_RANGE)
+    {
+        int i = range_partition(table, key);
+        for (; i >= 0 && i < n; i += forward ? 1 : -1)
+        {
+            if (forward ? index_next(table->partitions[i], key, inclusive, found_key)
+                        : index_prev(table->partitions[i], key, inclusive, found_key))
+                return true;
+        }
+        return false;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        int k;
+        if (!(forward ? index_next(table->partitions[i], key, inclusive, &k)
+                      : index_prev(table->partitions[i], key, inclusive, &k)))
+            continue;
+        if (!found || (forward ? k < *found_key : k > *found_key))
+            *found_key = k;
+        found = true;
+    }
+    return found;
+}
+
+// Smallest key greater than key (or >= when inclusive)
+static bool index_next(Table *table, int key, bool inclusive, int *next_key)
+{
+    if (table->num_partitions > 0)
+        return partitions_step(table, key, inclusive, true, next_key);
+
+    if (table->index_type == INDEX_ART || table->index_type == INDEX_VARKEY)
+    {
+        unsigned char k[4], found[4];
+        size_t found_len;
+        bool ok;
+        encode_int_key(key, k);
+        if (table->index_type == INDEX_ART)
+            ok = art_seek(table->art, k, sizeof(k), inclusive, found, sizeof(found), &found_len);
+        else
+            ok = vbt_seek(table->vbt, k, sizeof(k), inclusive, found, sizeof(found), &found_len);
+        if (ok)
+            *next_key = decode_int_key(found);
+        return ok;
+    }
+
+    if (table->index_type == INDEX_CUCKOO)
+    {
+        // Served from a sorted view built on demand after changes
+        return cuckoo_next_key(table->hash, key, inclusive, next_key);
+    }
+
+    pthread_rwlock_rdlock(&table->index->latch);
+    bool found = bptree_next_key(table->index, key, inclusive, next_key);
+    pthread_rwlock_unlock(&table->index->latch);
+    return found;
+}
+
+// Largest key smaller than key (or <= when inclusive)
+static bool index_prev(Table *table, int key, bool inclusive, int *prev_key)
+{
+    if (table->num_partitions > 0)
+        return partitions_step(table, key, inclusive, false, prev_key);
+
+    if (table->index_type == INDEX_ART || table->index_type == INDEX_VARKEY)
+    {
+        unsigned char k[4], found[4];
+        size_t found_len;
+        bool ok;
+        encode_int_key(key, k);
+        if (table->index_type == INDEX_ART)
+            ok = art_seek_prev(table->art, k, sizeof(k), inclusive, found, sizeof(found), &found_len);
+        else
+            ok = vbt_seek_prev(table->vbt, k, sizeof(k), inclusive, found, sizeof(found), &found_len);
+        if (ok)
+            *prev_key = decode_int_key(found);
+        return ok;
+    }
+
+    if (table->index_type == INDEX_CUCKOO)
+    {
+        return cuckoo_prev_key(table->hash, key, inclusive, prev_key);
+    }
+
+    pthread_rwlock_rdlock(&table->index->latch);
+    bool found = bptree_prev_key(table->index, key, inclusive, prev_key);
+    pthread_rwlock_unlock(&table->index->latch);
+    return found;
+}
+
+// Same as index_next, but -1 if none (the db_get_next_row convention)
+static int index_next_key(Table *table, int key, bool inclusive)
+{
+    int next_key;
+    if (!index_next(table, key, inclusive, &next_key))
+        return -1;
+    return next_key;
+}
+
+// Row-version state of a transaction, NULL if the slot has moved on
+static TxnState *txn_state(int txn_id)
+{
+    if (txn_id <= 0 || !txn_states)
+        return NULL;
+
+    TxnState *st = &txn_states[txn_id & (TXN_SLOTS - 1)];
+    return __atomic_load_n(&st->id, __ATOMIC_ACQUIRE) == txn_id ? st : NULL;
+}
+
+// Slot of a running read-only transaction, NULL if it has ended
+static ReadonlySlot *readonly_slot(int txn_id)
+{
+    if (txn_id < TXN_ID_LIMIT || !readonly_slots)
+        return NULL;
+
+    ReadonlySlot *rs = &readonly_slots[txn_id & (READONLY_SLOTS - 1)];
+    return __atomic_load_n(&rs->id, __ATOMIC_ACQUIRE) == txn_id ? rs : NULL;
+}
+
+// Snapshot of a running transaction; false if txn_id is not running
+static bool txn_snapshot(int txn_id, uint64_t *snapshot)
+{
+    if (txn_id >= TXN_ID_LIMIT)
+    {
+        ReadonlySlot *rs = readonly_slot(txn_id);
+        if (!rs)
+            return false;
+        *snapshot = __atomic_load_n(&rs->snapshot, __ATOMIC_SEQ_CST);
+        return *snapshot != TS_INFINITY;
+    }
+
+    if (!txn_state(txn_id))
+        return false;
+    *snapshot = __atomic_load_n(&snapshots[txn_id & (TXN_SLOTS - 1)], __ATOMIC_SEQ_CST);
+    return *snapshot != TS_INFINITY;
+}
+
+// Has the event stamped in *field (a begin_ts or end_ts) happened as far
+// as this snapshot of txn_id can tell? An in-flight stamp is resolved
+// through its writer's state; the writer restamps the field before
+// giving up its slot, so a changed field means look again.
+static bool ts_visible(uint64_t *field, int txn_id, uint64_t snapshot)
+{
+    uint64_t ts = __atomic_load_n(field, __ATOMIC_SEQ_CST);
+
+    for (;;)
+    {
+        if (ts == TS_INFINITY)
+            return false;
+        if (!(ts & TS_TXN))
+            return ts <= snapshot;
+
+        int owner = (int)(ts & ~TS_TXN);
+        if (owner == txn_id)
+            return true;
+
+        TxnState *st = &txn_states[owner & (TXN_SLOTS - 1)];
+        int id = __atomic_load_n(&st->id, __ATOMIC_SEQ_CST);
+        uint64_t commit_ts = __atomic_load_n(&st->commit_ts, __ATOMIC_SEQ_CST);
+        uint64_t again = __atomic_load_n(field, __ATOMIC_SEQ_CST);
+        if (again != ts)
+        {
+            ts = again;
+            continue;
+        }
+        if (id != owner)
+            return false; // Finished without restamping it: rolled back
+        if (commit_ts == TS_COMMITTING)
+            continue;     // Its timestamp is a few instructions away
+        if (commit_ts == 0 || commit_ts == TS_ABORTED)
+            return false;
+        return commit_ts <= snapshot;
+    }
+}
+
+// Version of a row this snapshot sees, NULL if none (or it is deleted)
+static RowVersion *visible_version(RowHead *head, int txn_id, uint64_t snapshot)
+{
+    RowVersion *v = __atomic_load_n(&head->latest, __ATOMIC_ACQUIRE);
+
+    for (; v; v = __atomic_load_n(&v->older, __ATOMIC_ACQUIRE))
+    {
+        if (ts_visible(&v->begin_ts, txn_id, snapshot))
+            return ts_visible(&v->end_ts, txn_id, snapshot) ? NULL : v;
+    }
+    return NULL;
+}
+
+// Does this snapshot see a row under the key?
+static bool row_visible(Table *part, const RowKey *rk, int txn_id, uint64_t snapshot)
+{
+    NVRAMPtr head;
+    return index_lookup(part, rk, &head, NULL) && visible_version((RowHead *)head, txn_id, snapshot);
+}
+
+// For writers holding the row lock: is the newest version not deleted?
+static bool version_live(RowVersion *v)
+{
+    return v && __atomic_load_n(&v->end_ts, __ATOMIC_ACQUIRE) == TS_INFINITY;
+}
+
+// For writers holding the row lock: did a transaction that committed
+// after our snapshot create or delete the newest version? The write then
+// fails (first updater wins); otherwise a read-modify-write would replace
+// a change it never saw.
+static bool write_conflict(RowVersion *latest, int txn_id, uint64_t snapshot)
+{
+    if (!latest)
+        return false;
+    if (!ts_visible(&latest->begin_ts, txn_id, snapshot))
+        return true;
+    return __atomic_load_n(&latest->end_ts, __ATOMIC_ACQUIRE) != TS_INFINITY &&
+           !ts_visible(&latest->end_ts, txn_id, snapshot);
+}
+
+static RowChange *row_change_new(Table *part, const RowKey *rk, RowVersion *version, bool is_delete)
+{
+    size_t key_len = rk->bytes ? rk->len : 0;
+    RowChange *rc = (RowChange *)malloc(sizeof(RowChange) + key_len);
+    if (!rc)
+        return NULL;
+
+    rc->next = NULL;
+    rc->part = part;
+    rc->head = NULL;
+    rc->version = version;
+    rc->is_delete = is_delete;
+    rc->commit_ts = 0;
+    rc->key = rk->value;
+    rc->byte_key = rk->bytes != NULL;
+    rc->key_len = key_len;
+    if (key_len > 0)
+        memcpy(rc->key_bytes, rk->bytes, key_len);
+    return rc;
+}
+
+static RowKey change_key(RowChange *rc)
+{
+    RowKey rk = {rc->key, rc->byte_key ? rc->key_bytes : NULL, rc->key_len};
+    return rk;
+}
+
+// Queue NVRAM that was just unlinked; stamping it with the clock read
+// after the unlink is what lets gc_collect tell who may still see it
+static void retire(Garbage **list, void *ptr, size_t size)
+{
+    Garbage *g = (Garbage *)malloc(sizeof(Garbage));
+    if (!g)
+        return; // Leaks the NVRAM rather than risk a reader's view
+
+    g->ptr = ptr;
+    g->size = size;
+    g->unlinked_ts = __atomic_load_n(&commit_clock, __ATOMIC_SEQ_CST);
+    g->next = *list;
+    *list = g;
+}
+
+static void retire_versions(Garbage **list, RowVersion *v)
+{
+    while (v)
+    {
+        RowVersion *older = v->older;
+        retire(list, v, v->alloc_size);
+        v = older;
+    }
+}
+
+// Move a private garbage list onto the shared one
+static void publish_garbage(Garbage *list)
+{
+    if (!list)
+        return;
+
+    Garbage *tail = list;
+    int count = 1;
+    while (tail->next)
+    {
+        tail = tail->next;
+        count++;
+    }
+
+    pthread_mutex_lock(&gc_mutex);
+    tail->next = gc_unlinked;
+    gc_unlinked = list;
+    __atomic_add_fetch(&gc_unlinked_count, count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&gc_mutex);
+}
+
+// Oldest snapshot a running transaction may read at. *idle is set when
+// none runs: a transaction that starts later reads the clock after this
+// and looks up rows after anything already unlinked.
+static uint64_t gc_horizon(bool *idle)
+{
+    uint64_t horizon = __atomic_load_n(&commit_clock, __ATOMIC_SEQ_CST);
+    bool readers = false;
+
+    int high = __atomic_load_n(&readonly_high, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < high; i++)
+    {
+        uint64_t s = __atomic_load_n(&readonly_slots[i].snapshot, __ATOMIC_SEQ_CST);
+        if (s == TS_INFINITY)
+            continue;
+        readers = true;
+        if (s < horizon)
+            horizon = s;
+    }
+
+    bool writers = __atomic_load_n(&active_snapshots, __ATOMIC_SEQ_CST) != 0;
+    *idle = !writers && !readers;
+    if (!writers)
+        return horizon;
+
+    for (int i = 0; i < TXN_SLOTS; i++)
+    {
+        uint64_t s = __atomic_load_n(&snapshots[i], __ATOMIC_SEQ_CST);
+        if (s < horizon)
+            horizon = s;
+    }
+    return horizon;
+}
+
+static bool committed_by(uint64_t ts, uint64_t horizon)
+{
+    return !(ts & TS_TXN) && ts <= horizon;
+}
+
+// Reclaim what every snapshot at or after horizon no longer needs under a
+// deleted key. False if the row is locked (try again next pass).
+static bool gc_prune(RowChange *rc, uint64_t horizon, int gc_txn, Garbage **unlinked)
+{
+    RowKey rk = change_key(rc);
+    uint64_t lock_id = key_lock_id(rc->part->table_id, &rk);
+    NVRAMPtr head_ptr;
+
+    // Writers change a chain only under the row lock. The collector runs
+    // inside other transactions' commits and never waits for a lock (under
+    // any deadlock policy): a held row is left for the next pass.
+    if (!lock_acquire(&g_lock_manager, gc_txn, rc->part->table_id, true, LOCK_INTENTION_EXCLUSIVE) ||
+        !lock_acquire(&g_lock_manager, gc_txn, lock_id, false, LOCK_EXCLUSIVE))
+        return false;
+
+    if (index_lookup(rc->part, &rk, &head_ptr, NULL))
+    {
+        RowHead *head = (RowHead *)head_ptr;
+
+        // Every snapshot sees this version or a newer one, so the ones
+        // below it are dead
+        RowVersion *v = head->latest;
+        while (v && !committed_by(v->begin_ts, horizon))
+            v = v->older;
+
+        if (v)
+        {
+            RowVersion *dead = v->older;
+            __atomic_store_n(&v->older, NULL, __ATOMIC_RELEASE);
+            flush_range(&v->older, sizeof(RowVersion *));
+            retire_versions(unlinked, dead);
+
+            // Deleted for every snapshot and nothing newer: drop the key
+            if (v == head->latest && committed_by(v->end_ts, horizon))
+            {
+                index_remove(rc->part, &rk);
+                retire(unlinked, head, ROW_HEAD_SIZE);
+                retire_versions(unlinked, v);
+            }
+        }
+    }
+
+    lock_release(&g_lock_manager, gc_txn, lock_id, false);
+    return true;
+}
+
+// Reclaim committed deletes every snapshot sees, then free unlinked NVRAM
+// no running transaction can reach. One thread collects at a time.
+static void gc_collect(void)
+{
+    bool idle;
+    Garbage *unlinked = NULL;
+    RowChange *keep = NULL;
+    int kept = 0;
+
+    if (pthread_mutex_trylock(&gc_run_mutex) != 0)
+        return;
+
+    uint64_t horizon = gc_horizon(&idle);
+
+    pthread_mutex_lock(&gc_mutex);
+    RowChange *pending = gc_pending;
+    gc_pending = NULL;
+    __atomic_store_n(&gc_pending_count, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&gc_mutex);
+
+    int gc_txn = pending ? transaction_begin(&g_lock_manager) : -1;
+    if (gc_txn > 0)
+        transaction_set_no_wait(&g_lock_manager, gc_txn);
+    while (pending)
+    {
+        RowChange *rc = pending;
+        pending = rc->next;
+        if (gc_txn > 0 && rc->commit_ts <= horizon && gc_prune(rc, horizon, gc_txn, &unlinked))
+        {
+            free(rc);
+            continue;
+        }
+        rc->next = keep;
+        keep = rc;
+        kept++;
+    }
+    if (gc_txn > 0)
+        transaction_commit(&g_lock_manager, gc_txn);
+
+    publish_garbage(unlinked);
+
+    pthread_mutex_lock(&gc_mutex);
+    while (keep)
+    {
+        RowChange *rc = keep;
+        keep = rc->next;
+        rc->next = gc_pending;
+        gc_pending = rc;
+    }
+    __atomic_add_fetch(&gc_pending_count, kept, __ATOMIC_RELAXED);
+    Garbage *all = gc_unlinked;
+    gc_unlinked = NULL;
+    __atomic_store_n(&gc_unlinked_count, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&gc_mutex);
+
+    // Anything unlinked before the oldest snapshot was taken is out of reach
+    horizon = gc_horizon(&idle);
+    Garbage *still = NULL;
+    while (all)
+    {
+        Garbage *g = all;
+        all = g->next;
+        if (idle || g->unlinked_ts < horizon)
+        {
+            free_memory(g->ptr, g->size);
+            free(g);
+        }
+        else
+        {
+            g->next = still;
+            still = g;
+        }
+    }
+    publish_garbage(still);
+
+    pthread_mutex_unlock(&gc_run_mutex);
+}
+
+// Collect once a batch has built up, or whenever nothing is running (so
+// a single-threaded caller sees its deletes reclaimed at commit)
+static void gc_maybe_collect(void)
+{
+    int pending = __atomic_load_n(&gc_pending_count, __ATOMIC_RELAXED);
+    int unlinked = __atomic_load_n(&gc_unlinked_count, __ATOMIC_RELAXED);
+
+    if (pending >= GC_BATCH || unlinked >= GC_BATCH ||
+        ((pending > 0 || unlinked > 0) && __atomic_load_n(&active_snapshots, __ATOMIC_RELAXED) == 0))
+        gc_collect();
+}
+
+// Forget a transaction's snapshot once it has finished
+static void snapshot_release(int txn_id)
+{
+    __atomic_store_n(&snapshots[txn_id & (TXN_SLOTS - 1)], TS_INFINITY, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&active_snapshots, 1, __ATOMIC_SEQ_CST);
+}
+
+// Commit work and cleanup of the buffered modes, defined with the row
+// operations
+static bool occ_install(int txn_id, TxnState *st, uint64_t snapshot);
+static bool install_writes(int txn_id, TxnState *st);
+static void pending_discard(TxnState *st);
+
+// Free a table's indexes and partitions (NVRAM row data is not freed)
+static void destroy_table(Table *table)
+{
+    if (!table)
+        return;
+
+    for (int i = 0; i < table->num_partitions; i++)
+        destroy_table(table->partitions[i]);
+    free(table->partitions);
+    free(table->bounds);
+
+    // We would need to traverse all leaves and free NVRAM data
+    // For brevity, this code is omitted
+    free_tree(table->index);
+    art_destroy(table->art);
+    cuckoo_destroy(table->hash);
+    vbt_destroy(table->vbt);
+    free(table);
+}
+
+// Initialize database system
+void db_init()
+{
+    if (is_initialized)
+        return;
+
+    // Initialize NVRAM free space manager
+    init_free_space();
+
+    // Initialize lock manager
+    lock_manager_init(&g_lock_manager);
+
+    // Row-version state, one entry per transaction slot
+    txn_states = (TxnState *)aligned_alloc(64, sizeof(TxnState) * TXN_SLOTS);
+    memset(txn_states, 0, sizeof(TxnState) * TXN_SLOTS);
+    snapshots = (uint64_t *)malloc(sizeof(uint64_t) * TXN_SLOTS);
+    for (int i = 0; i < TXN_SLOTS; i++)
+        snapshots[i] = TS_INFINITY;
+    commit_clock = 0;
+    active_snapshots = 0;
+    readonly_slots = (ReadonlySlot *)aligned_alloc(64, sizeof(ReadonlySlot) * READONLY_SLOTS);
+    memset(readonly_slots, 0, sizeof(ReadonlySlot) * READONLY_SLOTS);
+    for (int i = 0; i < READONLY_SLOTS; i++)
+        readonly_slots[i].snapshot = TS_INFINITY;
+    readonly_high = 0;
+
+    // Initialize the B+ Tree node pool (huge pages if the system has them)
+    mem_pool_init(&node_pool, "bptree_node", sizeof(BPTreeNode), true);
+    art_module_init();
+    vbt_module_init();
+
+    // Initialize the table catalog
+    catalog_names = catalog_names_create(CATALOG_INITIAL_SLOTS);
+    table_count = 0;
+    next_table_id = 0;
+    next_wal_id = 0;
+
+    is_initialized = true;
+    printf("Database system initialized\n");
+}
+
+// Shutdown database system
+void db_shutdown()
+{
+    if (!is_initialized)
+        return;
+
+    // Close and free all tables
+    for (int i = 0; i < next_table_id; i++)
+        destroy_table(catalog_get(i));
+    for (int i = 0; i < CATALOG_ID_CHUNKS; i++)
+    {
+        free(catalog_ids[i]);
+        catalog_ids[i] = NULL;
+    }
+    while (catalog_names)
+    {
+        CatalogNames *retired = catalog_names->retired;
+        free(catalog_names);
+        catalog_names = retired;
+    }
+
+    // Forget the WAL streams (they lived in NVRAM)
+    wal_shutdown();
+
+    // Drop version bookkeeping; the NVRAM it points at goes with the mapping
+    for (int i = 0; i < TXN_SLOTS; i++)
+    {
+        if (snapshots[i] == TS_INFINITY)
+            continue;
+        while (txn_states[i].changes)
+        {
+            RowChange *rc = txn_states[i].changes;
+            txn_states[i].changes = rc->next;
+            free(rc);
+        }
+        pending_discard(&txn_states[i]);
+    }
+    while (gc_pending)
+    {
+        RowChange *rc = gc_pending;
+        gc_pending = rc->next;
+        free(rc);
+    }
+    while (gc_unlinked)
+    {
+        Garbage *g = gc_unlinked;
+        gc_unlinked = g->next;
+        free(g);
+    }
+    gc_pending_count = 0;
+    gc_unlinked_count = 0;
+    free(txn_states);
+    txn_states = NULL;
+    free(snapshots);
+    snapshots = NULL;
+    free(readonly_slots);
+    readonly_slots = NULL;
+
+    // Clean up NVRAM
+    cleanup_free_space();
+
+    // Clean up lock manager
+    lock_manager_cleanup(&g_lock_manager);
+
+    // Release all node arenas
+    mem_pool_destroy(&node_pool);
+    art_module_shutdown();
+    vbt_module_shutdown();
+
+    is_initialized = false;
+    printf("Database system shut down\n");
+}
+
+// Begin a transaction
+int db_begin_transaction()
+{
+    return db_begin_transaction_mode(TXN_LOCKING);
+}
+
+// Begin a transaction under the given concurrency control
+int db_begin_transaction_mode(TxnMode mode)
+{
+    int txn_id = transaction_begin(&g_lock_manager);
+    if (txn_id < 0)
+        return txn_id;
+
+    int slot = txn_id & (TXN_SLOTS - 1);
+    TxnState *st = &txn_states[slot];
+    st->changes = NULL;
+    st->mode = mode;
+    st->reads = NULL;
+    st->writes = NULL;
+    st->last_write = NULL;
+    st->untracked = false;
+    st->pending = NULL;
+    __atomic_store_n(&st->commit_ts, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&st->id, txn_id, __ATOMIC_SEQ_CST);
+
+    // Hold the horizon down before reading the clock: a collector that
+    // misses the 0 read the clock first, so it keeps what we will need
+    __atomic_add_fetch(&active_snapshots, 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&snapshots[slot], 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&snapshots[slot], __atomic_load_n(&commit_clock, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return txn_id;
+}
+
+// Begin a read-only transaction in a free snapshot slot
+int db_begin_readonly()
+{
+    if (!readonly_slots)
+        return -1;
+    if (readonly_hint < 0)
+        readonly_hint = __atomic_fetch_add(&readonly_next, 1, __ATOMIC_RELAXED) & (READONLY_SLOTS - 1);
+
+    for (int i = 0; i < READONLY_SLOTS; i++)
+    {
+        int slot = (readonly_hint + i) & (READONLY_SLOTS - 1);
+        ReadonlySlot *rs = &readonly_slots[slot];
+        if (__atomic_load_n(&rs->snapshot, __ATOMIC_RELAXED) != TS_INFINITY)
+            continue;
+
+        // The collector must scan the slot before it can be claimed
+        int high = __atomic_load_n(&readonly_high, __ATOMIC_SEQ_CST);
+        while (slot >= high &&
+               !__atomic_compare_exchange_n(&readonly_high, &high, slot + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            ;
+
+        // Claiming with 0 holds the horizon down before we read the
+        // clock, as in db_begin_transaction_mode
+        uint64_t expected = TS_INFINITY;
+        if (!__atomic_compare_exchange_n(&rs->snapshot, &expected, 0, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            continue;
+
+        readonly_hint = slot;
+        rs->generation++;
+        int txn_id = TXN_ID_LIMIT | (int)(rs->generation % (TXN_ID_LIMIT / READONLY_SLOTS)) * READONLY_SLOTS | slot;
+        __atomic_store_n(&rs->id, txn_id, __ATOMIC_RELEASE);
+        __atomic_store_n(&rs->snapshot, __atomic_load_n(&commit_clock, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+        return txn_id;
+    }
+    return -1;
+}
+
+// End a read-only transaction (commit and abort alike)
+static bool readonly_end(int txn_id)
+{
+    ReadonlySlot *rs = readonly_slot(txn_id);
+    if (!rs)
+        return false;
+    __atomic_store_n(&rs->id, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&rs->snapshot, TS_INFINITY, __ATOMIC_SEQ_CST);
+
+    // The snapshot may have been all that kept garbage alive
+    gc_maybe_collect();
+    return true;
+}
+
+// WAL streams a committing transaction wrote to, each listed once. If the
+// list cannot grow, every stream is advanced instead.
+typedef struct
+{
+    int *ids;
+    int count, capacity;
+    bool all;
+} WalStreams;
+
+static void wal_streams_add(WalStreams *streams, int wal_id)
+{
+    if (streams->all)
+        return;
+    for (int i = streams->count - 1; i >= 0; i--)
+    {
+        if (streams->ids[i] == wal_id)
+            return;
+    }
+    if (streams->count == streams->capacity)
+    {
+        int capacity = streams->capacity ? streams->capacity * 2 : 8;
+        int *ids = (int *)realloc(streams->ids, sizeof(int) * capacity);
+        if (!ids)
+        {
+            streams->all = true;
+            return;
+        }
+        streams->ids = ids;
+        streams->capacity = capacity;
+    }
+    streams->ids[streams->count++] = wal_id;
+}
+
+// Commit a transaction: stamp its versions with the next clock value
+// while it still holds the row locks, then release them
+bool db_commit_transaction(int txn_id)
+{
+    if (txn_id >= TXN_ID_LIMIT)
+        return readonly_end(txn_id);
+
+    uint64_t snapshot;
+    if (!txn_snapshot(txn_id, &snapshot))
+        return false;
+
+    // A buffered transaction writes only now; if an optimistic one fails
+    // validation (or either runs out of NVRAM) it rolls back whatever it
+    // had applied
+    TxnState *st = txn_state(txn_id);
+    if ((st->mode == TXN_OPTIMISTIC && !occ_install(txn_id, st, snapshot)) ||
+        (st->mode == TXN_DEFERRED && !install_writes(txn_id, st)))
+    {
+        db_abort_transaction(txn_id);
+        return false;
+    }
+    pending_discard(st);
+
+    RowChange *changes = st->changes;
+    bool wrote = changes != NULL;
+    WalStreams streams = {NULL, 0, 0, false};
+    st->changes = NULL;
+    if (wrote)
+    {
+        // Readers meeting our stamps wait out the gap between taking the
+        // timestamp and publishing it
+        __atomic_store_n(&st->commit_ts, TS_COMMITTING, __ATOMIC_SEQ_CST);
+        uint64_t commit_ts = __atomic_add_fetch(&commit_clock, 1, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&st->commit_ts, commit_ts, __ATOMIC_SEQ_CST);
+
+        RowChange *deletes = NULL;
+        int delete_count = 0;
+        while (changes)
+        {
+            RowChange *rc = changes;
+            changes = rc->next;
+            uint64_t *field = rc->is_delete ? &rc->version->end_ts : &rc->version->begin_ts;
+            __atomic_store_n(field, commit_ts, __ATOMIC_SEQ_CST);
+            flush_range(field, sizeof(uint64_t));
+            wal_streams_add(&streams, rc->part->wal_id);
+
+            if (rc->is_delete)
+            {
+                // Reclaimed once no snapshot can see the deleted version
+                rc->commit_ts = commit_ts;
+                rc->next = deletes;
+                deletes = rc;
+                delete_count++;
+            }
+            else
+            {
+                free(rc);
+            }
+        }
+
+        if (deletes)
+        {
+            pthread_mutex_lock(&gc_mutex);
+            RowChange *tail = deletes;
+            while (tail->next)
+                tail = tail->next;
+            tail->next = gc_pending;
+            gc_pending = deletes;
+            __atomic_add_fetch(&gc_pending_count, delete_count, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&gc_mutex);
+        }
+    }
+
+    bool result = transaction_commit(&g_lock_manager, txn_id);
+
+    if (result && wrote)
+    {
+        // Advance the commit pointers of the streams it wrote to
+        int count = streams.all ? next_wal_id : streams.count;
+        for (int i = 0; i < count; i++)
+            wal_advance_commit_ptr(streams.all ? i : streams.ids[i], txn_id);
+    }
+    free(streams.ids);
+
+    snapshot_release(txn_id);
+    gc_maybe_collect();
+    return result;
+}
+
+// Abort a transaction: undo its row changes, newest first, while it still
+// holds the row locks
+bool db_abort_transaction(int txn_id)
+{
+    if (txn_id >= TXN_ID_LIMIT)
+        return readonly_end(txn_id);
+
+    uint64_t snapshot;
+    if (!txn_snapshot(txn_id, &snapshot))
+        return false;
+
+    TxnState *st = txn_state(txn_id);
+    Garbage *unlinked = NULL;
+    pending_discard(st);
+    __atomic_store_n(&st->commit_ts, TS_ABORTED, __ATOMIC_SEQ_CST);
+
+    while (st->changes)
+    {
+        RowChange *rc = st->changes;
+        st->changes = rc->next;
+
+        if (rc->is_delete)
+        {
+            __atomic_store_n(&rc->version->end_ts, TS_INFINITY, __ATOMIC_SEQ_CST);
+            flush_range(&rc->version->end_ts, sizeof(uint64_t));
+        }
+        else
+        {
+            RowVersion *older = rc->version->older;
+            __atomic_store_n(&rc->head->latest, older, __ATOMIC_SEQ_CST);
+            flush_range(&rc->head->latest, sizeof(RowVersion *));
+            if (!older)
+            {
+                // The key was new: take it out of the index again
+                RowKey rk = change_key(rc);
+                index_remove(rc->part, &rk);
+                retire(&unlinked, rc->head, ROW_HEAD_SIZE);
+            }
+            retire(&unlinked, rc->version, rc->version->alloc_size);
+        }
+        free(rc);
+    }
+    publish_garbage(unlinked);
+
+    bool result = transaction_abort(&g_lock_manager, txn_id);
+    snapshot_release(txn_id);
+    gc_maybe_collect();
+    return result;
+}
+
+// Lock a whole table until the transaction ends. Writers hold IX on the
+// tables they touch, so X here waits out (or dies against) every writer
+// of the table and then lets this transaction write without row locks.
+bool db_lock_table(Table *table, int txn_id, LockMode mode)
+{
+    if (!table || !table->is_open || !txn_state(txn_id))
+        return false;
+    return lock_acquire(&g_lock_manager, txn_id, table->table_id, true, mode);
+}
+
+int db_create_table(const char *name)
+{
+    return db_create_table_with_index(name, INDEX_BPTREE);
+}
+
+// Create a new table with the given index structure
+int db_create_table_with_index(const char *name, IndexType index_type)
+{
+    return db_create_partitioned_table(name, index_type, PARTITION_NONE, 0, NULL);
+}
+
+// Allocate a table (or one partition of one) with its index and WAL stream
+static Table *create_table_storage(const char *name, int table_id, IndexType index_type)
+{
+    Table *table = (Table *)calloc(1, sizeof(Table));
+    if (!table)
+    {
+        printf("Error: Failed to allocate memory for table\n");
+        return NULL;
+    }
+
+    strncpy(table->name, name, MAX_TABLE_NAME - 1);
+    table->name[MAX_TABLE_NAME - 1] = '\0';
+    table->table_id = table_id;
+    table->index_type = index_type;
+    table->partition_method = PARTITION_NONE;
+    table->is_open = true;
+
+    // Create the index
+    if (index_type == INDEX_ART)
+        table->art = art_create();
+    else if (index_type == INDEX_VARKEY)
+        table->vbt = vbt_create();
+    else if (index_type == INDEX_CUCKOO)
+        table->hash = cuckoo_create(CUCKOO_INITIAL_CAPACITY);
+    else
+        table->index = create_tree();
+
+    if (!table->index && !table->art && !table->hash && !table->vbt)
+    {
+        printf("Error: Failed to create index for table\n");
+        free(table);
+        return NULL;
+    }
+
+    // Create WAL table in NVRAM
+    void *wal_table_ptr = allocate_memory(sizeof(WALTable));
+    if (!wal_table_ptr)
+    {
+        printf("Error: Failed to allocate NVRAM for WAL table\n");
+        destroy_table(table);
+        return NULL;
+    }
+
+    // Initialize WAL table
+    if (!wal_create_table(next_wal_id, wal_table_ptr))
+    {
+        printf("Error: Failed to create WAL table\n");
+        free_memory(wal_table_ptr, sizeof(WALTable));
+        destroy_table(table);
+        return NULL;
+    }
+    table->wal_id = next_wal_id++;
+
+    return table;
+}
+
+static int create_table_locked(const char *name, IndexType index_type, PartitionMethod method,
+                               int num_partitions, const int *bounds);
+
+// Create a table whose keys are spread over num_partitions sub-tables
+int db_create_partitioned_table(const char *name, IndexType index_type, PartitionMethod method,
+                                int num_partitions, const int *bounds)
+{
+    if (!is_initialized)
+    {
+        printf("Error: Database not initialized\n");
+        return -1;
+    }
+
+    if (method != PARTITION_NONE && (num_partitions < 1 || num_partitions > MAX_PARTITIONS))
+    {
+        printf("Error: A table takes 1 to %d partitions\n", MAX_PARTITIONS);
+        return -1;
+    }
+
+    if (method == PARTITION_RANGE)
+    {
+        // Byte-string keys have no int to compare with the bounds
+        if (index_type == INDEX_ART || index_type == INDEX_VARKEY)
+        {
+            printf("Error: Range partitioning needs an int-keyed index\n");
+            return -1;
+        }
+        for (int i = 0; i < num_partitions - 1; i++)
+        {
+            if (!bounds || (i > 0 && bounds[i] <= bounds[i - 1]))
+            {
+                printf("Error: Partition bounds must be increasing\n");
+                return -1;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&catalog_mutex);
+    int table_id = create_table_locked(name, index_type, method, num_partitions, bounds);
+    pthread_mutex_unlock(&catalog_mutex);
+    return table_id;
+}
+
+// Build and publish a table (caller holds catalog_mutex)
+static int create_table_locked(const char *name, IndexType index_type, PartitionMethod method,
+                               int num_partitions, const int *bounds)
+{
+    // Check if table with same name already exists
+    if (catalog_find(name))
+    {
+        printf("Error: Table '%s' already exists\n", name);
+        return -1;
+    }
+
+    Table *table;
+    if (method == PARTITION_NONE)
+    {
+        table = create_table_storage(name, next_table_id, index_type);
+        if (!table)
+            return -1;
+    }
+    else
+    {
+        // The parent only routes; rows live in the partitions
+        table = (Table *)calloc(1, sizeof(Table));
+        if (!table)
+        {
+            printf("Error: Failed to allocate memory for table\n");
+            return -1;
+        }
+        strncpy(table->name, name, MAX_TABLE_NAME - 1);
+        table->name[MAX_TABLE_NAME - 1] = '\0';
+        table->table_id = next_table_id;
+        table->index_type = index_type;
+        table->wal_id = -1;
+        table->partition_method = method;
+        table->is_open = true;
+
+        table->partitions = (Table **)calloc(num_partitions, sizeof(Table *));
+        table->bounds = (int *)malloc(sizeof(int) * num_partitions);
+        if (!table->partitions || !table->bounds)
+        {
+            printf("Error: Failed to allocate memory for partitions\n");
+            destroy_table(table);
+            return -1;
+        }
+        if (method == PARTITION_RANGE)
+            memcpy(table->bounds, bounds, sizeof(int) * (num_partitions - 1));
+
+        // Partitions share the table id, so table locks cover all of them
+        for (int i = 0; i < num_partitions; i++)
+        {
+            // Room for "#" and any int after the (cut) parent name
+            char part_name[MAX_TABLE_NAME];
+            snprintf(part_name, sizeof(part_name), "%.*s#%d", MAX_TABLE_NAME - 12, name, i);
+            table->partitions[i] = create_table_storage(part_name, table->table_id, index_type);
+            if (!table->partitions[i])
+            {
+                destroy_table(table);
+                return -1;
+            }
+            table->num_partitions++;
+        }
+    }
+
+    // Publish it to lock-free readers
+    if (!catalog_add(table))
+    {
+        destroy_table(table);
+        return -1;
+    }
+    next_table_id++;
+
+    if (method == PARTITION_NONE)
+        printf("Table '%s' created with ID %d\n", name, table->table_id);
+    else
+        printf("Table '%s' created with ID %d (%d %s partitions)\n", name, table->table_id,
+               num_partitions, method == PARTITION_HASH ? "hash" : "range");
+    return table->table_id;
+}
+
+// Open an existing table
+Table *db_open_table(const char *name)
+{
+    if (!is_initialized)
+    {
+        printf("Error: Database not initialized\n");
+        return NULL;
+    }
+
+    Table *table = catalog_find(name);
+    if (!table)
+    {
+        printf("Error: Table '%s' not found\n", name);
+        return NULL;
+    }
+
+    // Avoid dirtying the shared cache line on every call
+    if (!table->is_open)
+        table->is_open = true;
+    return table;
+}
+
+// Open an existing table by the id db_create_table returned
+Table *db_open_table_by_id(int table_id)
+{
+    if (!is_initialized)
+    {
+        printf("Error: Database not initialized\n");
+        return NULL;
+    }
+
+    Table *table = catalog_get(table_id);
+    if (!table)
+    {
+        printf("Error: Table %d not found\n", table_id);
+        return NULL;
+    }
+
+    if (!table->is_open)
+        table->is_open = true;
+    return table;
+}
+
+// Close a table
+void db_close_table(Table *table)
+{
+    if (table)
+    {
+        table->is_open = false;
+        printf("Table '%s' closed\n", table->name);
+    }
+}
+
+// Optimistic transactions. They read their snapshot like any other
+// transaction but remember each row they read, and keep their writes in
+// DRAM. At commit they lock the rows they write, check that every row
+// they read still has the version they saw as its newest, and only then
+// apply the writes.
+
+static bool key_matches(const RowKey *rk, int key, bool byte_key, size_t key_len, const unsigned char *key_bytes)
+{
+    if (rk->bytes)
+        return byte_key && key_len == rk->len && memcmp(key_bytes, rk->bytes, key_len) == 0;
+    return !byte_key && key == rk->value;
+}
+
+static size_t pending_slot(PendingIndex *index, uint64_t lock_id)
+{
+    uint64_t h = lock_id * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(h >> 32) & index->mask;
+}
+
+static uint64_t pending_key_lock_id(const PendingKey *k)
+{
+    return k->write ? k->write->lock_id : k->read->lock_id;
+}
+
+static bool pending_key_matches(const PendingKey *k, Table *table, const RowKey *rk)
+{
+    if (k->write)
+        return k->write->table == table &&
+               key_matches(rk, k->write->key, k->write->byte_key, k->write->key_len, k->write->key_bytes);
+    return k->read->table_id == table->table_id &&
+           key_matches(rk, k->read->key, k->read->byte_key, k->read->key_len, k->read->key_bytes);
+}
+
+// Slot of a key in the transaction's index. NULL if it has none, unless
+// add is set: then an empty one is made for it (NULL if out of memory).
+static PendingKey *pending_lookup(TxnState *st, Table *table, const RowKey *rk, bool add)
+{
+    PendingIndex *index = st->pending;
+    if (!index && !add)
+        return NULL;
+
+    if (add && (!index || (index->count + 1) * 2 > index->mask + 1))
+    {
+        size_t slots = index ? (index->mask + 1) * 2 : 64;
+        PendingIndex *grown = (PendingIndex *)calloc(1, sizeof(PendingIndex) + sizeof(PendingKey) * slots);
+        if (!grown)
+            return NULL;
+        grown->mask = slots - 1;
+        for (size_t i = 0; index && i <= index->mask; i++)
+        {
+            PendingKey *old = &index->slots[i];
+            if (!old->write && !old->read)
+                continue;
+            size_t j = pending_slot(grown, pending_key_lock_id(old));
+            while (grown->slots[j].write || grown->slots[j].read)
+                j = (j + 1) & grown->mask;
+            grown->slots[j] = *old;
+        }
+        grown->count = index ? index->count : 0;
+        free(index);
+        st->pending = index = grown;
+    }
+
+    uint64_t lock_id = key_lock_id(table->table_id, rk);
+    for (size_t i = pending_slot(index, lock_id);; i = (i + 1) & index->mask)
+    {
+        PendingKey *k = &index->slots[i];
+        if (!k->write && !k->read)
+        {
+            if (!add)
+                return NULL;
+            index->count++;
+            return k;
+        }
+        if (pending_key_lock_id(k) == lock_id && pending_key_matches(k, table, rk))
+            return k;
+    }
+}
+
+// Newest buffered write of a key, NULL if none
+static PendingWrite *pending_find(TxnState *st, Table *table, const RowKey *rk)
+{
+    PendingKey *k = pending_lookup(st, table, rk, false);
+    return k ? k->write : NULL;
+}
+
+// Make w the newest write of its key
+static bool pending_index_add(TxnState *st, PendingWrite *w)
+{
+    RowKey rk = {w->key, w->byte_key ? w->key_bytes : NULL, w->key_len};
+    PendingKey *k = pending_lookup(st, w->table, &rk, true);
+    if (!k)
+        return false;
+    k->write = w;
+    return true;
+}
+
+// Read a key at the snapshot and remember what was seen. A key already
+// read keeps its one entry: the snapshot still sees the same version.
+static RowVersion *read_tracked(Table *table, TxnState *st, int txn_id, uint64_t snapshot, const RowKey *rk)
+{
+    PendingKey *k = pending_lookup(st, table, rk, true);
+    if (k && k->read)
+        return k->read->version;
+
+    Table *part = partition_for(table, rk);
+    NVRAMPtr head;
+    RowVersion *version = NULL;
+    if (index_lookup(part, rk, &head, NULL))
+        version = visible_version((RowHead *)head, txn_id, snapshot);
+
+    size_t key_len = rk->bytes ? rk->len : 0;
+    RowRead *r = (RowRead *)malloc(sizeof(RowRead) + key_len);
+    if (!k || !r)
+    {
+        printf("Error: Failed to allocate memory for read set\n");
+        st->untracked = true;
+        if (k && !k->write)
+            st->pending->count--; // Give the empty slot back
+        free(r);
+        return version;
+    }
+    r->part = part;
+    r->table_id = table->table_id;
+    r->lock_id = key_lock_id(table->table_id, rk);
+    r->version = version;
+    r->key = rk->value;
+    r->byte_key = rk->bytes != NULL;
+    r->key_len = key_len;
+    if (key_len > 0)
+        memcpy(r->key_bytes, rk->bytes, key_len);
+    r->next = st->reads;
+    st->reads = r;
+    k->read = r;
+    return version;
+}
+
+// Does the row still look the way the read saw it: the same newest
+// version and still live, or (if it saw none) still no live version?
+// And is no other committer about to change it? A row X-locked by
+// another transaction (or under its table X lock) may be replaced the
+// moment we finish checking, so it fails too: two transactions that
+// each read a row the other writes lock their writes before validating,
+// so at least one of them sees the other's lock or its new version, and
+// write skew can't slip through.
+static bool read_still_valid(RowRead *r, int txn_id, uint64_t snapshot)
+{
+    if (lock_conflict_held(&g_lock_manager, txn_id, r->table_id, true, LOCK_INTENTION_SHARED) ||
+        lock_conflict_held(&g_lock_manager, txn_id, r->lock_id, false, LOCK_SHARED))
+        return false;
+
+    RowKey rk = {r->key, r->byte_key ? r->key_bytes : NULL, r->key_len};
+    NVRAMPtr head;
+    RowVersion *latest = NULL;
+    if (index_lookup(r->part, &rk, &head, NULL))
+        latest = __atomic_load_n(&((RowHead *)head)->latest, __ATOMIC_ACQUIRE);
+
+    if (r->version)
+        return latest == r->version && version_live(latest);
+    return !latest || committed_by(__atomic_load_n(&latest->end_ts, __ATOMIC_ACQUIRE), snapshot);
+}
+
+// Row a buffered transaction sees: its own pending write, or its snapshot
+// (recorded for validation if optimistic)
+static NVRAMPtr buffered_get(Table *table, TxnState *st, int txn_id, uint64_t snapshot, const RowKey *rk, size_t *size)
+{
+    PendingWrite *w = pending_find(st, table, rk);
+    if (w)
+    {
+        if (w->is_delete)
+            return NULL;
+        if (size)
+            *size = w->size;
+        return w->data;
+    }
+
+    RowVersion *version;
+    if (st->mode == TXN_OPTIMISTIC)
+    {
+        version = read_tracked(table, st, txn_id, snapshot, rk);
+    }
+    else
+    {
+        NVRAMPtr head;
+        if (!index_lookup(partition_for(table, rk), rk, &head, NULL))
+            return NULL;
+        version = visible_version((RowHead *)head, txn_id, snapshot);
+    }
+    if (!version)
+        return NULL;
+    if (size)
+        *size = version->size;
+    return version->data;
+}
+
+// Newest version of a row (what a locked writer checks against)
+static RowVersion *latest_version(Table *table, const RowKey *rk)
+{
+    NVRAMPtr head;
+    RowVersion *latest = NULL;
+    if (index_lookup(partition_for(table, rk), rk, &head, NULL))
+        latest = __atomic_load_n(&((RowHead *)head)->latest, __ATOMIC_ACQUIRE);
+    return latest;
+}
+
+// Queue a buffered insert or delete. An optimistic one is checked against
+// what the transaction sees now and the commit re-checks the row; a
+// deferred one already holds the row lock, so the newest version stays
+// what it checks against.
+static bool buffer_write(Table *table, TxnState *st, int txn_id, const RowKey *rk, void *data, size_t size, bool is_delete)
+{
+    uint64_t snapshot;
+    if (!txn_snapshot(txn_id, &snapshot))
+        return false;
+
+    PendingWrite *prev = pending_find(st, table, rk);
+    bool exists;
+    if (prev)
+        exists = !prev->is_delete;
+    else if (st->mode == TXN_OPTIMISTIC)
+        exists = read_tracked(table, st, txn_id, snapshot, rk) != NULL;
+    else
+    {
+        RowVersion *latest = latest_version(table, rk);
+        if (write_conflict(latest, txn_id, snapshot))
+        {
+            printf("Error: Row changed since the transaction's snapshot\n");
+            return false;
+        }
+        exists = version_live(latest);
+    }
+    if (is_delete && !exists)
+    {
+        printf("Error: Row to delete not found\n");
+        return false;
+    }
+    if (!is_delete && exists)
+        return false; // Row already exists
+
+    size_t key_len = rk->bytes ? rk->len : 0;
+    PendingWrite *w = (PendingWrite *)malloc(sizeof(PendingWrite) + key_len + size);
+    if (!w)
+    {
+        printf("Error: Failed to allocate memory for row change\n");
+        return false;
+    }
+    w->next = NULL;
+    w->older = prev;
+    w->table = table;
+    w->lock_id = key_lock_id(table->table_id, rk);
+    w->is_delete = is_delete;
+    w->superseded = false;
+    w->key = rk->value;
+    w->byte_key = rk->bytes != NULL;
+    w->key_len = key_len;
+    if (key_len > 0)
+        memcpy(w->key_bytes, rk->bytes, key_len);
+    w->data = w->key_bytes + key_len;
+    w->size = size;
+    if (size > 0)
+        memcpy(w->data, data, size);
+    if (!pending_index_add(st, w))
+    {
+        printf("Error: Failed to allocate memory for row change\n");
+        free(w);
+        return false;
+    }
+    if (prev)
+        prev->superseded = true;
+
+    if (st->last_write)
+        st->last_write->next = w;
+    else
+        st->writes = w;
+    st->last_write = w;
+    return true;
+}
+
+// Drop a buffered transaction's read and write sets
+static void pending_discard(TxnState *st)
+{
+    while (st->reads)
+    {
+        RowRead *r = st->reads;
+        st->reads = r->next;
+        free(r);
+    }
+    while (st->writes)
+    {
+        PendingWrite *w = st->writes;
+        st->writes = w->next;
+        free(w);
+    }
+    st->last_write = NULL;
+    free(st->pending);
+    st->pending = NULL;
+}
+
+// Get a row by its key, as of the transaction's snapshot. Reads take no
+// locks: writers never change a version a snapshot can see.
+static NVRAMPtr row_get(Table *table, int txn_id, const RowKey *rk, size_t *size)
+{
+    if (!table || !table->is_open)
+    {
+        printf("Error: Invalid or closed table\n");
+        return NULL;
+    }
+
+    uint64_t snapshot;
+    if (!txn_snapshot(txn_id, &snapshot))
     {
-        printf("Error: Could not acquire table lock\n");
+        printf("Error: Transaction %d is not running\n", txn_id);
+        return NULL;
+    }
+
+    // Read-only transactions have no state and nothing buffered
+    TxnState *st = txn_state(txn_id);
+    if (st && st->mode != TXN_LOCKING)
+        return buffered_get(table, st, txn_id, snapshot, rk, size);
+
+    // Find key in the index, then the version our snapshot sees
+    NVRAMPtr head;
+    if (!index_lookup(partition_for(table, rk), rk, &head, NULL))
         return NULL;
+    RowVersion *version = visible_version((RowHead *)head, txn_id, snapshot);
+    if (!version)
+        return NULL;
+
+    // Return data pointer and size
+    if (size)
+        *size = version->size;
+    return version->data;
+}
+
+// Lock a row for writing: IX on the table, which the transaction caches
+// after its first row, then X on the row. The lock manager grants the row
+// at once if the transaction holds the whole table exclusively, which a
+// bulk load reaches by escalation. Locks are kept until commit or abort,
+// even if the write then fails.
+static bool lock_row_for_write(Table *table, int txn_id, uint64_t lock_id)
+{
+    if (!lock_acquire(&g_lock_manager, txn_id, table->table_id, true, LOCK_INTENTION_EXCLUSIVE))
+    {
+        printf("Error: Could not acquire table lock\n");
+        return false;
     }
 
-    if (!lock_acquire(&g_lock_manager, txn_id, key, false, LOCK_SHARED))
+    if (!lock_acquire(&g_lock_manager, txn_id, lock_id, false, LOCK_EXCLUSIVE))
     {
         printf("Error: Could not acquire row lock\n");
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return NULL;
+        return false;
     }
+    return true;
+}
 
-    // Find leaf node containing key
-    BPTreeNode *leaf = find_leaf(table->index, key);
-    if (!leaf)
+// Insert a row under its row lock. The key must be new or its newest
+// version deleted; the row starts a new version, visible to others once
+// we commit.
+static bool apply_put(Table *table, TxnState *st, int txn_id, const RowKey *rk, void *data, size_t size)
+{
+    size_t wal_entry_size = NVRAM_ALIGN(WAL_ENTRY_SIZE(rk->bytes ? rk->len : 0));
+    Table *part = partition_for(table, rk);
+
+    uint64_t snapshot;
+    if (!txn_snapshot(txn_id, &snapshot))
+        return false;
+
+    // Check if key already exists
+    NVRAMPtr head_ptr = NULL;
+    RowVersion *latest = NULL;
+    if (index_lookup(part, rk, &head_ptr, NULL))
+        latest = __atomic_load_n(&((RowHead *)head_ptr)->latest, __ATOMIC_ACQUIRE);
+    if (write_conflict(latest, txn_id, snapshot))
+    {
+        printf("Error: Row changed since the transaction's snapshot\n");
+        return false;
+    }
+    if (version_live(latest))
+    {
+        // Key already exists, do not insert
+        return false; // Row already exists
+    }
+
+    // CHANGED: Create WAL entry BEFORE allocating NVRAM memory
+    // Add WAL entry for the insertion
+    void *wal_entry_ptr = allocate_memory(wal_entry_size);
+    if (!wal_entry_ptr)
+    {
+        printf("Error: Failed to allocate NVRAM for WAL entry\n");
+        return false;
+    }
+
+    // Allocate space in NVRAM for the version. A new key gets its head
+    // from the same allocation; the allocator frees by range, so the
+    // collector can still release the two separately.
+    size_t head_size = head_ptr ? 0 : ROW_HEAD_SIZE;
+    size_t block_size = head_size + NVRAM_ALIGN(sizeof(RowVersion) + size);
+    char *block = (char *)allocate_memory(block_size);
+    if (!block)
+    {
+        printf("Error: Failed to allocate NVRAM space for data\n");
+        free_memory(wal_entry_ptr, wal_entry_size);
+        return false;
+    }
+    RowHead *head = head_ptr ? (RowHead *)head_ptr : (RowHead *)block;
+    RowVersion *version = (RowVersion *)(block + head_size);
+    RowChange *change = row_change_new(part, rk, version, false);
+    if (!change)
+    {
+        printf("Error: Failed to allocate memory for row change\n");
+        free_memory(wal_entry_ptr, wal_entry_size);
+        free_memory(block, block_size);
+        return false;
+    }
+    change->head = head;
+
+    // Copy data to NVRAM behind a header naming us as the writer
+    version->begin_ts = TS_TXN | (uint64_t)txn_id;
+    version->end_ts = TS_INFINITY;
+    version->older = latest;
+    version->size = size;
+    version->alloc_size = block_size - head_size;
+    memcpy(version->data, data, size);
+
+    // Flush the data to NVRAM
+    flush_range(version, sizeof(RowVersion) + size);
+
+    // A new key goes into the index before it is logged, so a failed
+    // insert leaves no WAL entry pointing at the freed block. Until we
+    // commit, readers find it but skip our version.
+    if (!head_ptr)
+    {
+        head->latest = version;
+        flush_range(head, sizeof(RowHead));
+        if (!index_insert(part, rk, head, ROW_HEAD_SIZE))
+        {
+            free(change);
+            free_memory(wal_entry_ptr, wal_entry_size);
+            free_memory(block, block_size);
+            return false;
+        }
+    }
+
+    // Add entry to WAL (1 for insertion)
+    if (!wal_log_row(part, rk, version->data, 1, wal_entry_ptr, size))
+    {
+        printf("Error: Failed to add WAL entry\n");
+        free(change);
+        free_memory(wal_entry_ptr, wal_entry_size);
+        if (head_ptr)
+        {
+            free_memory(block, block_size);
+            return false;
+        }
+
+        // Readers may have found the new head: unlink it and free it
+        // once they are done, as an abort would
+        Garbage *unlinked = NULL;
+        index_remove(part, rk);
+        retire(&unlinked, block, block_size);
+        publish_garbage(unlinked);
+        return false;
+    }
+
+    if (head_ptr)
+    {
+        // Publish the version on top of the deleted one
+        __atomic_store_n(&head->latest, version, __ATOMIC_RELEASE);
+        flush_range(&head->latest, sizeof(RowVersion *));
+    }
+
+    change->next = st->changes;
+    st->changes = change;
+
+    // No need to release locks yet since the transaction is still ongoing
+    // They will be released when the transaction commits or aborts
+    return true;
+}
+
+// Delete a row under its row lock. Its version only gets an end stamp:
+// snapshots that began before we commit keep reading it until the
+// collector reclaims it.
+static bool apply_delete(Table *table, TxnState *st, int txn_id, const RowKey *rk)
+{
+    size_t wal_entry_size = NVRAM_ALIGN(WAL_ENTRY_SIZE(rk->bytes ? rk->len : 0));
+    Table *part = partition_for(table, rk);
+
+    uint64_t snapshot;
+    if (!txn_snapshot(txn_id, &snapshot))
+        return false;
+
+    // Find the newest version of the row
+    NVRAMPtr head_ptr;
+    RowVersion *latest = NULL;
+    if (index_lookup(part, rk, &head_ptr, NULL))
+        latest = __atomic_load_n(&((RowHead *)head_ptr)->latest, __ATOMIC_ACQUIRE);
+
+    if (write_conflict(latest, txn_id, snapshot))
+    {
+        printf("Error: Row changed since the transaction's snapshot\n");
+        return false;
+    }
+    if (!version_live(latest))
+    {
+        printf("Error: Row to delete not found\n");
+        return false;
+    }
+
+    RowChange *change = row_change_new(part, rk, latest, true);
+    if (!change)
+    {
+        printf("Error: Failed to allocate memory for row change\n");
+        return false;
+    }
+    change->head = (RowHead *)head_ptr;
+
+    // CHANGED: Add WAL entry for deletion before actually deleting data
+    void *wal_entry_ptr = allocate_memory(wal_entry_size);
+    if (!wal_entry_ptr)
+    {
+        printf("Error: Failed to allocate NVRAM for WAL entry\n");
+        free(change);
+        return false;
+    }
+
+    // Add entry to WAL (0 for deletion)
+    if (!wal_log_row(part, rk, latest->data, 0, wal_entry_ptr, latest->size))
+    {
+        printf("Error: Failed to add WAL entry\n");
+        free(change);
+        free_memory(wal_entry_ptr, wal_entry_size);
+        return false;
+    }
+
+    // End the version
+    __atomic_store_n(&latest->end_ts, TS_TXN | (uint64_t)txn_id, __ATOMIC_SEQ_CST);
+    flush_range(&latest->end_ts, sizeof(uint64_t));
+
+    change->next = st->changes;
+    st->changes = change;
+
+    // No need to release locks yet since the transaction is still ongoing
+    // They will be released when the transaction commits or aborts
+    return true;
+}
+
+// Add an entry to its stream's chain in a batch
+static void chain_entry(WalChain *chains, int *chain_count, int wal_id, WALEntry *entry)
+{
+    for (int i = 0; i < *chain_count; i++)
+    {
+        if (chains[i].wal_id == wal_id)
+        {
+            chains[i].last->next = entry;
+            chains[i].last = entry;
+            return;
+        }
+    }
+    chains[*chain_count] = (WalChain){wal_id, entry, entry};
+    (*chain_count)++;
+}
+
+// Write one block of planned keys: their WAL entries first, then their
+// versions, one flush over the whole block, one append per WAL stream,
+// and only then the index. A failure frees the versions not yet
+// published; the caller rolls back the rest.
+static bool install_batch(int txn_id, TxnState *st, BatchOp *ops, int count, size_t log_bytes, size_t total)
+{
+    char *block = (char *)allocate_memory(total);
+    WalChain *chains = (WalChain *)malloc(sizeof(WalChain) * count);
+    if (!block || !chains)
+    {
+        printf("Error: Failed to allocate NVRAM for a write batch\n");
+        if (block)
+            free_memory(block, total);
+        free(chains);
+        return false;
+    }
+
+    char *log = block, *rows = block + log_bytes;
+    int chain_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        BatchOp *op = &ops[i];
+        size_t key_len = op->key.bytes ? op->key.len : 0;
+        size_t entry_size = NVRAM_ALIGN(WAL_ENTRY_SIZE(key_len));
+
+        // Deletion (op 0) logged before the insertion (op 1) replacing it
+        if (op->ends)
+        {
+            wal_fill_entry(log, op->key.value, op->key.bytes, key_len, op->prior->data, 0, op->prior->size);
+            chain_entry(chains, &chain_count, op->part->wal_id, (WALEntry *)log);
+            log += entry_size;
+        }
+        if (op->put)
+        {
+            size_t head_size = op->head ? 0 : ROW_HEAD_SIZE;
+            RowVersion *version = (RowVersion *)(rows + head_size);
+            version->begin_ts = TS_TXN | (uint64_t)txn_id;
+            version->end_ts = TS_INFINITY;
+            version->older = op->prior;
+            version->size = op->w->size;
+            version->alloc_size = op->row_size - head_size;
+            memcpy(version->data, op->w->data, op->w->size);
+            if (!op->head)
+                ((RowHead *)rows)->latest = version;
+            op->version = version;
+            rows += op->row_size;
+
+            wal_fill_entry(log, op->key.value, op->key.bytes, key_len, version->data, 1, op->w->size);
+            chain_entry(chains, &chain_count, op->part->wal_id, (WALEntry *)log);
+            log += entry_size;
+        }
+    }
+    flush_range(block, total);
+
+    bool ok = true;
+    for (int i = 0; ok && i < chain_count; i++)
+        ok = wal_append_batch(chains[i].wal_id, chains[i].first, chains[i].last);
+    free(chains);
+
+    int published = 0;
+    for (; ok && published < count; published++)
+    {
+        BatchOp *op = &ops[published];
+        if (op->ends)
+        {
+            RowChange *change = row_change_new(op->part, &op->key, op->prior, true);
+            if (!change)
+            {
+                ok = false;
+                break;
+            }
+            change->head = op->head;
+            __atomic_store_n(&op->prior->end_ts, TS_TXN | (uint64_t)txn_id, __ATOMIC_SEQ_CST);
+            flush_range(&op->prior->end_ts, sizeof(uint64_t));
+            change->next = st->changes;
+            st->changes = change;
+            op->ends = false; // Undone by the rollback from here on
+        }
+        if (op->put)
+        {
+            RowHead *head = op->head ? op->head : (RowHead *)((char *)op->version - ROW_HEAD_SIZE);
+            RowChange *change = row_change_new(op->part, &op->key, op->version, false);
+            if (!change)
+            {
+                ok = false;
+                break;
+            }
+            change->head = head;
+            if (op->head)
+            {
+                __atomic_store_n(&head->latest, op->version, __ATOMIC_RELEASE);
+                flush_range(&head->latest, sizeof(RowVersion *));
+            }
+            else if (!index_insert(op->part, &op->key, head, ROW_HEAD_SIZE))
+            {
+                free(change);
+                ok = false;
+                break;
+            }
+            change->next = st->changes;
+            st->changes = change;
+        }
+    }
+
+    // Versions that never became visible go back (the WAL entries stay,
+    // never committed, as when a single write fails)
+    for (int i = published; !ok && i < count; i++)
+    {
+        if (ops[i].put)
+        {
+            size_t head_size = ops[i].head ? 0 : ROW_HEAD_SIZE;
+            free_memory((char *)ops[i].version - head_size, ops[i].row_size);
+        }
+    }
+    if (!ok)
+        printf("Error: Failed to install a write batch\n");
+    return ok;
+}
+
+// Apply a buffered transaction's writes under its row locks, before its
+// versions are stamped. Only each key's final state is written: a delete
+// of the row it found, an insert, or both; a row inserted and deleted
+// again costs no NVRAM at all. Keys are grouped into blocks of up to
+// WRITE_BATCH_BYTES, each written by install_batch. False if a row is
+// not in the state the first write saw or NVRAM runs out; the caller
+// rolls back.
+static bool install_writes(int txn_id, TxnState *st)
+{
+    int count = 0;
+    for (PendingWrite *w = st->writes; w; w = w->next)
+    {
+        if (!w->superseded)
+            count++;
+    }
+    if (count == 0)
+        return true;
+
+    BatchOp *ops = (BatchOp *)malloc(sizeof(BatchOp) * count);
+    if (!ops)
+    {
+        printf("Error: Failed to allocate memory for a write batch\n");
+        return false;
+    }
+
+    // Plan each key from its first and last write
+    int planned = 0;
+    bool ok = true;
+    for (PendingWrite *w = st->writes; ok && w; w = w->next)
+    {
+        if (w->superseded)
+            continue;
+        PendingWrite *first = w;
+        while (first->older)
+            first = first->older;
+
+        BatchOp *op = &ops[planned];
+        op->w = w;
+        op->key = (RowKey){w->key, w->byte_key ? w->key_bytes : NULL, w->key_len};
+        op->part = partition_for(w->table, &op->key);
+        NVRAMPtr head = NULL;
+        op->prior = NULL;
+        if (index_lookup(op->part, &op->key, &head, NULL))
+            op->prior = __atomic_load_n(&((RowHead *)head)->latest, __ATOMIC_ACQUIRE);
+        op->head = (RowHead *)head;
+
+        // A first delete found the row live, a first insert found none
+        if (version_live(op->prior) != first->is_delete)
+        {
+            ok = false;
+            break;
+        }
+        op->ends = first->is_delete;
+        op->put = !w->is_delete;
+
+        size_t entry_size = NVRAM_ALIGN(WAL_ENTRY_SIZE(op->key.bytes ? op->key.len : 0));
+        op->log_size = (op->ends ? entry_size : 0) + (op->put ? entry_size : 0);
+        op->row_size = op->put ? (head ? 0 : ROW_HEAD_SIZE) + NVRAM_ALIGN(sizeof(RowVersion) + w->size) : 0;
+        if (op->ends || op->put)
+            planned++;
+    }
+
+    for (int start = 0; ok && start < planned;)
+    {
+        size_t log_bytes = 0, total = 0;
+        int end = start;
+        while (end < planned && (end == start || total + ops[end].log_size + ops[end].row_size <= WRITE_BATCH_BYTES))
+        {
+            log_bytes += ops[end].log_size;
+            total += ops[end].log_size + ops[end].row_size;
+            end++;
+        }
+        ok = install_batch(txn_id, st, ops + start, end - start, log_bytes, total);
+        start = end;
+    }
+    free(ops);
+    return ok;
+}
+
+static int compare_lock_order(const void *a, const void *b)
+{
+    uint64_t x = (*(PendingWrite *const *)a)->lock_id;
+    uint64_t y = (*(PendingWrite *const *)b)->lock_id;
+    return x < y ? -1 : x > y;
+}
+
+// Commit work of an optimistic transaction, run before its versions are
+// stamped: lock the rows it writes in key order (so committers never
+// wait on each other in a cycle), validate its reads, then install its
+// writes as a deferred transaction does. False if a lock or a read
+// fails; the caller then rolls back whatever was applied.
+static bool occ_install(int txn_id, TxnState *st, uint64_t snapshot)
+{
+    bool ok = !st->untracked;
+    int count = 0;
+    for (PendingWrite *w = st->writes; w; w = w->next)
+        count++;
+
+    if (ok && count > 0)
+    {
+        PendingWrite **order = (PendingWrite **)malloc(sizeof(PendingWrite *) * count);
+        ok = order != NULL;
+        if (ok)
+        {
+            int i = 0;
+            for (PendingWrite *w = st->writes; w; w = w->next)
+                order[i++] = w;
+            qsort(order, count, sizeof(PendingWrite *), compare_lock_order);
+            for (i = 0; ok && i < count; i++)
+            {
+                if (i == 0 || order[i]->lock_id != order[i - 1]->lock_id)
+                    ok = lock_row_for_write(order[i]->table, txn_id, order[i]->lock_id);
+            }
+        }
+        free(order);
+    }
+
+    for (RowRead *r = st->reads; ok && r; r = r->next)
+        ok = read_still_valid(r, txn_id, snapshot);
+
+    if (ok)
+        ok = install_writes(txn_id, st);
+
+    pending_discard(st);
+    return ok;
+}
+
+// Insert a row: at once under 2PL, at commit for a buffered transaction
+// (locking the row now if deferred)
+static bool row_put(Table *table, int txn_id, const RowKey *rk, void *data, size_t size)
+{
+    if (!table || !table->is_open)
+    {
+        printf("Error: Invalid or closed table\n");
+        return false;
+    }
+    if (txn_id >= TXN_ID_LIMIT)
+    {
+        printf("Error: Transaction %d is read-only\n", txn_id);
+        return false;
+    }
+
+    TxnState *st = txn_state(txn_id);
+    if (st && st->mode == TXN_OPTIMISTIC)
+        return buffer_write(table, st, txn_id, rk, data, size, false);
+    if (!st || !lock_row_for_write(table, txn_id, key_lock_id(table->table_id, rk)))
+        return false;
+    if (st->mode == TXN_DEFERRED)
+        return buffer_write(table, st, txn_id, rk, data, size, false);
+    return apply_put(table, st, txn_id, rk, data, size);
+}
+
+// Delete a row: at once under 2PL, at commit for a buffered transaction
+// (locking the row now if deferred)
+static bool row_delete(Table *table, int txn_id, const RowKey *rk)
+{
+    if (!table || !table->is_open)
+    {
+        printf("Error: Invalid or closed table\n");
+        return false;
+    }
+    if (txn_id >= TXN_ID_LIMIT)
+    {
+        printf("Error: Transaction %d is read-only\n", txn_id);
+        return false;
+    }
+
+    TxnState *st = txn_state(txn_id);
+    if (st && st->mode == TXN_OPTIMISTIC)
+        return buffer_write(table, st, txn_id, rk, NULL, 0, true);
+    if (!st || !lock_row_for_write(table, txn_id, key_lock_id(table->table_id, rk)))
+        return false;
+    if (st->mode == TXN_DEFERRED)
+        return buffer_write(table, st, txn_id, rk, NULL, 0, true);
+    return apply_delete(table, st, txn_id, rk);
+}
+
+NVRAMPtr db_get_row(Table *table, int txn_id, int key, size_t *size)
+{
+    RowKey rk = {key, NULL, 0};
+    return row_get(table, txn_id, &rk, size);
+}
+
+bool db_put_row(Table *table, int txn_id, int key, void *data, size_t size)
+{
+    RowKey rk = {key, NULL, 0};
+    return row_put(table, txn_id, &rk, data, size);
+}
+
+bool db_delete_row(Table *table, int txn_id, int key)
+{
+    RowKey rk = {key, NULL, 0};
+    return row_delete(table, txn_id, &rk);
+}
+
+// Byte-string keys need an index ordered by bytes
+static bool check_byte_keys(Table *table, size_t key_len)
+{
+    if (table && table->index_type != INDEX_VARKEY && table->index_type != INDEX_ART)
+    {
+        printf("Error: Table '%s' has an int-keyed index\n", table->name);
+        return false;
+    }
+    if (key_len > VB_MAX_KEY_LEN)
+    {
+        printf("Error: Key of %zu bytes exceeds the %d byte limit\n", key_len, VB_MAX_KEY_LEN);
+        return false;
+    }
+    return true;
+}
+
+NVRAMPtr db_get_row_bytes(Table *table, int txn_id, const void *key, size_t key_len, size_t *size)
+{
+    RowKey rk = {0, (const unsigned char *)key, key_len};
+    if (!check_byte_keys(table, key_len))
+        return NULL;
+    return row_get(table, txn_id, &rk, size);
+}
+
+bool db_put_row_bytes(Table *table, int txn_id, const void *key, size_t key_len, void *data, size_t size)
+{
+    RowKey rk = {0, (const unsigned char *)key, key_len};
+    if (!check_byte_keys(table, key_len))
+        return false;
+    return row_put(table, txn_id, &rk, data, size);
+}
+
+bool db_delete_row_bytes(Table *table, int txn_id, const void *key, size_t key_len)
+{
+    RowKey rk = {0, (const unsigned char *)key, key_len};
+    if (!check_byte_keys(table, key_len))
+        return false;
+    return row_delete(table, txn_id, &rk);
+}
+
+// db_get_next_key_bytes for one snapshot
+static bool next_key_bytes(Table *table, const void *key, size_t key_len, int txn_id, uint64_t snapshot,
+                           void *out_key, size_t out_cap, size_t *out_len)
+{
+    if (table->num_partitions > 0)
     {
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return NULL;
+        // Hash partitions: the smallest next key any partition has
+        unsigned char candidate[VB_MAX_KEY_LEN], best[VB_MAX_KEY_LEN];
+        size_t candidate_len, best_len = 0;
+        bool found = false;
+        for (int i = 0; i < table->num_partitions; i++)
+        {
+            if (!next_key_bytes(table->partitions[i], key, key_len, txn_id, snapshot,
+                                candidate, sizeof(candidate), &candidate_len))
+                continue;
+            int cmp = found ? memcmp(candidate, best, candidate_len < best_len ? candidate_len : best_len) : -1;
+            if (cmp < 0 || (cmp == 0 && candidate_len < best_len))
+            {
+                memcpy(best, candidate, candidate_len);
+                best_len = candidate_len;
+                found = true;
+            }
+        }
+        if (found)
+        {
+            memcpy(out_key, best, best_len < out_cap ? best_len : out_cap);
+            *out_len = best_len;
+        }
+        return found;
     }
 
-    // Find key in leaf
-    int pos = find_key_in_leaf(leaf, key);
-    if (pos == -1)
+    // Seek past keys whose rows this snapshot doesn't see
+    unsigned char from[VB_MAX_KEY_LEN], found[VB_MAX_KEY_LEN];
+    size_t found_len;
+    bool inclusive = key == NULL;
+    for (;;)
     {
-        // Key not found
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return NULL;
-    }
+        bool ok = table->index_type == INDEX_ART
+                      ? art_seek(table->art, key, inclusive ? 0 : key_len, inclusive, found, sizeof(found), &found_len)
+                      : vbt_seek(table->vbt, key, inclusive ? 0 : key_len, inclusive, found, sizeof(found), &found_len);
+        if (!ok)
+            return false;
 
-    // Return data pointer and size
-    if (size)
-        *size = leaf->data_sizes[pos];
+        RowKey rk = {0, found, found_len};
+        if (row_visible(table, &rk, txn_id, snapshot))
+            break;
+        memcpy(from, found, found_len);
+        key = from;
+        key_len = found_len;
+        inclusive = false;
+    }
 
-    // No need to release locks yet since the transaction is still ongoing
-    // They will be released when the transaction commits or aborts
-    return leaf->data_ptrs[pos];
+    memcpy(out_key, found, found_len < out_cap ? found_len : out_cap);
+    *out_len = found_len;
+    return true;
 }
 
-// Insert or update a row
-bool db_put_row(Table *table, int txn_id, int key, void *data, size_t size)
+// Next byte-string key after key (the first key when key is NULL)
+bool db_get_next_key_bytes(Table *table, const void *key, size_t key_len,
+                           void *out_key, size_t out_cap, size_t *out_len)
 {
     if (!table || !table->is_open)
     {
         printf("Error: Invalid or closed table\n");
         return false;
     }
+    if (!check_byte_keys(table, key_len))
+        return false;
 
-    // Acquire locks
-    if (!lock_acquire(&g_lock_manager, txn_id, table->table_id, true, LOCK_SHARED))
-    {
-        printf("Error: Could not acquire table lock\n");
+    uint64_t snapshot;
+    int txn_id = db_begin_readonly();
+    if (!txn_snapshot(txn_id, &snapshot))
         return false;
-    }
+    bool found = next_key_bytes(table, key, key_len, txn_id, snapshot, out_key, out_cap, out_len);
+    db_commit_transaction(txn_id);
+    return found;
+}
 
-    if (!lock_acquire(&g_lock_manager, txn_id, key, false, LOCK_EXCLUSIVE))
+long db_get_table_row_count(Table *table)
+{
+    if (!table)
     {
-        printf("Error: Could not acquire row lock\n");
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        return 0;
     }
 
-    BPTreeNode *leaf = find_leaf(table->index, key);
-    if (leaf)
+    if (table->num_partitions > 0)
     {
-        // Check if key already exists
-        int pos = find_key_in_leaf(leaf, key);
-        if (pos != -1)
-        {
-            // Key already exists, do not insert
-            lock_release(&g_lock_manager, txn_id, key, false);
-            lock_release(&g_lock_manager, txn_id, table->table_id, true);
-            return false; // Row already exists
-        }
+        long total = 0;
+        for (int i = 0; i < table->num_partitions; i++)
+            total += db_get_table_row_count(table->partitions[i]);
+        return total;
     }
 
-    // CHANGED: Create WAL entry BEFORE allocating NVRAM memory
-    // Add WAL entry for the insertion
-    void *wal_entry_ptr = allocate_memory(sizeof(WALEntry));
-    if (!wal_entry_ptr)
+    if (table->index_type == INDEX_ART)
     {
-        printf("Error: Failed to allocate NVRAM for WAL entry\n");
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        return art_size(table->art);
     }
 
-    // Allocate space in NVRAM for data
-    NVRAMPtr nvram_data = allocate_memory(size);
-    if (!nvram_data)
+    if (table->index_type == INDEX_CUCKOO)
     {
-        printf("Error: Failed to allocate NVRAM space for data\n");
-        free_memory(wal_entry_ptr, sizeof(WALEntry));
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        return cuckoo_size(table->hash);
     }
 
-    // Copy data to NVRAM
-    memcpy(nvram_data, data, size);
-
-    // Flush the data to NVRAM
-    flush_range(nvram_data, size);
-
-    // Add entry to WAL (1 for insertion)
-    if (!wal_add_entry(table->table_id, key, nvram_data, 1, wal_entry_ptr, size))
+    if (table->index_type == INDEX_VARKEY)
     {
-        printf("Error: Failed to add WAL entry\n");
-        free_memory(wal_entry_ptr, sizeof(WALEntry));
-        free_memory(nvram_data, size);
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        return vbt_size(table->vbt);
     }
 
-    // Handle empty tree case
-    if (table->index->root == NULL)
+    if (!table->index)
     {
-        table->index->root = create_node(true);
-        if (!table->index->root)
-        {
-            printf("Error: Failed to create root node\n");
-            free_memory(nvram_data, size);
-            lock_release(&g_lock_manager, txn_id, key, false);
-            lock_release(&g_lock_manager, txn_id, table->table_id, true);
-            return false;
-        }
+        return 0;
+    }
 
-        table->index->root->keys[0] = key;
-        table->index->root->data_ptrs[0] = nvram_data;
-        table->index->root->data_sizes[0] = size;
-        table->index->root->num_keys = 1;
-        table->index->record_count++;
+    // The record_count is already maintained by the B+Tree logic.
+    return (long)table->index->record_count;
+}
 
-        // No need to release locks yet since the transaction is still ongoing
-        // They will be released when the transaction commits or aborts
-        return true;
-    }
+int db_table_partition_count(Table *table)
+{
+    return table ? table->num_partitions : 0;
+}
 
-    // Recursive insertion
-    int up_key;
-    BPTreeNode *new_node = NULL;
+Table *db_table_partition(Table *table, int i)
+{
+    if (!table || i < 0 || i >= table->num_partitions)
+        return NULL;
+    return table->partitions[i];
+}
+
+bool db_table_has_byte_keys(Table *table)
+{
+    return table && table->index_type == INDEX_VARKEY;
+}
+
+int db_table_id(Table *table)
+{
+    return table ? table->table_id : -1;
+}
+
+// index_next_key, skipping keys whose newest committed version is
+// deleted (they stay indexed until the collector reclaims them)
+static int visible_next_key(Table *table, int key, bool inclusive)
+{
+    uint64_t snapshot;
+    int txn_id = db_begin_readonly();
+    int next_key = -1;
 
-    if (!insert_recursive(table->index, table->index->root, key, nvram_data, size, &up_key, &new_node))
+    if (!txn_snapshot(txn_id, &snapshot))
+        return -1;
+
+    while ((next_key = index_next_key(table, key, inclusive)) != -1)
     {
-        printf("Error: Failed to insert key\n");
-        free_memory(nvram_data, size);
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        RowKey rk = {next_key, NULL, 0};
+        if (row_visible(partition_for(table, &rk), &rk, txn_id, snapshot))
+            break;
+        key = next_key;
+        inclusive = false;
     }
 
-    // Root split case
-    if (new_node != NULL)
+    db_commit_transaction(txn_id);
+    return next_key;
+}
+
+int db_get_first_key(Table *table)
+{
+    if (!table)
     {
-        // Create new root
-        BPTreeNode *new_root = create_node(false);
-        if (!new_root)
-        {
-            printf("Error: Failed to create new root\n");
-            free_node(new_node);
-            lock_release(&g_lock_manager, txn_id, key, false);
-            lock_release(&g_lock_manager, txn_id, table->table_id, true);
-            return false;
-        }
+        return -1; // No table
+    }
 
-        // Set up new root
-        new_root->keys[0] = up_key;
-        new_root->children[0] = table->index->root;
-        new_root->children[1] = new_node;
-        new_root->num_keys = 1;
+    // INT_MIN is the smallest possible key
+    return visible_next_key(table, INT_MIN, true);
+}
 
-        // Update tree
-        table->index->root = new_root;
-        table->index->height++;
-        table->index->node_count++;
+// Get the next row for iteration
+int db_get_next_row(Table *table, int current_key)
+{
+    if (!table || !table->is_open)
+    {
+        printf("Error: Invalid or closed table\n");
+        return -1;
     }
 
-    // Update record count
-    table->index->record_count++;
+    // Special case: if current_key is -1, return the first key
+    if (current_key == -1)
+    {
+        return visible_next_key(table, INT_MIN, true);
+    }
 
-    // No need to release locks yet since the transaction is still ongoing
-    // They will be released when the transaction commits or aborts
-    return true;
+    return visible_next_key(table, current_key, false);
 }
 
-// Delete a row
-bool db_delete_row(Table *table, int txn_id, int key)
+// Where a cursor stands relative to its key
+typedef enum
+{
+    CURSOR_BEFORE, // Just before key (after a seek)
+    CURSOR_ON,     // On key (the last row returned)
+    CURSOR_AFTER   // Just after key (after seek_last or running off the end)
+} CursorSide;
+
+// Range-scan cursor. On a B+ Tree it keeps the leaf and slot of the key
+// it is on, valid while the tree's version is unchanged; otherwise, and on
+// the other indexes and partitioned tables, it re-seeks from the key it
+// remembers.
+struct DbCursor
+{
+    Table *table;
+    int txn_id;        // Read-only transaction holding the snapshot
+    uint64_t snapshot; // Rows are returned as of this point
+    int key;          // Key the cursor is on or next to
+    CursorSide side;  // Position relative to key
+    BPTreeNode *leaf; // B+ Tree leaf holding key, NULL to re-seek
+    int pos;          // Slot of key in leaf
+    uint64_t version; // Tree version leaf/pos were taken at
+};
+
+// Pull the leaf after this one (in scan order) and this leaf's row heads
+// towards the cache
+static void prefetch_leaf(BPTreeNode *leaf, bool forward)
+{
+    BPTreeNode *ahead = forward ? leaf->next_leaf : leaf->prev_leaf;
+    if (ahead)
+        __builtin_prefetch(ahead, 0, 1);
+    for (int i = 0; i < leaf->num_keys; i++)
+        __builtin_prefetch(leaf->data_ptrs[i], 0, 1);
+}
+
+DbCursor *db_cursor_open(Table *table)
 {
     if (!table || !table->is_open)
     {
         printf("Error: Invalid or closed table\n");
-        return false;
+        return NULL;
     }
 
-    // Acquire locks
-    if (!lock_acquire(&g_lock_manager, txn_id, table->table_id, true, LOCK_SHARED))
-    {
-        printf("Error: Could not acquire table lock\n");
-        return false;
-    }
+    DbCursor *cursor = (DbCursor *)malloc(sizeof(DbCursor));
+    if (!cursor)
+        return NULL;
 
-    if (!lock_acquire(&g_lock_manager, txn_id, key, false, LOCK_EXCLUSIVE))
+    cursor->table = table;
+    cursor->txn_id = db_begin_readonly();
+    if (!txn_snapshot(cursor->txn_id, &cursor->snapshot))
     {
-        printf("Error: Could not acquire row lock\n");
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        printf("Error: No transaction slot for the cursor\n");
+        free(cursor);
+        return NULL;
     }
+    db_cursor_seek(cursor, INT_MIN);
+    return cursor;
+}
 
-    // Find the data and its size before deleting
-    size_t data_size = 0;
-    void *data_ptr = NULL;
+// Position before key: next returns the first key >= key, prev the last key < key
+void db_cursor_seek(DbCursor *cursor, int key)
+{
+    cursor->key = key;
+    cursor->side = CURSOR_BEFORE;
+    cursor->leaf = NULL;
+    cursor->pos = 0;
+    cursor->version = 0;
+}
 
-    // Find leaf node containing key
-    BPTreeNode *leaf = find_leaf(table->index, key);
-    if (leaf)
+// Position after the last key: prev returns the last key
+void db_cursor_seek_last(DbCursor *cursor)
+{
+    db_cursor_seek(cursor, INT_MAX);
+    cursor->side = CURSOR_AFTER;
+}
+
+static bool bptree_cursor_step(DbCursor *cursor, bool forward, int *key, NVRAMPtr *data, size_t *size)
+{
+    BPTree *tree = cursor->table->index;
+    BPTreeNode *leaf;
+    int pos;
+
+    pthread_rwlock_rdlock(&tree->latch);
+
+    if (cursor->leaf && cursor->version == tree->version)
     {
-        // Find key in leaf
-        int pos = find_key_in_leaf(leaf, key);
-        if (pos != -1)
+        // Tree unchanged: step along the leaf chain
+        leaf = cursor->leaf;
+        pos = forward ? cursor->pos + 1 : cursor->pos - 1;
+    }
+    else
+    {
+        // First call or the tree changed: re-seek by key
+        leaf = find_leaf(tree, cursor->key);
+        if (forward)
         {
-            data_ptr = leaf->data_ptrs[pos];
-            data_size = leaf->data_sizes[pos];
+            bool inclusive = cursor->side == CURSOR_BEFORE;
+            pos = 0;
+            while (leaf && pos < leaf->num_keys &&
+                   (leaf->keys[pos] < cursor->key || (!inclusive && leaf->keys[pos] == cursor->key)))
+                pos++;
         }
+        else
+        {
+            bool inclusive = cursor->side == CURSOR_AFTER;
+            pos = leaf ? leaf->num_keys - 1 : -1;
+            while (pos >= 0 &&
+                   (leaf->keys[pos] > cursor->key || (!inclusive && leaf->keys[pos] == cursor->key)))
+                pos--;
+        }
+        if (leaf)
+            prefetch_leaf(leaf, forward);
     }
 
-    if (!data_ptr)
+    if (forward)
     {
-        printf("Error: Row to delete not found\n");
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        while (leaf && pos >= leaf->num_keys)
+        {
+            leaf = leaf->next_leaf;
+            pos = 0;
+            if (leaf)
+                prefetch_leaf(leaf, true);
+        }
     }
-
-    // CHANGED: Add WAL entry for deletion before actually deleting data
-    void *wal_entry_ptr = allocate_memory(sizeof(WALEntry));
-    if (!wal_entry_ptr)
+    else
     {
-        printf("Error: Failed to allocate NVRAM for WAL entry\n");
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        while (leaf && pos < 0)
+        {
+            leaf = leaf->prev_leaf;
+            pos = leaf ? leaf->num_keys - 1 : -1;
+            if (leaf)
+                prefetch_leaf(leaf, false);
+        }
     }
 
-    // Add entry to WAL (0 for deletion)
-    if (!wal_add_entry(table->table_id, key, data_ptr, 0, wal_entry_ptr, data_size))
+    if (leaf)
     {
-        printf("Error: Failed to add WAL entry\n");
-        free_memory(wal_entry_ptr, sizeof(WALEntry));
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
-    }
+        cursor->key = leaf->keys[pos];
+        cursor->side = CURSOR_ON;
+        cursor->leaf = leaf;
+        cursor->pos = pos;
+        cursor->version = tree->version;
 
-    // Handle empty tree case
-    if (table->index->root == NULL)
+        if (key)
+            *key = leaf->keys[pos];
+        if (data)
+            *data = leaf->data_ptrs[pos];
+        if (size)
+            *size = leaf->data_sizes[pos];
+    }
+    else
     {
-        lock_release(&g_lock_manager, txn_id, key, false);
-        lock_release(&g_lock_manager, txn_id, table->table_id, true);
-        return false;
+        // Ran off the end: stepping back returns the last key seen
+        cursor->side = forward ? CURSOR_AFTER : CURSOR_BEFORE;
+        cursor->leaf = NULL;
     }
 
-    // Recursive deletion
-    bool result = remove_recursive(table->index, table->index->root, key, NULL, 0);
+    pthread_rwlock_unlock(&tree->latch);
+    return leaf != NULL;
+}
 
-    if (result)
+// Other indexes seek by key; retry if the key vanished in between
+static bool index_cursor_step(DbCursor *cursor, bool forward, int *key, NVRAMPtr *data, size_t *size)
+{
+    RowKey rk = {0, NULL, 0};
+    int found_key;
+
+    while (forward ? index_next(cursor->table, cursor->key, cursor->side == CURSOR_BEFORE, &found_key)
+                   : index_prev(cursor->table, cursor->key, cursor->side == CURSOR_AFTER, &found_key))
     {
-        // Update record count
-        table->index->record_count--;
+        cursor->key = found_key;
+        cursor->side = CURSOR_ON;
+        rk.value = found_key;
+        if (index_lookup(partition_for(cursor->table, &rk), &rk, data, size))
+        {
+            if (key)
+                *key = found_key;
+            return true;
+        }
     }
 
-    // No need to release locks yet since the transaction is still ongoing
-    // They will be released when the transaction commits or aborts
-    return result;
+    cursor->side = forward ? CURSOR_AFTER : CURSOR_BEFORE;
+    return false;
 }
 
-long db_get_table_row_count(Table *table)
+// Step to the next key whose row the cursor's snapshot sees
+static bool cursor_step(DbCursor *cursor, bool forward, int *key, NVRAMPtr *data, size_t *size)
 {
-    if (!table || !table->index)
-    {
-        return 0;
+    int found_key;
+    NVRAMPtr head;
+
+    while (cursor->table->index ? bptree_cursor_step(cursor, forward, &found_key, &head, NULL)
+                                : index_cursor_step(cursor, forward, &found_key, &head, NULL))
+    {
+        RowVersion *version = visible_version((RowHead *)head, cursor->txn_id, cursor->snapshot);
+        if (!version)
+            continue;
+        if (key)
+            *key = found_key;
+        if (data)
+            *data = version->data;
+        if (size)
+            *size = version->size;
+        return true;
     }
+    return false;
+}
 
-    // The record_count is already maintained by the B+Tree logic.
-    return (long)table->index->record_count;
+// Advance to the next key. Returns false at the end of the table.
+bool db_cursor_next(DbCursor *cursor, int *key, NVRAMPtr *data, size_t *size)
+{
+    if (!cursor)
+        return false;
+    return cursor_step(cursor, true, key, data, size);
 }
 
-int db_get_first_key(Table *table)
+// Step back to the previous key. Returns false at the start of the table.
+bool db_cursor_prev(DbCursor *cursor, int *key, NVRAMPtr *data, size_t *size)
 {
-    if (!table || !table->index || !table->index->root)
-    {
-        return -1; // No table or no root
-    }
+    if (!cursor)
+        return false;
+    return cursor_step(cursor, false, key, data, size);
+}
 
-    BPTreeNode *node = table->index->root;
+void db_cursor_close(DbCursor *cursor)
+{
+    if (cursor)
+        db_commit_transaction(cursor->txn_id);
+    free(cursor);
+}
 
-    // If the root has no keys, the tree is empty
-    if (node->num_keys == 0)
-    {
-        return -1; // Empty tree
-    }
+// Visit every row with lo <= key <= hi in key order until the callback
+// returns false. Returns the number of rows visited.
+long db_scan_range(Table *table, int lo, int hi, DbScanCallback callback, void *arg)
+{
+    DbCursor *cursor = db_cursor_open(table);
+    long count = 0;
+    int key;
+    NVRAMPtr data;
+    size_t size;
 
-    // Traverse down the tree, always taking the leftmost child (index 0)
-    while (!node->is_leaf)
-    {
-        node = node->children[0];
-    }
+    if (!cursor)
+        return -1;
 
-    // We are now at the leftmost leaf node. The first key in this node
-    // is the smallest key in the entire table.
-    if (node->num_keys > 0)
+    db_cursor_seek(cursor, lo);
+    while (db_cursor_next(cursor, &key, &data, &size) && key <= hi)
     {
-        return node->keys[0];
+        count++;
+        if (callback && !callback(key, data, size, arg))
+            break;
     }
 
-    return -1; // Should not happen in a valid tree, but a safe fallback
+    db_cursor_close(cursor);
+    return count;
 }
 
-// Get the next row for iteration
-int db_get_next_row(Table *table, int current_key)
+// Indexes without subtree counts step through their keys instead. Like
+// the B+ Tree counts (and db_get_table_row_count) this sees every indexed
+// key, deleted or not, so all index types give the same answer.
+static long index_count_range(Table *table, int lo, int hi)
 {
-    if (!table || !table->is_open)
-    {
-        printf("Error: Invalid or closed table\n");
-        return -1;
-    }
+    long count = 0;
+    int key;
 
-    // Special case: if current_key is -1, return the first key
-    if (current_key == -1)
-    {
-        BPTreeNode *node = table->index->root;
+    for (bool found = index_next(table, lo, true, &key); found && key <= hi;
+         found = index_next(table, key, false, &key))
+        count++;
+    return count;
+}
 
-        // Navigate to leftmost leaf
-        while (!node->is_leaf)
-        {
-            node = node->children[0];
-        }
+// Number of rows with lo <= key <= hi
+long db_count_range(Table *table, int lo, int hi)
+{
+    long count;
 
-        if (node->num_keys > 0)
-        {
-            return node->keys[0];
-        }
-        else
+    if (!table || lo > hi)
+        return 0;
+
+    if (table->num_partitions > 0)
+    {
+        int first = 0, last = table->num_partitions - 1;
+        if (table->partition_method == PARTITION_RANGE)
         {
-            return -1; // Empty tree
+            first = range_partition(table, lo);
+            last = range_partition(table, hi);
         }
+        count = 0;
+        for (int i = first; i <= last; i++)
+            count += db_count_range(table->partitions[i], lo, hi);
+        return count;
     }
 
-    // Find leaf containing current key
-    BPTreeNode *leaf = find_leaf(table->index, current_key);
-    if (!leaf)
-        return -1;
+    if (table->index_type != INDEX_BPTREE)
+        return index_count_range(table, lo, hi);
+
+    if (!table->index)
+        return 0;
+
+    pthread_rwlock_rdlock(&table->index->latch);
+    count = bptree_rank(table->index, hi, true) - bptree_rank(table->index, lo, false);
+    pthread_rwlock_unlock(&table->index->latch);
+    return count;
+}
 
-    // Find position of current key
-    int pos = find_key_in_leaf(leaf, current_key);
-    if (pos == -1)
+// Key of the row at 0-based position rank in key order
+bool db_seek_rank(Table *table, long rank, int *key)
+{
+    bool found;
+
+    if (!table || !key || rank < 0)
+        return false;
+
+    if (table->partition_method == PARTITION_RANGE)
     {
-        // Current key not found
-        return -1;
+        // Partitions are in key order: skip whole ones by their row counts
+        for (int i = 0; i < table->num_partitions; i++)
+        {
+            long rows = db_get_table_row_count(table->partitions[i]);
+            if (rank < rows)
+                return db_seek_rank(table->partitions[i], rank, key);
+            rank -= rows;
+        }
+        return false;
     }
 
-    // Check if there's a next key in the same leaf
-    if (pos + 1 < leaf->num_keys)
+    if (table->index_type == INDEX_BPTREE && table->num_partitions > 0)
     {
-        return leaf->keys[pos + 1];
+        // Hash partitions each span the whole key space, but their counts
+        // still give the rank of any key: binary search for the smallest
+        // key with more than rank keys at or below it (32 steps)
+        int64_t lo = INT_MIN, hi = INT_MAX;
+        if (db_count_range(table, INT_MIN, INT_MAX) <= rank)
+            return false;
+        while (lo < hi)
+        {
+            int64_t mid = lo + (hi - lo) / 2;
+            if (db_count_range(table, INT_MIN, (int)mid) > rank)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        *key = (int)lo;
+        return true;
     }
 
-    // Otherwise, move to next leaf
-    if (leaf->next_leaf && leaf->next_leaf->num_keys > 0)
+    if (table->index_type != INDEX_BPTREE)
     {
-        return leaf->next_leaf->keys[0];
+        // No subtree counts to descend by: walk from the first key
+        found = index_next(table, INT_MIN, true, key);
+        while (found && rank-- > 0)
+            found = index_next(table, *key, false, key);
+        return found;
     }
 
-    // No more keys
-    return -1;
-}
\ No newline at end of file
+    if (!table->index)
+        return false;
+
+    pthread_rwlock_rdlock(&table->index->latch);
+    found = bptree_select(table->index, rank, key);
+    pthread_rwlock_unlock(&table->index->latch);
+    return found;
+}
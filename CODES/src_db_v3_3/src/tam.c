@@ -47,6 +47,81 @@ Datum mytam_create_table(PG_FUNCTION_ARGS)
     PG_RETURN_INT32(table_id);
 }
 
+PG_FUNCTION_INFO_V1(mytam_create_table_with_index);
+Datum mytam_create_table_with_index(PG_FUNCTION_ARGS)
+{
+    char *table_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    char *index_name = text_to_cstring(PG_GETARG_TEXT_PP(1));
+    IndexType index_type;
+
+    if (pg_strcasecmp(index_name, "bptree") == 0)
+    {
+        index_type = INDEX_BPTREE;
+    }
+    else if (pg_strcasecmp(index_name, "art") == 0)
+    {
+        index_type = INDEX_ART;
+    }
+    else if (pg_strcasecmp(index_name, "cuckoo") == 0)
+    {
+        index_type = INDEX_CUCKOO;
+    }
+    else if (pg_strcasecmp(index_name, "varkey") == 0)
+    {
+        // Tuples still map to int keys, stored as 4-byte strings
+        index_type = INDEX_VARKEY;
+    }
+    else
+    {
+        ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("mytam: unknown index type '%s'", index_name)));
+    }
+
+    int table_id = db_create_table_with_index(table_name, index_type);
+
+    if (table_id < 0)
+    {
+        ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR), errmsg("mytam: failed to create table backend for '%s'", table_name)));
+    }
+
+    pfree(table_name);
+    pfree(index_name);
+
+    PG_RETURN_INT32(table_id);
+}
+
+// Rows of a backend table with lo <= key <= hi (one index descent on B+ Tree
+// tables), counting deleted rows not yet reclaimed like the row count
+PG_FUNCTION_INFO_V1(mytam_count_range);
+Datum mytam_count_range(PG_FUNCTION_ARGS)
+{
+    char *table_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    int32 lo = PG_GETARG_INT32(1);
+    int32 hi = PG_GETARG_INT32(2);
+    Table *table = db_open_table(table_name);
+
+    if (!table)
+    {
+        ereport(ERROR, (errcode(ERRCODE_UNDEFINED_TABLE), errmsg("mytam: table '%s' not found", table_name)));
+    }
+
+    pfree(table_name);
+
+    PG_RETURN_INT64(db_count_range(table, lo, hi));
+}
+
+// Lock manager statistics of this backend, as lock_stats_format prints them
+PG_FUNCTION_INFO_V1(mytam_lock_stats);
+Datum mytam_lock_stats(PG_FUNCTION_ARGS)
+{
+    LockStats stats;
+    char buf[2048];
+
+    lock_stats_collect(&g_lock_manager, &stats);
+    lock_stats_format(&stats, buf, sizeof(buf));
+
+    PG_RETURN_TEXT_P(cstring_to_text(buf));
+}
+
 void _PG_init(void)
 {
     db_init();
@@ -64,7 +139,7 @@ typedef struct MyTamScanDesc
 {
     TableScanDescData rs_base;
     Table *table;
-    int current_key;
+    DbCursor *cursor; // Position in the table's index
     bool scan_started;
 } MyTamScanDesc;
 
@@ -89,7 +164,11 @@ mytam_scan_begin(Relation relation, Snapshot snapshot, int nkeys, ScanKey key, P
         ereport(ERROR, (errcode(ERRCODE_UNDEFINED_TABLE), errmsg("mytam: could not open table \"%s\"", table_name)));
     }
 
-    scan->current_key = -1;
+    scan->cursor = db_cursor_open(scan->table);
+    if (!scan->cursor)
+    {
+        ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY), errmsg("mytam: could not open a cursor on \"%s\"", table_name)));
+    }
     scan->scan_started = false;
 
     return (TableScanDesc)scan;
@@ -102,38 +181,33 @@ mytam_scan_getnextslot(TableScanDesc sscan, ScanDirection direction, TupleTableS
     int next_key;
     size_t data_size;
     void *data_ptr;
-    int txn_id = 0;
     TupleDesc tupDesc;
     Datum values[2];
     bool nulls[2] = {false, false};
     HeapTuple tuple;
+    bool found;
 
-    if (direction != ForwardScanDirection)
+    if (ScanDirectionIsNoMovement(direction))
     {
-        elog(ERROR, "mytam: only forward scans are supported");
+        return false;
     }
 
-    if (!scan->scan_started)
+    // A scan that starts backwards starts from the last key
+    if (!scan->scan_started && ScanDirectionIsBackward(direction))
     {
-        next_key = db_get_first_key(scan->table);
-        scan->scan_started = true;
-    }
-    else
-    {
-        next_key = db_get_next_row(scan->table, scan->current_key);
+        db_cursor_seek_last(scan->cursor);
     }
+    scan->scan_started = true;
 
-    if (next_key == -1)
+    // The cursor hands back the row data with the key, no second lookup
+    if (ScanDirectionIsBackward(direction))
+        found = db_cursor_prev(scan->cursor, &next_key, &data_ptr, &data_size);
+    else
+        found = db_cursor_next(scan->cursor, &next_key, &data_ptr, &data_size);
+    if (!found)
     {
         return false;
     }
-    scan->current_key = next_key;
-
-    data_ptr = db_get_row(scan->table, txn_id, next_key, &data_size);
-    if (!data_ptr)
-    {
-        return mytam_scan_getnextslot(sscan, direction, slot);
-    }
 
     ExecClearTuple(slot);
     tupDesc = slot->tts_tupleDescriptor;
@@ -160,6 +234,7 @@ mytam_scan_end(TableScanDesc sscan)
 {
     ereport(LOG, (errmsg("mytam: scan_end called")));
     MyTamScanDesc *scan = (MyTamScanDesc *)sscan;
+    db_cursor_close(scan->cursor);
     if (scan->table)
     {
         db_close_table(scan->table);
@@ -272,10 +347,21 @@ static void mytam_vacuum_relation(Relation relation, VacuumParams *params, Buffe
     if (relation)
     {
         long row_count = db_get_table_row_count(db_open_table(RelationGetRelationName(relation)));
-        ereport(LOG, (errmsg("mytam: vacuum found %ld live rows in \"%s\"", row_count, RelationGetRelationName(relation))));
+        ereport(LOG, (errmsg("mytam: vacuum found %ld rows (deleted ones not yet reclaimed included) in \"%s\"", row_count, RelationGetRelationName(relation))));
     }
 }
 
+// Planner size estimate from the backend's row count, which includes
+// deleted rows the collector has not reclaimed yet
+static void mytam_relation_estimate_size(Relation relation, int32 *attr_widths, BlockNumber *pages, double *tuples, double *allvisfrac)
+{
+    Table *table = db_open_table(RelationGetRelationName(relation));
+
+    *tuples = table ? (double)db_get_table_row_count(table) : 0;
+    *pages = *tuples > 0 ? 1 : 0;
+    *allvisfrac = 1.0;
+}
+
 static bool mytam_scan_analyze_next_block(TableScanDesc scan, BlockNumber blockno, BufferAccessStrategy bstrategy) { return false; }
 static bool mytam_scan_analyze_next_tuple(TableScanDesc scan, TransactionId OldestXmin, double *liverows, double *deadrows, TupleTableSlot *slot) { return false; }
 static IndexFetchTableData *mytam_index_fetch_begin(Relation relation)
@@ -308,6 +394,7 @@ static const TableAmRoutine mytam_routine = {
     .relation_vacuum = mytam_vacuum_relation,
     .scan_analyze_next_block = mytam_scan_analyze_next_block,
     .scan_analyze_next_tuple = mytam_scan_analyze_next_tuple,
+    .relation_estimate_size = mytam_relation_estimate_size,
     .index_fetch_begin = mytam_index_fetch_begin,
     .index_fetch_reset = mytam_index_fetch_reset,
     .index_fetch_end = mytam_index_fetch_end,
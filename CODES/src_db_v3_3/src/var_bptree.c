@@ -0,0 +1,743 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h> // SSE2 for the fingerprint scan
+#include "../include/var_bptree.h"
+#include "../include/mem_pool.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// Deeper than any tree of 16-way nodes can get
+#define VB_MAX_HEIGHT 32
+
+// The fingerprint scan loads one 16-byte vector per leaf
+#if VB_LEAF_KEYS != 16
+#error "VB_LEAF_KEYS must be 16 for the SSE2 fingerprint scan"
+#endif
+
+// Leaf node: one shared prefix plus a suffix per key, all in key_buf
+typedef struct VarLeaf
+{
+    bool is_leaf;                      // Always true
+    int num_keys;                      // Number of keys currently stored
+    uint8_t fingerprints[VB_LEAF_KEYS]; // One-byte hash of each full key
+    uint16_t prefix_len;               // Bytes shared by every key in the leaf
+    uint16_t suffix_off[VB_LEAF_KEYS]; // Offset of each suffix in key_buf
+    uint16_t suffix_len[VB_LEAF_KEYS]; // Length of each suffix
+    unsigned char *key_buf;            // Prefix, then the suffixes
+    void *data_ptrs[VB_LEAF_KEYS];     // Pointers to data in NVRAM
+    size_t data_sizes[VB_LEAF_KEYS];   // Size of each data item
+    struct VarLeaf *next_leaf;         // Next leaf (for range scans)
+    struct VarLeaf *prev_leaf;         // Previous leaf (for reverse scans)
+} VarLeaf;
+
+// Inner node: children[i] < seps[i] <= children[i + 1]
+typedef struct VarInner
+{
+    bool is_leaf;                      // Always false
+    int num_keys;                      // Number of separators
+    uint16_t sep_len[VB_INNER_KEYS];   // Length of each separator
+    unsigned char *seps[VB_INNER_KEYS]; // Separator bytes
+    void *children[VB_INNER_KEYS + 1]; // Child nodes
+} VarInner;
+
+// A key taken out of a leaf while it is being rebuilt
+typedef struct KeyItem
+{
+    const unsigned char *bytes;
+    size_t len;
+    void *data;
+    size_t size;
+} KeyItem;
+
+static MemPool leaf_pool;
+static MemPool inner_pool;
+
+// Leaf lookups and full-key comparisons made by this thread
+static __thread unsigned long leaf_lookups;
+static __thread unsigned long leaf_key_compares;
+
+// Set up / release the node pools (once per db_init / db_shutdown)
+void vbt_module_init(void)
+{
+    mem_pool_init(&leaf_pool, "vbt_leaf", sizeof(VarLeaf), true);
+    mem_pool_init(&inner_pool, "vbt_inner", sizeof(VarInner), true);
+}
+
+void vbt_module_shutdown(void)
+{
+    mem_pool_destroy(&leaf_pool);
+    mem_pool_destroy(&inner_pool);
+}
+
+static bool node_is_leaf(void *node)
+{
+    return ((VarLeaf *)node)->is_leaf;
+}
+
+static VarLeaf *alloc_leaf(void)
+{
+    VarLeaf *leaf = (VarLeaf *)mem_pool_alloc(&leaf_pool);
+    if (!leaf)
+        return NULL;
+    memset(leaf, 0, sizeof(VarLeaf));
+    leaf->is_leaf = true;
+    return leaf;
+}
+
+static void free_leaf(VarLeaf *leaf)
+{
+    free(leaf->key_buf);
+    mem_pool_free(&leaf_pool, leaf);
+}
+
+static VarInner *alloc_inner(void)
+{
+    VarInner *inner = (VarInner *)mem_pool_alloc(&inner_pool);
+    if (!inner)
+        return NULL;
+    memset(inner, 0, sizeof(VarInner));
+    return inner;
+}
+
+// Compare two byte strings (memcmp order, shorter first on ties)
+static int compare_bytes(const unsigned char *a, size_t a_len, const unsigned char *b, size_t b_len)
+{
+    size_t n = MIN(a_len, b_len);
+    int cmp = n ? memcmp(a, b, n) : 0;
+    if (cmp != 0)
+        return cmp;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+static size_t common_prefix(const unsigned char *a, size_t a_len, const unsigned char *b, size_t b_len)
+{
+    size_t n = MIN(a_len, b_len);
+    size_t i = 0;
+    while (i < n && a[i] == b[i])
+        i++;
+    return i;
+}
+
+// Index of the child that may hold key (number of separators <= key)
+static int inner_child_index(VarInner *inner, const unsigned char *key, size_t key_len)
+{
+    int lo = 0, hi = inner->num_keys;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (compare_bytes(inner->seps[mid], inner->sep_len[mid], key, key_len) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// First position in the leaf whose key is >= key; *found if it is equal.
+// The shared prefix is compared once, then only suffixes are searched.
+static int leaf_lower_bound(VarLeaf *leaf, const unsigned char *key, size_t key_len, bool *found)
+{
+    size_t p = leaf->prefix_len;
+    size_t n = MIN(p, key_len);
+    int cmp = n ? memcmp(leaf->key_buf, key, n) : 0;
+
+    *found = false;
+    if (leaf->num_keys == 0 || cmp > 0 || (cmp == 0 && key_len < p))
+        return 0;
+    if (cmp < 0)
+        return leaf->num_keys;
+
+    const unsigned char *rest = key + p;
+    size_t rest_len = key_len - p;
+    int lo = 0, hi = leaf->num_keys;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        leaf_key_compares++;
+        if (compare_bytes(leaf->key_buf + leaf->suffix_off[mid], leaf->suffix_len[mid], rest, rest_len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < leaf->num_keys)
+    {
+        leaf_key_compares++;
+        if (compare_bytes(leaf->key_buf + leaf->suffix_off[lo], leaf->suffix_len[lo], rest, rest_len) == 0)
+            *found = true;
+    }
+    return lo;
+}
+
+// One-byte hash of a full key (FNV-1a folded to 8 bits)
+static uint8_t key_fingerprint(const unsigned char *key, size_t key_len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < key_len; i++)
+    {
+        h ^= key[i];
+        h *= 16777619u;
+    }
+    return (uint8_t)(h ^ (h >> 8) ^ (h >> 16) ^ (h >> 24));
+}
+
+// Slot holding exactly key, or -1. The fingerprints of all slots are
+// matched at once, so only the (usually single) candidate is compared.
+static int leaf_find_exact(VarLeaf *leaf, const unsigned char *key, size_t key_len, uint8_t fingerprint)
+{
+    __m128i probe = _mm_set1_epi8((char)fingerprint);
+    __m128i slots = _mm_loadu_si128((const __m128i *)leaf->fingerprints);
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(probe, slots)) & ((1u << leaf->num_keys) - 1);
+    size_t p = leaf->prefix_len;
+
+    if (key_len < p || (p && memcmp(leaf->key_buf, key, p) != 0))
+        return -1;
+
+    while (mask)
+    {
+        int i = __builtin_ctz(mask);
+        leaf_key_compares++;
+        if (leaf->suffix_len[i] == key_len - p &&
+            memcmp(leaf->key_buf + leaf->suffix_off[i], key + p, key_len - p) == 0)
+            return i;
+        mask &= mask - 1;
+    }
+    return -1;
+}
+
+// Copy the full key at pos into out (prefix + suffix), returns its length
+static size_t leaf_key(VarLeaf *leaf, int pos, unsigned char *out, size_t out_cap)
+{
+    size_t p = leaf->prefix_len;
+    size_t len = p + leaf->suffix_len[pos];
+    size_t n = MIN(p, out_cap);
+
+    memcpy(out, leaf->key_buf, n);
+    if (out_cap > p)
+        memcpy(out + p, leaf->key_buf + leaf->suffix_off[pos], MIN(leaf->suffix_len[pos], out_cap - p));
+    return len;
+}
+
+// Expand every key of a leaf into scratch, leaving a hole at skip_pos
+// for the caller (pass -1 for no hole). Returns the number of items written.
+static int leaf_gather(VarLeaf *leaf, unsigned char *scratch, KeyItem *items, int skip_pos)
+{
+    int out = 0;
+    for (int i = 0; i < leaf->num_keys; i++)
+    {
+        if (out == skip_pos)
+            out++;
+        size_t len = leaf_key(leaf, i, scratch, VB_MAX_KEY_LEN);
+        items[out].bytes = scratch;
+        items[out].len = len;
+        items[out].data = leaf->data_ptrs[i];
+        items[out].size = leaf->data_sizes[i];
+        scratch += len;
+        out++;
+    }
+    return leaf->num_keys;
+}
+
+// Bytes needed to expand every key of a leaf
+static size_t leaf_expanded_bytes(VarLeaf *leaf)
+{
+    size_t total = (size_t)leaf->num_keys * leaf->prefix_len;
+    for (int i = 0; i < leaf->num_keys; i++)
+        total += leaf->suffix_len[i];
+    return total;
+}
+
+// Rewrite a leaf from sorted items. Keys are sorted, so the prefix shared
+// by the first and last key is shared by all of them.
+static bool leaf_fill(VarLeaf *leaf, const KeyItem *items, int n)
+{
+    size_t prefix = 0;
+    size_t total;
+    unsigned char *buf;
+
+    if (n > 0)
+        prefix = common_prefix(items[0].bytes, items[0].len, items[n - 1].bytes, items[n - 1].len);
+
+    total = prefix;
+    for (int i = 0; i < n; i++)
+        total += items[i].len - prefix;
+
+    buf = (unsigned char *)malloc(total ? total : 1);
+    if (!buf)
+        return false;
+
+    if (n > 0)
+        memcpy(buf, items[0].bytes, prefix);
+
+    size_t off = prefix;
+    for (int i = 0; i < n; i++)
+    {
+        size_t suffix = items[i].len - prefix;
+        memcpy(buf + off, items[i].bytes + prefix, suffix);
+        leaf->fingerprints[i] = key_fingerprint(items[i].bytes, items[i].len);
+        leaf->suffix_off[i] = (uint16_t)off;
+        leaf->suffix_len[i] = (uint16_t)suffix;
+        leaf->data_ptrs[i] = items[i].data;
+        leaf->data_sizes[i] = items[i].size;
+        off += suffix;
+    }
+
+    free(leaf->key_buf);
+    leaf->key_buf = buf;
+    leaf->prefix_len = (uint16_t)prefix;
+    leaf->num_keys = n;
+    return true;
+}
+
+// Add a separator and right child above a split, splitting full inner
+// nodes on the way up. spares holds enough preallocated inner nodes.
+static void insert_separator(VarBPTree *tree, VarInner **path, int *path_idx, int depth,
+                             unsigned char *sep, uint16_t sep_len, void *right, VarInner **spares)
+{
+    while (depth > 0)
+    {
+        depth--;
+        VarInner *parent = path[depth];
+        int idx = path_idx[depth];
+
+        if (parent->num_keys < VB_INNER_KEYS)
+        {
+            // Room here: shift and insert
+            for (int i = parent->num_keys; i > idx; i--)
+            {
+                parent->seps[i] = parent->seps[i - 1];
+                parent->sep_len[i] = parent->sep_len[i - 1];
+                parent->children[i + 1] = parent->children[i];
+            }
+            parent->seps[idx] = sep;
+            parent->sep_len[idx] = sep_len;
+            parent->children[idx + 1] = right;
+            parent->num_keys++;
+            return;
+        }
+
+        // Full: line up all separators and children, then split in half
+        unsigned char *seps[VB_INNER_KEYS + 1];
+        uint16_t lens[VB_INNER_KEYS + 1];
+        void *children[VB_INNER_KEYS + 2];
+        int total = VB_INNER_KEYS + 1;
+
+        for (int i = 0, j = 0; i < total; i++)
+        {
+            if (i == idx)
+            {
+                seps[i] = sep;
+                lens[i] = sep_len;
+                continue;
+            }
+            seps[i] = parent->seps[j];
+            lens[i] = parent->sep_len[j];
+            j++;
+        }
+        for (int i = 0, j = 0; i < total + 1; i++)
+        {
+            if (i == idx + 1)
+            {
+                children[i] = right;
+                continue;
+            }
+            children[i] = parent->children[j++];
+        }
+
+        int mid = total / 2;
+        VarInner *sibling = *spares++;
+
+        parent->num_keys = mid;
+        for (int i = 0; i < mid; i++)
+        {
+            parent->seps[i] = seps[i];
+            parent->sep_len[i] = lens[i];
+            parent->children[i] = children[i];
+        }
+        parent->children[mid] = children[mid];
+
+        sibling->num_keys = total - mid - 1;
+        for (int i = 0; i < sibling->num_keys; i++)
+        {
+            sibling->seps[i] = seps[mid + 1 + i];
+            sibling->sep_len[i] = lens[mid + 1 + i];
+            sibling->children[i] = children[mid + 1 + i];
+        }
+        sibling->children[sibling->num_keys] = children[total];
+
+        // The middle separator moves up
+        sep = seps[mid];
+        sep_len = lens[mid];
+        right = sibling;
+    }
+
+    // The root split: grow the tree by one level
+    VarInner *root = *spares;
+    root->num_keys = 1;
+    root->seps[0] = sep;
+    root->sep_len[0] = sep_len;
+    root->children[0] = tree->root;
+    root->children[1] = right;
+    tree->root = root;
+    tree->height++;
+}
+
+// Walk down to the leaf for key, recording the inner nodes passed
+static VarLeaf *descend(VarBPTree *tree, const unsigned char *key, size_t key_len,
+                        VarInner **path, int *path_idx, int *depth)
+{
+    void *node = tree->root;
+    *depth = 0;
+    while (!node_is_leaf(node))
+    {
+        VarInner *inner = (VarInner *)node;
+        int idx = inner_child_index(inner, key, key_len);
+        if (path)
+        {
+            path[*depth] = inner;
+            path_idx[*depth] = idx;
+        }
+        (*depth)++;
+        node = inner->children[idx];
+    }
+    return (VarLeaf *)node;
+}
+
+VarBPTree *vbt_create(void)
+{
+    VarBPTree *tree = (VarBPTree *)malloc(sizeof(VarBPTree));
+    if (!tree)
+        return NULL;
+
+    tree->root = alloc_leaf();
+    if (!tree->root)
+    {
+        free(tree);
+        return NULL;
+    }
+    tree->height = 1;
+    tree->size = 0;
+    pthread_rwlock_init(&tree->latch, NULL);
+    return tree;
+}
+
+static void destroy_rec(void *node)
+{
+    if (node_is_leaf(node))
+    {
+        free_leaf((VarLeaf *)node);
+        return;
+    }
+
+    VarInner *inner = (VarInner *)node;
+    for (int i = 0; i < inner->num_keys; i++)
+        free(inner->seps[i]);
+    for (int i = 0; i <= inner->num_keys; i++)
+        destroy_rec(inner->children[i]);
+    mem_pool_free(&inner_pool, inner);
+}
+
+void vbt_destroy(VarBPTree *tree)
+{
+    if (!tree)
+        return;
+    destroy_rec(tree->root);
+    pthread_rwlock_destroy(&tree->latch);
+    free(tree);
+}
+
+bool vbt_search(VarBPTree *tree, const unsigned char *key, size_t key_len, void **data, size_t *size)
+{
+    int depth;
+    uint8_t fingerprint = key_fingerprint(key, key_len);
+
+    leaf_lookups++;
+    pthread_rwlock_rdlock(&tree->latch);
+    VarLeaf *leaf = descend(tree, key, key_len, NULL, NULL, &depth);
+    int pos = leaf_find_exact(leaf, key, key_len, fingerprint);
+    if (pos >= 0)
+    {
+        if (data)
+            *data = leaf->data_ptrs[pos];
+        if (size)
+            *size = leaf->data_sizes[pos];
+    }
+    pthread_rwlock_unlock(&tree->latch);
+    return pos >= 0;
+}
+
+bool vbt_insert(VarBPTree *tree, const unsigned char *key, size_t key_len, void *data, size_t size)
+{
+    VarInner *path[VB_MAX_HEIGHT];
+    int path_idx[VB_MAX_HEIGHT];
+    int depth;
+    bool found;
+
+    if (key_len > VB_MAX_KEY_LEN)
+    {
+        printf("Error: Key of %zu bytes exceeds the %d byte limit\n", key_len, VB_MAX_KEY_LEN);
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&tree->latch);
+
+    VarLeaf *leaf = descend(tree, key, key_len, path, path_idx, &depth);
+    int pos = leaf_lower_bound(leaf, key, key_len, &found);
+    if (found)
+    {
+        pthread_rwlock_unlock(&tree->latch);
+        return false;
+    }
+
+    // Expand the leaf with the new key in place
+    KeyItem items[VB_LEAF_KEYS + 1];
+    unsigned char *scratch = (unsigned char *)malloc(leaf_expanded_bytes(leaf) + 1);
+    if (!scratch)
+    {
+        pthread_rwlock_unlock(&tree->latch);
+        return false;
+    }
+    int n = leaf_gather(leaf, scratch, items, pos) + 1;
+    items[pos].bytes = key;
+    items[pos].len = key_len;
+    items[pos].data = data;
+    items[pos].size = size;
+
+    if (n <= VB_LEAF_KEYS)
+    {
+        bool ok = leaf_fill(leaf, items, n);
+        if (ok)
+            tree->size++;
+        free(scratch);
+        pthread_rwlock_unlock(&tree->latch);
+        return ok;
+    }
+
+    // Split. Reserve every inner node the split can need before changing
+    // anything: one per full ancestor, plus a new root if all are full.
+    VarInner *spares[VB_MAX_HEIGHT + 1];
+    int needed = 0;
+    while (needed < depth && path[depth - 1 - needed]->num_keys == VB_INNER_KEYS)
+        needed++;
+    if (needed == depth)
+        needed++;
+
+    int left_n = (n + 1) / 2;
+    int allocated = 0;
+    VarLeaf *right = alloc_leaf();
+    // Shortest prefix of the right half's first key that is above the left half
+    size_t sep_len = common_prefix(items[left_n - 1].bytes, items[left_n - 1].len,
+                                   items[left_n].bytes, items[left_n].len) + 1;
+    unsigned char *sep = (unsigned char *)malloc(sep_len);
+
+    while (allocated < needed && (spares[allocated] = alloc_inner()) != NULL)
+        allocated++;
+
+    if (!right || !sep || allocated < needed ||
+        !leaf_fill(right, items + left_n, n - left_n) ||
+        !leaf_fill(leaf, items, left_n))
+    {
+        printf("Error: Out of memory splitting a leaf\n");
+        if (right)
+            free_leaf(right);
+        free(sep);
+        for (int i = 0; i < allocated; i++)
+            mem_pool_free(&inner_pool, spares[i]);
+        free(scratch);
+        pthread_rwlock_unlock(&tree->latch);
+        return false;
+    }
+
+    memcpy(sep, items[left_n].bytes, sep_len);
+    free(scratch);
+
+    right->next_leaf = leaf->next_leaf;
+    right->prev_leaf = leaf;
+    if (leaf->next_leaf)
+        leaf->next_leaf->prev_leaf = right;
+    leaf->next_leaf = right;
+    tree->size++;
+
+    insert_separator(tree, path, path_idx, depth, sep, (uint16_t)sep_len, right, spares);
+
+    pthread_rwlock_unlock(&tree->latch);
+    return true;
+}
+
+// Unlink an emptied leaf and drop it from its ancestors
+static void remove_leaf(VarBPTree *tree, VarLeaf *leaf, VarInner **path, int *path_idx, int depth)
+{
+    if (leaf->prev_leaf)
+        leaf->prev_leaf->next_leaf = leaf->next_leaf;
+    if (leaf->next_leaf)
+        leaf->next_leaf->prev_leaf = leaf->prev_leaf;
+    free_leaf(leaf);
+
+    // Remove the child slot, freeing inner nodes left without children
+    for (int level = depth - 1; level >= 0; level--)
+    {
+        VarInner *parent = path[level];
+        int idx = path_idx[level];
+
+        if (parent->num_keys == 0)
+        {
+            mem_pool_free(&inner_pool, parent);
+            continue;
+        }
+
+        int sep_idx = idx > 0 ? idx - 1 : 0;
+        free(parent->seps[sep_idx]);
+        for (int i = sep_idx; i < parent->num_keys - 1; i++)
+        {
+            parent->seps[i] = parent->seps[i + 1];
+            parent->sep_len[i] = parent->sep_len[i + 1];
+        }
+        for (int i = idx; i < parent->num_keys; i++)
+            parent->children[i] = parent->children[i + 1];
+        parent->num_keys--;
+        break;
+    }
+
+    // Collapse roots that are down to a single child
+    while (!node_is_leaf(tree->root) && ((VarInner *)tree->root)->num_keys == 0)
+    {
+        VarInner *old_root = (VarInner *)tree->root;
+        tree->root = old_root->children[0];
+        mem_pool_free(&inner_pool, old_root);
+        tree->height--;
+    }
+}
+
+bool vbt_delete(VarBPTree *tree, const unsigned char *key, size_t key_len, void **data, size_t *size)
+{
+    VarInner *path[VB_MAX_HEIGHT];
+    int path_idx[VB_MAX_HEIGHT];
+    int depth;
+    uint8_t fingerprint = key_fingerprint(key, key_len);
+
+    leaf_lookups++;
+    pthread_rwlock_wrlock(&tree->latch);
+
+    VarLeaf *leaf = descend(tree, key, key_len, path, path_idx, &depth);
+    int pos = leaf_find_exact(leaf, key, key_len, fingerprint);
+    if (pos < 0)
+    {
+        pthread_rwlock_unlock(&tree->latch);
+        return false;
+    }
+
+    if (data)
+        *data = leaf->data_ptrs[pos];
+    if (size)
+        *size = leaf->data_sizes[pos];
+
+    if (leaf->num_keys == 1 && depth > 0)
+    {
+        remove_leaf(tree, leaf, path, path_idx, depth);
+    }
+    else
+    {
+        // Drop the slot; its suffix bytes stay in key_buf until the next rebuild
+        for (int i = pos; i < leaf->num_keys - 1; i++)
+        {
+            leaf->fingerprints[i] = leaf->fingerprints[i + 1];
+            leaf->suffix_off[i] = leaf->suffix_off[i + 1];
+            leaf->suffix_len[i] = leaf->suffix_len[i + 1];
+            leaf->data_ptrs[i] = leaf->data_ptrs[i + 1];
+            leaf->data_sizes[i] = leaf->data_sizes[i + 1];
+        }
+        leaf->num_keys--;
+    }
+
+    tree->size--;
+    pthread_rwlock_unlock(&tree->latch);
+    return true;
+}
+
+bool vbt_seek(VarBPTree *tree, const unsigned char *key, size_t key_len, bool inclusive,
+              unsigned char *out_key, size_t out_cap, size_t *out_len)
+{
+    int depth;
+    bool found;
+
+    pthread_rwlock_rdlock(&tree->latch);
+
+    VarLeaf *leaf = descend(tree, key, key_len, NULL, NULL, &depth);
+    int pos = leaf_lower_bound(leaf, key, key_len, &found);
+    if (found && !inclusive)
+        pos++;
+
+    while (leaf && pos >= leaf->num_keys)
+    {
+        leaf = leaf->next_leaf;
+        pos = 0;
+    }
+
+    if (leaf)
+    {
+        size_t len = leaf_key(leaf, pos, out_key, out_cap);
+        if (out_len)
+            *out_len = len;
+    }
+
+    pthread_rwlock_unlock(&tree->latch);
+    return leaf != NULL;
+}
+
+bool vbt_seek_prev(VarBPTree *tree, const unsigned char *key, size_t key_len, bool inclusive,
+                   unsigned char *out_key, size_t out_cap, size_t *out_len)
+{
+    VarLeaf *leaf;
+    int pos;
+
+    pthread_rwlock_rdlock(&tree->latch);
+
+    if (key)
+    {
+        int depth;
+        bool found;
+        leaf = descend(tree, key, key_len, NULL, NULL, &depth);
+        pos = leaf_lower_bound(leaf, key, key_len, &found);
+        if (!(found && inclusive))
+            pos--;
+    }
+    else
+    {
+        // Rightmost leaf
+        void *node = tree->root;
+        while (!node_is_leaf(node))
+            node = ((VarInner *)node)->children[((VarInner *)node)->num_keys];
+        leaf = (VarLeaf *)node;
+        pos = leaf->num_keys - 1;
+    }
+
+    while (leaf && pos < 0)
+    {
+        leaf = leaf->prev_leaf;
+        pos = leaf ? leaf->num_keys - 1 : -1;
+    }
+
+    if (leaf)
+    {
+        size_t len = leaf_key(leaf, pos, out_key, out_cap);
+        if (out_len)
+            *out_len = len;
+    }
+
+    pthread_rwlock_unlock(&tree->latch);
+    return leaf != NULL;
+}
+
+void vbt_lookup_stats(unsigned long *lookups, unsigned long *key_compares)
+{
+    if (lookups)
+        *lookups = leaf_lookups;
+    if (key_compares)
+        *key_compares = leaf_key_compares;
+}
+
+long vbt_size(VarBPTree *tree)
+{
+    return tree ? tree->size : 0;
+}
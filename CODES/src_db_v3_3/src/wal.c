@@ -26,19 +26,51 @@ void atomic_write_64(void *dest, uint64_t val)
     _mm_sfence(); // Ensure the write is committed
 }
 
-WALTable *wal_tables[MAX_TABLES] = {NULL};
+// WAL streams by id, in chunks that never move once published, so the
+// append and commit paths find a stream without a directory lock
+#define WAL_CHUNK 256
+#define WAL_CHUNKS (MAX_WAL_TABLES / WAL_CHUNK)
+
+static WALTable **wal_chunks[WAL_CHUNKS];
+static pthread_mutex_t wal_dir_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static WALTable *get_wal_table(int table_id)
+{
+    if (table_id < 0 || table_id >= MAX_WAL_TABLES)
+        return NULL;
+
+    WALTable **chunk = __atomic_load_n(&wal_chunks[table_id / WAL_CHUNK], __ATOMIC_ACQUIRE);
+    if (!chunk)
+        return NULL;
+    return __atomic_load_n(&chunk[table_id % WAL_CHUNK], __ATOMIC_ACQUIRE);
+}
 
 int wal_create_table(int table_id, void *memory_ptr)
 {
     WALTable *new_table;
-    if (table_id < 0 || table_id >= MAX_TABLES)
+    if (table_id < 0 || table_id >= MAX_WAL_TABLES)
     {
         printf("Error: Invalid table ID %d.\n", table_id);
         return 0;
     }
 
-    if (wal_tables[table_id] != NULL)
+    pthread_mutex_lock(&wal_dir_mutex);
+    WALTable **chunk = wal_chunks[table_id / WAL_CHUNK];
+    if (!chunk)
+    {
+        chunk = (WALTable **)calloc(WAL_CHUNK, sizeof(WALTable *));
+        if (!chunk)
+        {
+            pthread_mutex_unlock(&wal_dir_mutex);
+            printf("Error: Failed to allocate WAL directory.\n");
+            return 0;
+        }
+        __atomic_store_n(&wal_chunks[table_id / WAL_CHUNK], chunk, __ATOMIC_RELEASE);
+    }
+
+    if (chunk[table_id % WAL_CHUNK] != NULL)
     {
+        pthread_mutex_unlock(&wal_dir_mutex);
         printf("Error: WAL Table ID %d already exists.\n", table_id);
         return 0;
     }
@@ -56,44 +88,33 @@ int wal_create_table(int table_id, void *memory_ptr)
     // Ensure WAL table data is persisted to NVRAM
     flush_range(new_table, sizeof(WALTable));
 
-    wal_tables[table_id] = new_table;
+    __atomic_store_n(&chunk[table_id % WAL_CHUNK], new_table, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&wal_dir_mutex);
     return 1;
 }
 
-int wal_add_entry(int table_id, int key, void *data_ptr, int op, void *entry_ptr, size_t data_size)
+// Fill in an entry (not yet linked or flushed)
+void wal_fill_entry(void *entry_ptr, int key, const void *key_bytes, size_t key_len, void *data_ptr, int op, size_t data_size)
 {
-    WALTable *table;
-    WALEntry *entry;
-    WALEntry *old_tail;
-
-    if (table_id < 0 || table_id >= MAX_TABLES || wal_tables[table_id] == NULL)
-    {
-        printf("Error: WAL Table %d not found.\n", table_id);
-        return 0;
-    }
-
-    table = wal_tables[table_id];
-
-    // Lock the WAL table mutex
-    pthread_mutex_lock(&table->mutex);
-
-    // Create WAL entry in allocated NVRAM space
-    entry = (WALEntry *)entry_ptr;
+    WALEntry *entry = (WALEntry *)entry_ptr;
     entry->key = key;
     entry->data_ptr = data_ptr;
     entry->op_flag = op;
     entry->data_size = data_size;
     entry->next = NULL;
+    entry->key_len = (uint32_t)key_len;
+    if (key_len > 0)
+        memcpy(entry->key_bytes, key_bytes, key_len);
+}
 
-    // First, persist the entry content
-    flush_range(entry, sizeof(WALEntry));
-
-    // Add to the end of the linked list
+// Append a chain of persisted entries (caller holds the table mutex)
+static void link_entries(WALTable *table, WALEntry *first, WALEntry *last)
+{
     if (table->entry_tail == NULL)
     {
         // First entry in the list
-        table->entry_head = entry;
-        table->entry_tail = entry;
+        table->entry_head = first;
+        __atomic_store_n(&table->entry_tail, last, __ATOMIC_RELEASE);
 
         // Persist head and tail pointers
         flush_range(&table->entry_head, sizeof(void *));
@@ -102,38 +123,100 @@ int wal_add_entry(int table_id, int key, void *data_ptr, int op, void *entry_ptr
     else
     {
         // Append to existing list
-        old_tail = table->entry_tail;
-        old_tail->next = entry;
+        WALEntry *old_tail = table->entry_tail;
+        old_tail->next = first;
 
         // First persist the next pointer of the old tail
         flush_range(&old_tail->next, sizeof(void *));
 
-        // Then update the tail pointer
-        table->entry_tail = entry;
+        // Then update the tail pointer (read without the mutex at commit)
+        __atomic_store_n(&table->entry_tail, last, __ATOMIC_RELEASE);
         flush_range(&table->entry_tail, sizeof(void *));
     }
+}
+
+// Shared by both key forms; entry_ptr must hold WAL_ENTRY_SIZE(key_len) bytes
+static int add_entry(int table_id, int key, const void *key_bytes, size_t key_len,
+                     void *data_ptr, int op, void *entry_ptr, size_t data_size)
+{
+    WALTable *table = get_wal_table(table_id);
+    WALEntry *entry;
+
+    if (table == NULL)
+    {
+        printf("Error: WAL Table %d not found.\n", table_id);
+        return 0;
+    }
+
+    // Lock the WAL table mutex
+    pthread_mutex_lock(&table->mutex);
+
+    // Create WAL entry in allocated NVRAM space
+    entry = (WALEntry *)entry_ptr;
+    wal_fill_entry(entry, key, key_bytes, key_len, data_ptr, op, data_size);
+
+    // First, persist the entry content
+    flush_range(entry, WAL_ENTRY_SIZE(key_len));
+
+    link_entries(table, entry, entry);
 
     // Unlock the WAL table mutex
     pthread_mutex_unlock(&table->mutex);
     return 1;
 }
 
+int wal_add_entry(int table_id, int key, void *data_ptr, int op, void *entry_ptr, size_t data_size)
+{
+    return add_entry(table_id, key, NULL, 0, data_ptr, op, entry_ptr, data_size);
+}
+
+int wal_add_entry_bytes(int table_id, const void *key, size_t key_len, void *data_ptr, int op, void *entry_ptr, size_t data_size)
+{
+    return add_entry(table_id, 0, key, key_len, data_ptr, op, entry_ptr, data_size);
+}
+
+// Link a chain of entries that are already filled and persisted
+int wal_append_batch(int table_id, WALEntry *first, WALEntry *last)
+{
+    WALTable *table = get_wal_table(table_id);
+    if (table == NULL)
+    {
+        printf("Error: WAL Table %d not found.\n", table_id);
+        return 0;
+    }
+
+    pthread_mutex_lock(&table->mutex);
+    link_entries(table, first, last);
+    pthread_mutex_unlock(&table->mutex);
+    return 1;
+}
+
 void wal_advance_commit_ptr(int table_id, int txn_id)
 {
-    WALTable *table;
-    if (table_id < 0 || table_id >= MAX_TABLES || wal_tables[table_id] == NULL)
+    WALTable *table = get_wal_table(table_id);
+    if (table == NULL)
     {
         printf("Error: WAL Table %d not found.\n", table_id);
         return;
     }
 
-    table = wal_tables[table_id];
+    // Nothing new since the last commit: skip the mutex. This thread's own
+    // appends happened before this call, so they are visible here.
+    if (__atomic_load_n(&table->commit_ptr, __ATOMIC_ACQUIRE) == __atomic_load_n(&table->entry_tail, __ATOMIC_ACQUIRE))
+        return;
 
     // Lock the WAL table mutex
     pthread_mutex_lock(&table->mutex);
 
+    // Nothing logged since the last commit (common with many partitions)
+    if (table->commit_ptr == table->entry_tail)
+    {
+        pthread_mutex_unlock(&table->mutex);
+        return;
+    }
+
     // Update commit pointer to current tail (last entry)
-    table->commit_ptr = table->entry_tail;
+    __atomic_store_n(&table->commit_ptr, table->entry_tail, __ATOMIC_RELEASE);
 
     // Use atomic write for the commit pointer update
     atomic_write_64(&table->commit_ptr, (uint64_t)table->entry_tail);
@@ -145,17 +228,16 @@ void wal_advance_commit_ptr(int table_id, int txn_id)
 void wal_show_data(void)
 {
     int i;
-    for (i = 0; i < MAX_TABLES; i++)
+    for (i = 0; i < MAX_WAL_TABLES; i++)
     {
         WALTable *table;
         WALEntry *current;
         int entry_count = 0;
 
-        if (wal_tables[i] == NULL)
+        table = get_wal_table(i);
+        if (table == NULL)
             continue;
 
-        table = wal_tables[i];
-
         // Lock the WAL table mutex before reading
         pthread_mutex_lock(&table->mutex);
 
@@ -167,9 +249,13 @@ void wal_show_data(void)
 
         while (current != NULL)
         {
-            printf("Entry %d: Key: %d | Operation: %s | Data: %s | Size: %zu | %s\n",
-                   entry_count++,
-                   current->key,
+            if (current->key_len > 0)
+                printf("Entry %d: Key: '%.*s'", entry_count, (int)current->key_len, (char *)current->key_bytes);
+            else
+                printf("Entry %d: Key: %d", entry_count, current->key);
+            entry_count++;
+
+            printf(" | Operation: %s | Data: %s | Size: %zu | %s\n",
                    current->op_flag ? "Add" : "Delete",
                    (char *)current->data_ptr,
                    current->data_size,
@@ -181,4 +267,15 @@ void wal_show_data(void)
         // Unlock the WAL table mutex after reading
         pthread_mutex_unlock(&table->mutex);
     }
-}
\ No newline at end of file
+}
+
+void wal_shutdown(void)
+{
+    pthread_mutex_lock(&wal_dir_mutex);
+    for (int i = 0; i < WAL_CHUNKS; i++)
+    {
+        free(wal_chunks[i]);
+        wal_chunks[i] = NULL;
+    }
+    pthread_mutex_unlock(&wal_dir_mutex);
+}
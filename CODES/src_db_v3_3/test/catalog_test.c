@@ -0,0 +1,117 @@
+#include <string.h>
+#include <pthread.h>
+#include "test_check.h"
+
+// The table catalog under concurrent creates and lookups: creator threads
+// add thousands of tables (growing the catalog several times) while
+// reader threads open every table already published, by name and by id.
+// No lookup of a published table may fail.
+
+#define CREATORS 4
+#define READERS 4
+#define TABLES_PER_CREATOR 750
+
+static int ids[CREATORS][TABLES_PER_CREATOR];
+static int created[CREATORS];  // Tables of each creator published so far
+static int creators_running = CREATORS;
+static int duplicate_wins = 0; // Creators whose create of the shared name succeeded
+static pthread_barrier_t start;
+
+static void table_name(char *name, size_t size, int creator, int i)
+{
+    snprintf(name, size, "catalog_%d_%d", creator, i);
+}
+
+static void *creator(void *arg)
+{
+    int c = (int)(long)arg;
+    char name[64];
+
+    // All creators race for one name first; only one may get it
+    pthread_barrier_wait(&start);
+    if (db_create_table("catalog_shared") >= 0)
+        __atomic_add_fetch(&duplicate_wins, 1, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < TABLES_PER_CREATOR; i++)
+    {
+        table_name(name, sizeof(name), c, i);
+        ids[c][i] = db_create_table(name);
+        CHECK(ids[c][i] >= 0);
+        __atomic_store_n(&created[c], i + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_sub_fetch(&creators_running, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Open a published table both ways and check they agree
+static void check_table(int c, int i)
+{
+    char name[64];
+    table_name(name, sizeof(name), c, i);
+
+    Table *by_name = db_open_table(name);
+    Table *by_id = db_open_table_by_id(ids[c][i]);
+    CHECK(by_name != NULL);
+    CHECK(by_name == by_id);
+    CHECK(db_table_id(by_name) == ids[c][i]);
+}
+
+static void *reader(void *arg)
+{
+    unsigned seed = (unsigned)(long)arg;
+    long lookups = 0;
+
+    pthread_barrier_wait(&start);
+    while (__atomic_load_n(&creators_running, __ATOMIC_ACQUIRE) > 0)
+    {
+        int c = rand_r(&seed) % CREATORS;
+        int n = __atomic_load_n(&created[c], __ATOMIC_ACQUIRE);
+        if (n == 0)
+            continue;
+
+        // The newest table, just published, and an older one
+        check_table(c, n - 1);
+        check_table(c, rand_r(&seed) % n);
+        lookups += 2;
+    }
+    return (void *)lookups;
+}
+
+int main()
+{
+    pthread_t threads[CREATORS + READERS];
+    long lookups = 0;
+
+    db_init();
+    pthread_barrier_init(&start, NULL, CREATORS + READERS);
+    for (long i = 0; i < CREATORS; i++)
+        pthread_create(&threads[i], NULL, creator, (void *)i);
+    for (long i = 0; i < READERS; i++)
+        pthread_create(&threads[CREATORS + i], NULL, reader, (void *)(i + 1));
+
+    for (int i = 0; i < CREATORS + READERS; i++)
+    {
+        void *result;
+        pthread_join(threads[i], &result);
+        if (i >= CREATORS)
+            lookups += (long)result;
+    }
+    pthread_barrier_destroy(&start);
+
+    // Every table is there afterwards, under an id of its own
+    CHECK(duplicate_wins == 1);
+    for (int c = 0; c < CREATORS; c++)
+    {
+        for (int i = 0; i < TABLES_PER_CREATOR; i++)
+        {
+            check_table(c, i);
+            for (int d = 0; d <= c; d++)
+                for (int j = 0; j < (d == c ? i : TABLES_PER_CREATOR); j++)
+                    CHECK(ids[d][j] != ids[c][i]);
+        }
+    }
+    db_shutdown();
+
+    printf("%d tables, %ld concurrent lookups\n", CREATORS * TABLES_PER_CREATOR + 1, lookups);
+    return test_report();
+}
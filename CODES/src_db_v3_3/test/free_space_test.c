@@ -0,0 +1,165 @@
+#include <string.h>
+#include "../include/free_space.h"
+#include "test_check.h"
+
+// The NVRAM allocator on its own: exact-size reuse from the size lists,
+// no two live blocks overlapping (and none losing its contents) under a
+// random mix of sizes, and freed small blocks merging back so a large
+// request still fits once they are all free.
+
+#define BLOCKS 20000
+#define ROUNDS 5
+#define FILL_SIZE 4096 // One size class: freed blocks stay on a size list
+
+typedef struct
+{
+    char *ptr;
+    size_t size;
+} Block;
+
+static int compare_blocks(const void *a, const void *b)
+{
+    const char *x = ((const Block *)a)->ptr, *y = ((const Block *)b)->ptr;
+    return (x > y) - (x < y);
+}
+
+// Sizes rows and WAL entries come in (whole lines), odd ones and a few
+// larger than any size class
+static size_t random_size(unsigned *seed)
+{
+    switch (rand_r(seed) % 4)
+    {
+    case 0:
+    case 1:
+        return (size_t)(1 + rand_r(seed) % 64) * 64;
+    case 2:
+        return 1 + rand_r(seed) % 5000;
+    default:
+        return 4096 + rand_r(seed) % 100000;
+    }
+}
+
+static void fill(Block *b, int i)
+{
+    memset(b->ptr, i & 0xff, b->size);
+}
+
+static bool intact(const Block *b, int i)
+{
+    for (size_t j = 0; j < b->size; j++)
+    {
+        if ((unsigned char)b->ptr[j] != (i & 0xff))
+            return false;
+    }
+    return true;
+}
+
+// A freed block of a size class is the next one handed out at that size
+static void test_exact_reuse(void)
+{
+    void *a = allocate_memory(128);
+    void *b = allocate_memory(128);
+    CHECK(a && b && a != b);
+    free_memory(a, 128);
+    CHECK(allocate_memory(128) == a);
+    free_memory(a, 128);
+    free_memory(b, 128);
+}
+
+// Allocate and free a random mix, checking after each round that the
+// live blocks are disjoint and keep what was written to them
+static void test_random_mix(void)
+{
+    Block *blocks = (Block *)calloc(BLOCKS, sizeof(Block));
+    Block *sorted = (Block *)malloc(sizeof(Block) * BLOCKS);
+    unsigned seed = 42;
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (int i = 0; i < BLOCKS; i++)
+        {
+            if (blocks[i].ptr)
+                continue;
+            blocks[i].size = random_size(&seed);
+            blocks[i].ptr = (char *)allocate_memory(blocks[i].size);
+            CHECK(blocks[i].ptr != NULL);
+            if (blocks[i].ptr)
+                fill(&blocks[i], i);
+        }
+
+        int live = 0;
+        for (int i = 0; i < BLOCKS; i++)
+        {
+            if (blocks[i].ptr)
+            {
+                CHECK(intact(&blocks[i], i));
+                sorted[live++] = blocks[i];
+            }
+        }
+        qsort(sorted, live, sizeof(Block), compare_blocks);
+        for (int i = 1; i < live; i++)
+            CHECK(sorted[i - 1].ptr + sorted[i - 1].size <= sorted[i].ptr);
+
+        // Free about half for the next round
+        for (int i = 0; i < BLOCKS; i++)
+        {
+            if (blocks[i].ptr && rand_r(&seed) % 2)
+            {
+                free_memory(blocks[i].ptr, blocks[i].size);
+                blocks[i].ptr = NULL;
+            }
+        }
+    }
+
+    for (int i = 0; i < BLOCKS; i++)
+    {
+        if (blocks[i].ptr)
+            free_memory(blocks[i].ptr, blocks[i].size);
+    }
+    free(sorted);
+    free(blocks);
+}
+
+// With everything freed, the whole space is one block again for a request
+// that needs it, even while most of it sits on the size lists
+static void check_whole_space(void)
+{
+    void *all = allocate_memory(FILESIZE);
+    CHECK(all != NULL);
+    if (all)
+        free_memory(all, FILESIZE);
+}
+
+// Fill all of NVRAM with small blocks, then free them onto a size list
+static void test_merge_back(void)
+{
+    size_t max = FILESIZE / FILL_SIZE;
+    void **ptrs = (void **)malloc(sizeof(void *) * max);
+    size_t n = 0;
+
+    check_whole_space();
+    while (n < max && (ptrs[n] = allocate_memory(FILL_SIZE)) != NULL)
+        n++;
+    CHECK(n == max);
+    CHECK(allocate_memory(FILL_SIZE) == NULL);
+
+    for (size_t i = 0; i < n; i++)
+        free_memory(ptrs[i], FILL_SIZE);
+    check_whole_space();
+    free(ptrs);
+}
+
+int main()
+{
+    init_free_space();
+
+    printf("=== exact-size reuse ===\n");
+    test_exact_reuse();
+    printf("=== random mix ===\n");
+    test_random_mix();
+    printf("=== merge back ===\n");
+    test_merge_back();
+
+    cleanup_free_space();
+    return test_report();
+}
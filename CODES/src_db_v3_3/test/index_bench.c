@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/ram_bptree.h"
+#include "../include/free_space.h"
+#include "../include/wal.h"
+#include "../include/lock_manager.h"
+#include "../include/var_bptree.h"
+
+// Head-to-head benchmark of the table indexes through the
+// public row API: dense inserts, random point lookups, a full ordered
+// scan (key by key, then with a cursor) and deletes, all inside one
+// transaction per phase.
+
+#define DEFAULT_ROWS 20000
+#define ROW_SIZE 64
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Anonymous resident memory of this process in kB (index nodes live here)
+static long rss_anon_kb()
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = 0;
+
+    if (!f)
+        return 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, "RssAnon:", 8) == 0)
+            kb = atol(line + 8);
+    }
+    fclose(f);
+    return kb;
+}
+
+static void run(const char *label, IndexType index_type, int rows)
+{
+    char name[32];
+    char data[ROW_SIZE];
+    double start;
+    long rss_before = rss_anon_kb();
+
+    snprintf(name, sizeof(name), "bench_%s", label);
+    if (db_create_table_with_index(name, index_type) < 0)
+    {
+        printf("Failed to create table %s\n", name);
+        return;
+    }
+    Table *table = db_open_table(name);
+
+    // Insert dense keys
+    int txn_id = db_begin_transaction();
+    start = now_seconds();
+    for (int key = 0; key < rows; key++)
+    {
+        snprintf(data, sizeof(data), "row %d", key);
+        db_put_row(table, txn_id, key, data, strlen(data) + 1);
+    }
+    double insert_time = now_seconds() - start;
+    db_commit_transaction(txn_id);
+    long rss_after = rss_anon_kb();
+
+    // Random point lookups
+    txn_id = db_begin_transaction();
+    srand(42);
+    int found = 0;
+    start = now_seconds();
+    for (int i = 0; i < rows; i++)
+    {
+        size_t size;
+        if (db_get_row(table, txn_id, rand() % rows, &size))
+            found++;
+    }
+    double lookup_time = now_seconds() - start;
+    db_commit_transaction(txn_id);
+
+    // Ordered scan
+    int scanned = 0;
+    start = now_seconds();
+    for (int key = db_get_first_key(table); key != -1; key = db_get_next_row(table, key))
+        scanned++;
+    double scan_time = now_seconds() - start;
+
+    // Same scan through a cursor
+    DbCursor *cursor = db_cursor_open(table);
+    int cursor_scanned = 0;
+    start = now_seconds();
+    while (db_cursor_next(cursor, NULL, NULL, NULL))
+        cursor_scanned++;
+    double cursor_time = now_seconds() - start;
+    db_cursor_close(cursor);
+
+    // Delete everything
+    txn_id = db_begin_transaction();
+    start = now_seconds();
+    for (int key = 0; key < rows; key++)
+        db_delete_row(table, txn_id, key);
+    double delete_time = now_seconds() - start;
+    db_commit_transaction(txn_id);
+
+    printf("%-8s insert %10.0f ops/s | lookup %10.0f ops/s (%d found) | scan %10.0f keys/s (%d) | cursor %10.0f keys/s (%d) | delete %10.0f ops/s | +%ld kB RSS\n",
+           label, rows / insert_time, rows / lookup_time, found, scanned / scan_time, scanned,
+           cursor_scanned / cursor_time, cursor_scanned, rows / delete_time, rss_after - rss_before);
+
+    db_close_table(table);
+}
+
+// YCSB-style string keys ("user" + 19 digits) on a VARKEY table, reporting
+// how many full keys each point lookup compared in the leaves
+static void run_string_keys(int rows)
+{
+    char key[32];
+    char data[ROW_SIZE];
+    unsigned long lookups_before, compares_before, lookups_after, compares_after;
+
+    if (db_create_table_with_index("bench_strkeys", INDEX_VARKEY) < 0)
+        return;
+    Table *table = db_open_table("bench_strkeys");
+
+    int txn_id = db_begin_transaction();
+    for (int i = 0; i < rows; i++)
+    {
+        snprintf(key, sizeof(key), "user%019llu", (unsigned long long)i * 0x9E3779B97F4A7C15ULL % 10000000000000000000ULL);
+        snprintf(data, sizeof(data), "row %d", i);
+        db_put_row_bytes(table, txn_id, key, strlen(key), data, strlen(data) + 1);
+    }
+    db_commit_transaction(txn_id);
+
+    txn_id = db_begin_transaction();
+    srand(42);
+    int found = 0;
+    vbt_lookup_stats(&lookups_before, &compares_before);
+    double start = now_seconds();
+    for (int i = 0; i < rows; i++)
+    {
+        size_t size;
+        unsigned long long k = (unsigned long long)(rand() % rows);
+        snprintf(key, sizeof(key), "user%019llu", k * 0x9E3779B97F4A7C15ULL % 10000000000000000000ULL);
+        if (db_get_row_bytes(table, txn_id, key, strlen(key), &size))
+            found++;
+    }
+    double lookup_time = now_seconds() - start;
+    vbt_lookup_stats(&lookups_after, &compares_after);
+    db_commit_transaction(txn_id);
+
+    printf("%-8s lookup %10.0f ops/s (%d found) | %.2f full-key compares per leaf lookup\n",
+           "strkeys", rows / lookup_time, found,
+           (double)(compares_after - compares_before) / (lookups_after - lookups_before));
+
+    db_close_table(table);
+}
+
+int main(int argc, char **argv)
+{
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+
+    db_init();
+
+    printf("=== Index benchmark: %d rows ===\n", rows);
+    run("bptree", INDEX_BPTREE, rows);
+    run("art", INDEX_ART, rows);
+    run("cuckoo", INDEX_CUCKOO, rows);
+    run("varkey", INDEX_VARKEY, rows);
+    run_string_keys(rows);
+
+    db_shutdown();
+    return 0;
+}
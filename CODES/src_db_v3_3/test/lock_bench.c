@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../include/ram_bptree.h"
+#include "../include/lock_manager.h"
+
+// Lock manager contention benchmark. Each thread runs short transactions
+// that take IX on its own table and X on a few random keys, with every
+// table using the same key range. Row locks are identified either by the
+// key alone (so equal keys of different tables collide, as row locks
+// once did) or by (table, key); only the second should be free of
+// conflicts between tables. The one-table run is repeated with deadlock
+// detection in place of wait-die.
+//
+// A second part compares two-phase locking, optimistic and deferred-write
+// transactions through the row API: read-modify-write transactions on a
+// shared table at several key-range sizes (fewer keys = more contention).
+
+#define DEFAULT_THREADS 8
+#define DEFAULT_KEYS 64
+#define DEFAULT_TXNS 50000
+#define ROWS_PER_TXN 4
+
+typedef struct
+{
+    int table_id;
+    bool qualified; // LOCK_ROW_ID(table, key) rather than the key alone
+    int txns;
+    unsigned seed;
+    long committed;
+    long died;
+} Worker;
+
+static int num_keys = DEFAULT_KEYS;
+
+// Key ranges of the 2PL / OCC / deferred comparison, most contended first
+static const int contention_keys[] = {16, 1024, 65536};
+
+typedef struct
+{
+    Table *table;
+    TxnMode mode;
+    int keys;
+    int txns;
+    unsigned seed;
+    long committed;
+    long failed;
+} RowWorker;
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = (Worker *)arg;
+
+    for (int i = 0; i < w->txns; i++)
+    {
+        int txn_id = transaction_begin(&g_lock_manager);
+        bool ok = lock_acquire(&g_lock_manager, txn_id, w->table_id, true, LOCK_INTENTION_EXCLUSIVE);
+
+        for (int r = 0; ok && r < ROWS_PER_TXN; r++)
+        {
+            int key = rand_r(&w->seed) % num_keys;
+            uint64_t id = w->qualified ? LOCK_ROW_ID(w->table_id, key) : (uint64_t)key;
+            ok = lock_acquire(&g_lock_manager, txn_id, id, false, LOCK_EXCLUSIVE);
+        }
+
+        // A transaction that dies aborts; its retry is just the next one
+        if (ok)
+        {
+            w->committed++;
+            transaction_commit(&g_lock_manager, txn_id);
+        }
+        else
+        {
+            w->died++;
+            transaction_abort(&g_lock_manager, txn_id);
+        }
+    }
+    return NULL;
+}
+
+// Add one to ROWS_PER_TXN counters (a delete and an insert each)
+static void *row_worker_main(void *arg)
+{
+    RowWorker *w = (RowWorker *)arg;
+
+    for (int i = 0; i < w->txns; i++)
+    {
+        int txn_id = db_begin_transaction_mode(w->mode);
+        bool ok = true;
+
+        for (int r = 0; ok && r < ROWS_PER_TXN; r++)
+        {
+            int key = rand_r(&w->seed) % w->keys;
+            size_t size;
+            long *value = (long *)db_get_row(w->table, txn_id, key, &size);
+            long next = value ? *value + 1 : 1;
+            ok = value && db_delete_row(w->table, txn_id, key) &&
+                 db_put_row(w->table, txn_id, key, &next, sizeof(next));
+        }
+
+        if (ok && db_commit_transaction(txn_id))
+        {
+            w->committed++;
+        }
+        else
+        {
+            if (ok)
+                w->failed++; // Optimistic validation failed (already rolled back)
+            else
+            {
+                w->failed++;
+                db_abort_transaction(txn_id);
+            }
+        }
+    }
+    return NULL;
+}
+
+// The engine logs every failed row operation; keep that out of the results
+static int mute_stdout()
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    return saved;
+}
+
+static void unmute_stdout(int saved)
+{
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+static void run_rows(const char *label, Table *table, TxnMode mode, int keys, int threads, int txns)
+{
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    RowWorker *workers = calloc(threads, sizeof(RowWorker));
+
+    int saved = mute_stdout();
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i].table = table;
+        workers[i].mode = mode;
+        workers[i].keys = keys;
+        workers[i].txns = txns;
+        workers[i].seed = 42 + i;
+        pthread_create(&tids[i], NULL, row_worker_main, &workers[i]);
+    }
+
+    long committed = 0, failed = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tids[i], NULL);
+        committed += workers[i].committed;
+        failed += workers[i].failed;
+    }
+    double elapsed = now_seconds() - start;
+    unmute_stdout(saved);
+
+    printf("%-5s %6d keys %10.0f commits/s | %5.2f%% aborted (%ld of %ld)\n",
+           label, keys, committed / elapsed, 100.0 * failed / (committed + failed), failed, committed + failed);
+
+    free(workers);
+    free(tids);
+}
+
+// Each contention level gets a fresh table of counters
+static void compare_modes(int threads, int txns)
+{
+    char name[32];
+    long zero = 0;
+
+    printf("=== 2PL vs OCC vs deferred: %d threads, %d read-modify-write txns each, %d rows per txn ===\n",
+           threads, txns, ROWS_PER_TXN);
+    for (size_t l = 0; l < sizeof(contention_keys) / sizeof(contention_keys[0]); l++)
+    {
+        int keys = contention_keys[l];
+        for (int m = 0; m < 3; m++)
+        {
+            snprintf(name, sizeof(name), "rmw_%d_%d", keys, m);
+            int saved = mute_stdout();
+            db_create_table(name);
+            Table *table = db_open_table(name);
+            int txn_id = db_begin_transaction();
+            for (int key = 0; key < keys; key++)
+                db_put_row(table, txn_id, key, &zero, sizeof(zero));
+            db_commit_transaction(txn_id);
+            unmute_stdout(saved);
+
+            if (m == 0)
+                run_rows("2PL", table, TXN_LOCKING, keys, threads, txns);
+            else if (m == 1)
+                run_rows("OCC", table, TXN_OPTIMISTIC, keys, threads, txns);
+            else
+                run_rows("DEF", table, TXN_DEFERRED, keys, threads, txns);
+            db_close_table(table);
+        }
+    }
+}
+
+// Run threads transactions each; tables = 1 puts them all on one table
+static void run(const char *label, int threads, int tables, bool qualified, int txns)
+{
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    Worker *workers = calloc(threads, sizeof(Worker));
+
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i].table_id = i % tables;
+        workers[i].qualified = qualified;
+        workers[i].txns = txns;
+        workers[i].seed = 42 + i;
+        pthread_create(&tids[i], NULL, worker_main, &workers[i]);
+    }
+
+    long committed = 0, died = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tids[i], NULL);
+        committed += workers[i].committed;
+        died += workers[i].died;
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("%-22s %10.0f commits/s | %5.2f%% died (%ld of %ld)\n",
+           label, committed / elapsed, 100.0 * died / (committed + died), died, committed + died);
+
+    free(workers);
+    free(tids);
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+    int txns = argc > 2 ? atoi(argv[2]) : DEFAULT_TXNS;
+    num_keys = argc > 3 ? atoi(argv[3]) : DEFAULT_KEYS;
+
+    db_init();
+
+    printf("=== Lock benchmark: %d threads, %d txns each, %d keys per table, %d rows per txn ===\n",
+           threads, txns, num_keys, ROWS_PER_TXN);
+    run("one table", threads, 1, true, txns);
+    run("table each, key ids", threads, threads, false, txns);
+    run("table each, row ids", threads, threads, true, txns);
+    lock_manager_set_policy(&g_lock_manager, LOCK_DETECT);
+    run("one table, detection", threads, 1, true, txns / 10);
+    lock_manager_set_policy(&g_lock_manager, LOCK_WAIT_DIE);
+
+    LockStats stats;
+    char text[2048];
+    lock_stats_collect(&g_lock_manager, &stats);
+    lock_stats_format(&stats, text, sizeof(text));
+    printf("--- lock stats ---\n%s", text);
+    compare_modes(threads, txns / 10);
+
+    db_shutdown();
+    return 0;
+}
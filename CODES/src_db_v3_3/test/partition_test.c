@@ -0,0 +1,162 @@
+#include <string.h>
+#include <limits.h>
+#include "test_check.h"
+
+// Partitioned tables against a sorted array of their keys: rows route to
+// one partition (the one whose bounds hold the key, when ranged), and
+// cursors over the whole table return keys in order both ways. Runs hash
+// partitions on every index type and range partitions on the int-keyed
+// ones.
+
+#define KEYS 4000
+#define KEY_SPACE 40000 // Keys are drawn from [-KEY_SPACE, KEY_SPACE)
+#define PARTITIONS 4
+
+static const int bounds[PARTITIONS - 1] = {-15000, 0, 15000};
+
+// Each row is in exactly one partition, and with range partitioning in
+// the one whose bounds hold its key
+static void check_routing(Table *table, PartitionMethod method, const int *sorted, int n)
+{
+    int total = 0, key;
+
+    CHECK(db_table_partition_count(table) == PARTITIONS);
+    for (int p = 0; p < PARTITIONS; p++)
+    {
+        Table *part = db_table_partition(table, p);
+        DbCursor *cursor = db_cursor_open(part);
+        int prev = INT_MIN, rows = 0;
+        bool first = true;
+
+        CHECK(cursor != NULL);
+        if (!cursor)
+            continue;
+        while (db_cursor_next(cursor, &key, NULL, NULL))
+        {
+            CHECK(first || key > prev);
+            CHECK(bsearch(&key, sorted, n, sizeof(int), compare_ints) != NULL);
+            if (method == PARTITION_RANGE)
+                CHECK((p == 0 || key >= bounds[p - 1]) && (p == PARTITIONS - 1 || key < bounds[p]));
+            prev = key;
+            first = false;
+            rows++;
+        }
+        db_cursor_close(cursor);
+        CHECK(rows == db_get_table_row_count(part));
+        total += rows;
+    }
+    CHECK(total == n);
+    CHECK(db_table_partition(table, PARTITIONS) == NULL);
+}
+
+static void check_order(Table *table, const int *sorted, int n)
+{
+    DbCursor *cursor = db_cursor_open(table);
+    int key, i;
+
+    CHECK(cursor != NULL);
+    if (!cursor)
+        return;
+
+    // Forward from the first key, then past the end
+    for (i = 0; i < n && db_cursor_next(cursor, &key, NULL, NULL); i++)
+        CHECK(key == sorted[i]);
+    CHECK(i == n);
+    CHECK(!db_cursor_next(cursor, &key, NULL, NULL));
+
+    // Backward from the last key
+    db_cursor_seek_last(cursor);
+    for (i = n - 1; i >= 0 && db_cursor_prev(cursor, &key, NULL, NULL); i--)
+        CHECK(key == sorted[i]);
+    CHECK(i == -1);
+    CHECK(!db_cursor_prev(cursor, &key, NULL, NULL));
+
+    // From a seek both ways, turning around on the way
+    for (int s = 0; s < n; s += n / 16)
+    {
+        db_cursor_seek(cursor, sorted[s]);
+        CHECK(db_cursor_next(cursor, &key, NULL, NULL) && key == sorted[s]);
+        if (s + 1 < n)
+            CHECK(db_cursor_next(cursor, &key, NULL, NULL) && key == sorted[s + 1]);
+        if (s + 1 < n)
+            CHECK(db_cursor_prev(cursor, &key, NULL, NULL) && key == sorted[s]);
+        if (s > 0)
+            CHECK(db_cursor_prev(cursor, &key, NULL, NULL) && key == sorted[s - 1]);
+
+        // Between keys: next is the key above, prev the one below
+        db_cursor_seek(cursor, sorted[s] + 1);
+        if (s + 1 < n && sorted[s + 1] > sorted[s] + 1)
+            CHECK(db_cursor_next(cursor, &key, NULL, NULL) && key == sorted[s + 1]);
+        db_cursor_seek(cursor, sorted[s] + 1);
+        CHECK(db_cursor_prev(cursor, &key, NULL, NULL) && key == sorted[s]);
+    }
+    db_cursor_close(cursor);
+}
+
+static void test_table(const char *name, IndexType type, PartitionMethod method)
+{
+    static const char value[] = "row";
+    int *keys = random_keys(42, KEYS, KEY_SPACE);
+    int *sorted = malloc(sizeof(int) * KEYS);
+    int n = 0;
+    size_t size;
+
+    printf("=== %s ===\n", name);
+    CHECK(db_create_partitioned_table(name, type, method, PARTITIONS,
+                                      method == PARTITION_RANGE ? bounds : NULL) >= 0);
+    Table *table = db_open_table(name);
+    CHECK(table != NULL);
+    if (!table)
+    {
+        free(sorted);
+        free(keys);
+        return;
+    }
+
+    int txn_id = db_begin_transaction();
+    for (int i = 0; i < KEYS; i++)
+        CHECK(db_put_row(table, txn_id, keys[i], (void *)value, sizeof(value)));
+    CHECK(db_commit_transaction(txn_id));
+
+    // Delete every fourth row through the table as well
+    txn_id = db_begin_transaction();
+    for (int i = 0; i < KEYS; i += 4)
+        CHECK(db_delete_row(table, txn_id, keys[i]));
+    CHECK(db_commit_transaction(txn_id));
+
+    for (int i = 0; i < KEYS; i++)
+        if (i % 4 != 0)
+            sorted[n++] = keys[i];
+    qsort(sorted, n, sizeof(int), compare_ints);
+
+    txn_id = db_begin_readonly();
+    for (int i = 0; i < KEYS; i++)
+        CHECK((db_get_row(table, txn_id, keys[i], &size) != NULL) == (i % 4 != 0));
+    db_commit_transaction(txn_id);
+
+    check_routing(table, method, sorted, n);
+    check_order(table, sorted, n);
+
+    db_close_table(table);
+    free(sorted);
+    free(keys);
+}
+
+int main()
+{
+    char name[64];
+
+    db_init();
+    for (int i = 0; i < TEST_INDEX_COUNT; i++)
+    {
+        snprintf(name, sizeof(name), "partition_%s_hash", test_indexes[i].name);
+        test_table(name, test_indexes[i].type, PARTITION_HASH);
+        if (!test_indexes[i].int_keyed)
+            continue;
+        snprintf(name, sizeof(name), "partition_%s_range", test_indexes[i].name);
+        test_table(name, test_indexes[i].type, PARTITION_RANGE);
+    }
+    db_shutdown();
+
+    return test_report();
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include "../include/nvram_client.h"
+
+// Point reads against a running server at pipeline depths 1, 16 and 128:
+// depth requests go out before the first response is read. Runs binary
+// GETs (in one read-only transaction), text GET ROWs (in one transaction)
+// and MGETs of depth keys (each its own snapshot); all report rows read
+// per second.
+//
+//   pipeline_bench [host] [port] [reads]
+
+#define DEFAULT_PORT 8080
+#define DEFAULT_READS 200000
+#define RECORDS 10000
+#define RECORD_SIZE 100
+#define LOAD_BATCH 500
+
+static const int depths[] = {1, 16, 128};
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *label, int depth, long reads, long found, double elapsed)
+{
+    printf("%-12s depth %3d %12.0f reads/s | %ld of %ld found\n", label, depth, reads / elapsed, found, reads);
+}
+
+static void bench_binary(NvClient *client, int table, int depth, long reads)
+{
+    long found = 0, done = 0;
+    unsigned seed = 42;
+
+    nv_begin(client, true);
+    double start = now_seconds();
+    for (; done < reads; done += depth)
+    {
+        for (int i = 0; i < depth; i++)
+            nv_queue_get(client, table, rand_r(&seed) % RECORDS);
+        for (int i = 0; i < depth; i++)
+            if (nv_receive(client, NULL, NULL) == NV_OK)
+                found++;
+    }
+    double elapsed = now_seconds() - start;
+    nv_commit(client);
+    report("binary GET", depth, done, found, elapsed);
+}
+
+static void bench_mget(NvClient *client, int table, int depth, long reads)
+{
+    int *keys = malloc(sizeof(int) * depth);
+    NvValue *values = malloc(sizeof(NvValue) * depth);
+    long found = 0, done = 0;
+    unsigned seed = 42;
+
+    double start = now_seconds();
+    for (; done < reads; done += depth)
+    {
+        int n = 0;
+        for (int i = 0; i < depth; i++)
+            keys[i] = rand_r(&seed) % RECORDS;
+        if (nv_mget(client, table, keys, depth, values, &n) == NV_OK)
+            found += n;
+    }
+    report("MGET", depth, done, found, now_seconds() - start);
+    free(values);
+    free(keys);
+}
+
+static int text_connect(const char *host, int port)
+{
+    char service[16];
+    struct addrinfo hints, *addrs;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+    if (getaddrinfo(host, service, &hints, &addrs) != 0)
+        return -1;
+
+    int fd = socket(addrs->ai_family, addrs->ai_socktype, addrs->ai_protocol);
+    if (fd >= 0 && connect(fd, addrs->ai_addr, addrs->ai_addrlen) < 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addrs);
+
+    int one = 1;
+    if (fd >= 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Read replies until count lines are in; the rows found among them
+static long text_replies(int fd, int count)
+{
+    static char buffer[64 * 1024];
+    static int line_start = 1; // At the start of a line
+    long found = 0;
+
+    while (count > 0)
+    {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+        {
+            printf("Error: Server disconnected\n");
+            exit(1);
+        }
+        for (ssize_t i = 0; i < n; i++)
+        {
+            // "Row k: ..." when found, "Row not found" when not
+            if (line_start && buffer[i] == 'R' && (i + 4 >= n || buffer[i + 4] != 'n'))
+                found++;
+            line_start = buffer[i] == '\n';
+            if (line_start)
+                count--;
+        }
+    }
+    return found;
+}
+
+static void bench_text(const char *host, int port, int depth, long reads)
+{
+    int fd = text_connect(host, port);
+    if (fd < 0)
+    {
+        printf("Error: Cannot connect to %s:%d\n", host, port);
+        return;
+    }
+
+    const char *setup = "USE TABLE pipeline_bench\nBEGIN TRANSACTION\n";
+    send(fd, setup, strlen(setup), 0);
+    text_replies(fd, 2);
+
+    char *requests = malloc((size_t)depth * 32);
+    long found = 0, done = 0;
+    unsigned seed = 42;
+
+    double start = now_seconds();
+    for (; done < reads; done += depth)
+    {
+        size_t len = 0;
+        for (int i = 0; i < depth; i++)
+            len += sprintf(requests + len, "GET ROW %d\n", rand_r(&seed) % RECORDS);
+        send(fd, requests, len, 0);
+        found += text_replies(fd, depth);
+    }
+    report("text GET", depth, done, found, now_seconds() - start);
+
+    free(requests);
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? atoi(argv[2]) : DEFAULT_PORT;
+    long reads = argc > 3 ? atol(argv[3]) : DEFAULT_READS;
+    int table;
+
+    NvClient *client = nv_connect(host, port);
+    if (!client)
+        return 1;
+
+    // Load phase, LOAD_BATCH rows per MPUT
+    if (nv_create_table(client, "pipeline_bench", 0, 0, &table) == NV_OK)
+    {
+        static char data[RECORD_SIZE];
+        int keys[LOAD_BATCH];
+        const void *values[LOAD_BATCH];
+        size_t sizes[LOAD_BATCH];
+        memset(data, 'x', sizeof(data) - 1);
+        for (int key = 0; key < RECORDS; key += LOAD_BATCH)
+        {
+            for (int i = 0; i < LOAD_BATCH; i++)
+            {
+                keys[i] = key + i;
+                values[i] = data;
+                sizes[i] = sizeof(data);
+            }
+            NvStatus status = nv_mput(client, table, keys, values, sizes, LOAD_BATCH, NULL);
+            if (status != NV_OK)
+            {
+                printf("Error: Load failed: %s\n", nv_status_name(status));
+                nv_close(client);
+                return 1;
+            }
+        }
+    }
+    else if (nv_open_table(client, "pipeline_bench", &table) != NV_OK)
+    {
+        printf("Error: Cannot create or open table pipeline_bench\n");
+        nv_close(client);
+        return 1;
+    }
+
+    printf("=== %d records of %d bytes, %ld reads per run ===\n", RECORDS, RECORD_SIZE, reads);
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+    {
+        bench_binary(client, table, depths[d], reads);
+        bench_text(host, port, depths[d], reads);
+        bench_mget(client, table, depths[d], reads);
+    }
+
+    nv_close(client);
+    return 0;
+}
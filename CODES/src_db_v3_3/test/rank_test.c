@@ -0,0 +1,165 @@
+#include <string.h>
+#include <limits.h>
+#include "test_check.h"
+
+// db_count_range and db_seek_rank checked against a sorted array of the
+// keys, on every index type, unpartitioned and partitioned, after inserts
+// and deletes.
+
+#define KEYS 5000
+#define KEY_SPACE 50000 // Keys are drawn from [-KEY_SPACE, KEY_SPACE)
+#define BATCH 500
+#define QUERIES 2000
+#define RANK_STRIDE 7 // Indexes without subtree counts walk to each rank
+
+// Index of the first key in sorted[0..n) that is >= key (> key unless inclusive)
+static long lower_bound(const int *sorted, long n, int key, bool inclusive)
+{
+    long lo = 0, hi = n;
+    while (lo < hi)
+    {
+        long mid = (lo + hi) / 2;
+        if (sorted[mid] < key || (!inclusive && sorted[mid] == key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static long reference_count(const int *sorted, long n, int lo, int hi)
+{
+    if (lo > hi)
+        return 0;
+    return lower_bound(sorted, n, hi, false) - lower_bound(sorted, n, lo, true);
+}
+
+static void check_against(Table *table, const int *sorted, long n)
+{
+    unsigned seed = 7;
+    int key;
+
+    CHECK(db_count_range(table, INT_MIN, INT_MAX) == n);
+    CHECK(db_count_range(table, 1, 0) == 0);
+    for (int q = 0; q < QUERIES; q++)
+    {
+        int lo = rand_r(&seed) % (2 * KEY_SPACE + 2) - KEY_SPACE - 1;
+        int hi = lo + rand_r(&seed) % (KEY_SPACE / 4);
+        CHECK(db_count_range(table, lo, hi) == reference_count(sorted, n, lo, hi));
+    }
+    for (long i = 0; i < n; i++)
+        CHECK(db_count_range(table, sorted[i], sorted[i]) == 1);
+
+    for (long rank = 0; rank < n; rank += RANK_STRIDE)
+        CHECK(db_seek_rank(table, rank, &key) && key == sorted[rank]);
+    CHECK(db_seek_rank(table, n - 1, &key) && key == sorted[n - 1]);
+    CHECK(!db_seek_rank(table, n, &key));
+    CHECK(!db_seek_rank(table, -1, &key));
+}
+
+static void test_table(const char *name, Table *table)
+{
+    static const char value[] = "row";
+    int *keys = random_keys(42, KEYS, KEY_SPACE);
+    int *sorted = malloc(sizeof(int) * KEYS);
+    long n = 0;
+
+    printf("=== %s ===\n", name);
+    for (int i = 0; i < KEYS; i += BATCH)
+    {
+        int txn_id = db_begin_transaction();
+        for (int j = i; j < i + BATCH; j++)
+            CHECK(db_put_row(table, txn_id, keys[j], (void *)value, sizeof(value)));
+        CHECK(db_commit_transaction(txn_id));
+    }
+    memcpy(sorted, keys, sizeof(int) * KEYS);
+    qsort(sorted, KEYS, sizeof(int), compare_ints);
+    check_against(table, sorted, KEYS);
+
+    // Delete every third key; nothing else runs, so they are reclaimed
+    // at commit and drop out of the counts
+    int txn_id = db_begin_transaction();
+    for (int i = 0; i < KEYS; i += 3)
+        CHECK(db_delete_row(table, txn_id, keys[i]));
+    CHECK(db_commit_transaction(txn_id));
+    for (int i = 0; i < KEYS; i++)
+        if (i % 3 != 0)
+            sorted[n++] = keys[i];
+    qsort(sorted, n, sizeof(int), compare_ints);
+    check_against(table, sorted, n);
+
+    free(sorted);
+    free(keys);
+}
+
+// With a reader holding its snapshot, deleted rows stay indexed; every
+// index type still counts them, as db_get_table_row_count does
+static void test_unreclaimed(Table **tables, int count)
+{
+    int *keys = random_keys(42, KEYS, KEY_SPACE);
+    int reader = db_begin_readonly();
+    long expected = 0;
+    int expected_first = 0, expected_last = 0;
+
+    printf("=== deleted, not reclaimed ===\n");
+    for (int t = 0; t < count; t++)
+    {
+        int txn_id = db_begin_transaction();
+        for (int i = 1; i < KEYS; i += 3) // Rows test_table left in place
+            CHECK(db_delete_row(tables[t], txn_id, keys[i]));
+        CHECK(db_commit_transaction(txn_id));
+
+        long rows = db_get_table_row_count(tables[t]);
+        int first = 0, last = 0;
+        CHECK(db_seek_rank(tables[t], 0, &first) && db_seek_rank(tables[t], rows - 1, &last));
+        if (t == 0)
+        {
+            expected = rows;
+            expected_first = first;
+            expected_last = last;
+        }
+        CHECK(rows == expected && first == expected_first && last == expected_last);
+        CHECK(db_count_range(tables[t], INT_MIN, INT_MAX) == rows);
+        CHECK(db_count_range(tables[t], 0, INT_MAX) == db_count_range(tables[0], 0, INT_MAX));
+        CHECK(!db_seek_rank(tables[t], rows, &last));
+    }
+    CHECK(expected == KEYS - (KEYS + 2) / 3); // The deletes above still count
+    db_commit_transaction(reader);
+    free(keys);
+}
+
+int main()
+{
+    static const int bounds[] = {-20000, 0, 20000};
+    Table *tables[TEST_INDEX_COUNT * 3]; // Unpartitioned, hash, range
+    int count = 0;
+    char name[64];
+
+    db_init();
+    for (int i = 0; i < TEST_INDEX_COUNT; i++)
+    {
+        snprintf(name, sizeof(name), "rank_%s", test_indexes[i].name);
+        db_create_table_with_index(name, test_indexes[i].type);
+        tables[count] = db_open_table(name);
+        test_table(name, tables[count++]);
+
+        snprintf(name, sizeof(name), "rank_%s_hash", test_indexes[i].name);
+        db_create_partitioned_table(name, test_indexes[i].type, PARTITION_HASH, 4, NULL);
+        tables[count] = db_open_table(name);
+        test_table(name, tables[count++]);
+
+        if (!test_indexes[i].int_keyed)
+            continue;
+        snprintf(name, sizeof(name), "rank_%s_range", test_indexes[i].name);
+        db_create_partitioned_table(name, test_indexes[i].type, PARTITION_RANGE, 4, bounds);
+        tables[count] = db_open_table(name);
+        test_table(name, tables[count++]);
+    }
+    test_unreclaimed(tables, count);
+
+    for (int i = 0; i < count; i++)
+        db_close_table(tables[i]);
+    db_shutdown();
+
+    return test_report();
+}
@@ -0,0 +1,72 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "../include/ram_bptree.h"
+
+// Checks shared by the correctness tests. A failed CHECK prints where it
+// failed and the test carries on; main ends with return test_report(),
+// which exits non-zero if any check failed. Safe to use from threads.
+
+static int failures = 0;
+
+#define CHECK(cond)                                                 \
+    do                                                              \
+    {                                                               \
+        if (!(cond))                                                \
+        {                                                           \
+            printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);     \
+        }                                                           \
+    } while (0)
+
+static inline int test_report(void)
+{
+    printf("%s: %d failed checks\n", failures ? "FAILED" : "PASSED", failures);
+    return failures != 0;
+}
+
+// Every index type, and whether it takes range partitions (int keys)
+typedef struct
+{
+    const char *name;
+    IndexType type;
+    bool int_keyed;
+} TestIndex;
+
+static const TestIndex test_indexes[] = {
+    {"bptree", INDEX_BPTREE, true},
+    {"art", INDEX_ART, false},
+    {"cuckoo", INDEX_CUCKOO, true},
+    {"varkey", INDEX_VARKEY, false},
+};
+
+#define TEST_INDEX_COUNT (int)(sizeof(test_indexes) / sizeof(test_indexes[0]))
+
+static inline int compare_ints(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// count distinct keys drawn from [-key_space, key_space), in the order
+// drawn (the caller frees them)
+static inline int *random_keys(unsigned seed, int count, int key_space)
+{
+    int *keys = (int *)malloc(sizeof(int) * count);
+    int n = 0;
+    while (n < count)
+    {
+        int key = rand_r(&seed) % (2 * key_space) - key_space;
+        bool seen = false;
+        for (int i = 0; i < n && !seen; i++)
+            seen = keys[i] == key;
+        if (!seen)
+            keys[n++] = key;
+    }
+    return keys;
+}
+
+#endif // TEST_CHECK_H
@@ -68,27 +68,15 @@ void* thread_worker(void* arg) {
         printf("Thread %d: Attempting to insert key %d\n", thread_id, key);
         pthread_mutex_unlock(&print_mutex);
         
-        // Loop a few times if we can't get the lock, to better demonstrate waiting behavior
-        bool success = false;
-        int retry_count = 0;
-        while (!success && retry_count < 3) {
-            success = db_put_row(shared_table, txn_id, key, data, strlen(data) + 1);
-            if (!success) {
-                pthread_mutex_lock(&print_mutex);
-                printf("Thread %d: Lock contention on key %d, retrying...\n", thread_id, key);
-                pthread_mutex_unlock(&print_mutex);
-                
-                // Wait a bit before retrying
-                usleep(100000 + (rand() % 200000));  // 100-300ms
-                retry_count++;
-            }
-        }
+        // A conflicting lock blocks until it is released, unless an older
+        // transaction holds it: then this one dies (wait-die) and aborts
+        bool success = db_put_row(shared_table, txn_id, key, data, strlen(data) + 1);
         
         pthread_mutex_lock(&print_mutex);
         if (success) {
             printf("Thread %d: Successfully inserted key %d\n", thread_id, key);
         } else {
-            printf("Thread %d: Failed to insert key %d after retries (locked by another thread)\n", thread_id, key);
+            printf("Thread %d: Failed to insert key %d (exists, or an older transaction holds it)\n", thread_id, key);
         }
         pthread_mutex_unlock(&print_mutex);
         
@@ -152,7 +140,6 @@ void* thread_worker(void* arg) {
         }
     }
     
-    free(data);
     return NULL;
 }
 
@@ -178,6 +165,8 @@ void demonstrate_deadlock() {
     // Wait for threads to complete
     pthread_join(thread1, NULL);
     pthread_join(thread2, NULL);
+    free(data1);
+    free(data2);
     
     printf("--- Deadlock Demonstration Complete ---\n\n");
 }
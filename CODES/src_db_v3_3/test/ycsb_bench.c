@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "../include/ram_bptree.h"
+
+// YCSB workload C (read only): each thread runs point reads of keys
+// drawn from a scrambled Zipfian distribution, as YCSB's default request
+// distribution, one read per transaction. Reads run either in ordinary
+// transactions (which take a lock manager slot) or in read-only ones
+// (a snapshot slot and nothing else), at 1, 8 and 32 threads.
+
+#define DEFAULT_RECORDS 100000
+#define DEFAULT_OPS 200000 // Per thread
+#define RECORD_SIZE 100
+#define ZIPF_THETA 0.99
+
+static const int thread_counts[] = {1, 8, 32};
+
+// Zipfian generator of Gray et al., as in YCSB
+typedef struct
+{
+    long items;
+    double theta, alpha, zetan, eta;
+} Zipf;
+
+typedef struct
+{
+    Table *table;
+    const Zipf *zipf;
+    bool readonly;
+    int ops;
+    unsigned seed;
+    long found;
+} Worker;
+
+static int num_records = DEFAULT_RECORDS;
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void zipf_init(Zipf *z, long items, double theta)
+{
+    z->items = items;
+    z->theta = theta;
+    z->zetan = 0;
+    for (long i = 1; i <= items; i++)
+        z->zetan += 1.0 / pow((double)i, theta);
+    double zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+    z->alpha = 1.0 / (1.0 - theta);
+    z->eta = (1.0 - pow(2.0 / items, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+// Rank drawn from the distribution: 0 is the most popular item
+static long zipf_next(const Zipf *z, unsigned *seed)
+{
+    double u = (double)rand_r(seed) / ((double)RAND_MAX + 1.0);
+    double uz = u * z->zetan;
+
+    if (uz < 1.0)
+        return 0;
+    if (uz < 1.0 + pow(0.5, z->theta))
+        return 1;
+    return (long)(z->items * pow(z->eta * u - z->eta + 1.0, z->alpha));
+}
+
+// Spread the popular ranks over the key space (FNV-1a of the rank)
+static int scramble(long rank)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 8; i++)
+    {
+        h ^= (rank >> (i * 8)) & 0xff;
+        h *= 0x100000001b3ULL;
+    }
+    return (int)(h % num_records);
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = (Worker *)arg;
+
+    for (int i = 0; i < w->ops; i++)
+    {
+        int key = scramble(zipf_next(w->zipf, &w->seed));
+        int txn_id = w->readonly ? db_begin_readonly() : db_begin_transaction();
+        size_t size;
+
+        if (db_get_row(w->table, txn_id, key, &size))
+            w->found++;
+        db_commit_transaction(txn_id);
+    }
+    return NULL;
+}
+
+static void run(const char *label, Table *table, const Zipf *zipf, bool readonly, int threads, int ops)
+{
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    Worker *workers = calloc(threads, sizeof(Worker));
+
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i].table = table;
+        workers[i].zipf = zipf;
+        workers[i].readonly = readonly;
+        workers[i].ops = ops;
+        workers[i].seed = 42 + i;
+        pthread_create(&tids[i], NULL, worker_main, &workers[i]);
+    }
+
+    long found = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tids[i], NULL);
+        found += workers[i].found;
+    }
+    double elapsed = now_seconds() - start;
+    long total = (long)threads * ops;
+
+    printf("%-10s %3d threads %12.0f reads/s | %ld of %ld found\n",
+           label, threads, total / elapsed, found, total);
+
+    free(workers);
+    free(tids);
+}
+
+int main(int argc, char **argv)
+{
+    num_records = argc > 1 ? atoi(argv[1]) : DEFAULT_RECORDS;
+    int ops = argc > 2 ? atoi(argv[2]) : DEFAULT_OPS;
+    char data[RECORD_SIZE];
+    Zipf zipf;
+
+    db_init();
+    db_create_table("usertable");
+    Table *table = db_open_table("usertable");
+
+    // Load phase
+    memset(data, 'x', sizeof(data));
+    int txn_id = db_begin_transaction();
+    for (int key = 0; key < num_records; key++)
+        db_put_row(table, txn_id, key, data, sizeof(data));
+    db_commit_transaction(txn_id);
+    zipf_init(&zipf, num_records, ZIPF_THETA);
+
+    printf("=== YCSB-C: %d records of %d bytes, %d reads per thread, Zipfian %.2f ===\n",
+           num_records, RECORD_SIZE, ops, ZIPF_THETA);
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++)
+    {
+        run("locking", table, &zipf, false, thread_counts[t], ops);
+        run("read-only", table, &zipf, true, thread_counts[t], ops);
+    }
+
+    db_close_table(table);
+    db_shutdown();
+    return 0;
+}